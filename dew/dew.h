@@ -13,6 +13,9 @@
  * You can define a custom allocator using the macros DEW_ALLOCATE, 
  * DEW_REALLOCATE and DEW_FREE respective to their functions.
  * 
+ * The garbage collector marks on a background thread using POSIX threads, so
+ * link with -pthread, or define DEW_NO_THREADS to always collect in place.
+ * 
  * I am very aware that the project's current state is not really very usable. I
  * hope that I can fix this without rewriting the whole thing again, but 
  */
@@ -22,6 +25,7 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <setjmp.h>
 
@@ -41,6 +45,54 @@ typedef struct dew_Error {
 	dew_String message;
 } dew_Error;
 
+// Garbage collector statistics, added up over every chunk a script runs
+#define DEW_GC_BUCKETS 16
+
+typedef struct dew_GcStats {
+	dew_Index minor;                    // Nursery collections
+	dew_Index major;                    // Old generation collections
+	dew_Index pauses[DEW_GC_BUCKETS];   // Pauses under 1, 2, 4, ... microseconds
+	dew_Index allocated;                // Bytes allocated
+	dew_Index promoted;                 // Bytes copied out of the nursery
+	dew_Index freed;                    // Bytes freed from the old generation
+	dew_Index old;                      // Bytes in the old generation
+	dew_Index peak;                     // Most bytes the old generation has held
+} dew_GcStats;
+
+typedef struct dew_Heap dew_Heap;
+
+// Static types of expressions, also used as the runtime tags of values
+enum {
+	DEW_TYPE_BOXED = 0,
+	DEW_TYPE_NULL,
+	DEW_TYPE_INTEGER,
+	DEW_TYPE_NUMBER,
+	DEW_TYPE_BOOLEAN,
+	DEW_TYPE_STRING,
+};
+
+typedef union dew_Value {
+	dew_Integer as_integer;
+	dew_Number as_number;
+	dew_String as_string;
+	dew_Boolean as_boolean;
+} dew_Value;
+
+// A value tagged with its DEW_TYPE_*
+typedef struct dew_Boxed {
+	dew_Integer type;
+	dew_Value value;
+} dew_Boxed;
+
+// A global variable. The machine only ever sees its slot number, the name is
+// for the compiler and the embedding API.
+typedef struct dew_Global {
+	dew_String name;
+	dew_Integer type;       // Declared DEW_TYPE_*
+	dew_Byte bits;          // Declared width of integers and numbers
+	dew_Boolean defined;    // False if it has only been used so far
+} dew_Global;
+
 // Chunk of bytecode
 typedef struct dew_Chunk {
 	dew_Byte *data;
@@ -61,6 +113,21 @@ typedef struct dew_Script {
 	
 	dew_Chunk *chunk;
 	dew_Index  chunk_count;
+	
+	// Statistics for the last chunk compiled
+	dew_Index  instructions;
+	dew_Index  specialised;
+	
+	// Global variables, and the slots their values are kept in, which last
+	// from one chunk to the next
+	dew_Global *global;
+	dew_Boxed  *slot;
+	dew_Index   global_count;
+	dew_Index   global_alloc;
+	
+	// Heap holding the strings the slots and running chunk point at
+	dew_Heap  *heap;
+	dew_GcStats gc;
 } dew_Script;
 
 void dew_init(dew_Script *script);
@@ -70,6 +137,14 @@ dew_Error dew_popError(dew_Script *script);
 dew_Index dew_countErrors(dew_Script *script);
 int dew_raiseError(dew_Script *script, dew_Error error);
 dew_Error dew_runChunk(dew_Script *script, dew_String code);
+dew_Error dew_emitC(dew_Script *script, dew_String code, FILE *out);
+dew_Integer dew_findGlobal(dew_Script *script, dew_String name);
+dew_Integer dew_defineGlobal(dew_Script *script, dew_String name, dew_Integer type);
+dew_Boxed dew_getGlobal(dew_Script *script, dew_Index slot);
+dew_Boolean dew_setGlobal(dew_Script *script, dew_Index slot, dew_Boxed value);
+void dew_printGcStats(dew_Script *script, FILE *out);
+void dew_benchmarkGc(FILE *out);
+dew_Error dew_benchmarkChunk(dew_Script *script, dew_String code, dew_Index runs, double *seconds);
 
 #endif
 
@@ -82,7 +157,9 @@ dew_Error dew_runChunk(dew_Script *script, dew_String code);
 #ifdef DEW_IMPLEMENTATION
 #undef DEW_IMPLEMENTATION
 
+#include <math.h>
 #include <string.h>
+#include <time.h>
 
 /**
  * =============================================================================
@@ -103,6 +180,15 @@ dew_Error dew_runChunk(dew_Script *script, dew_String code);
 #define DEW_FREE(x) free((void *) x)
 #endif // DEW_FREE
 
+// Garbage collector sizes, in bytes
+#ifndef DEW_NURSERY_SIZE
+#define DEW_NURSERY_SIZE (256 * 1024)
+#endif // DEW_NURSERY_SIZE
+
+#ifndef DEW_OLD_MINIMUM
+#define DEW_OLD_MINIMUM (1024 * 1024)
+#endif // DEW_OLD_MINIMUM
+
 /**
  * =============================================================================
  * Script Instance Mangement
@@ -117,6 +203,8 @@ void dew_init(dew_Script *script) {
 	memset(script, 0, sizeof *script);
 }
 
+static void dew_gcFree(dew_Script *script);
+
 void dew_free(dew_Script *script) {
 	/**
 	 * Frees the script at the given address.
@@ -125,6 +213,18 @@ void dew_free(dew_Script *script) {
 	if (script->error) {
 		DEW_FREE(script->error);
 	}
+	
+	// The collector may still be marking the slots
+	dew_gcFree(script);
+	
+	for (dew_Index i = 0; i < script->global_count; i++) {
+		DEW_FREE(script->global[i].name);
+	}
+	
+	if (script->global) {
+		DEW_FREE(script->global);
+		DEW_FREE(script->slot);
+	}
 }
 
 /**
@@ -228,13 +328,6 @@ enum {
 	DEW_TOKEN_MOREEQUAL,       // '>='
 };
 
-typedef union dew_Value {
-	dew_Integer as_integer;
-	dew_Number as_number;
-	dew_String as_string;
-	dew_Boolean as_boolean;
-} dew_Value;
-
 typedef struct dew_Token {
 	dew_Integer type;
 	dew_Value value;
@@ -501,12 +594,15 @@ static void dew_tokenise(dew_Script *script, dew_TokenArray *array, dew_String c
 		else if (current == '"') {
 			const dew_Index start = ++i;
 			
-			// Read the symbol.
-			while (code[++i] != '"' && i < len);
-			i--;
+			// Read up to the closing quote, which is skipped along with the
+			// rest of the token
+			while (i < len && code[i] != '"') {
+				i++;
+			}
 			
+			// dew_strndup's limit is the index of the last character
 			tok.type = DEW_TOKEN_STRING;
-			tok.value.as_string = dew_strndup(&code[start], i - start);
+			tok.value.as_string = (i > start) ? dew_strndup(&code[start], i - start - 1) : dew_strndup("", 0);
 		}
 		
 		else if (dew_isAlpha(current)) {
@@ -590,6 +686,11 @@ typedef struct dew_TreeNode {
 	struct dew_TreeNode *sub;
 	dew_Index sub_count;
 	
+	// Filled in by the type checker
+	dew_Integer static_type;
+	dew_Index slot;
+	dew_Boolean late;      // Symbol that was not declared yet
+	
 	// Location information
 	dew_Index offset;
 	dew_Index end;
@@ -612,6 +713,10 @@ static dew_TreeNode *dew_makeTree(dew_Index subnodes) {
 		return NULL;
 	}
 	
+	node->static_type = 0;
+	node->slot = 0;
+	node->late = false;
+	
 	if (subnodes > 0) {
 		dew_TreeNode *sub = DEW_ALLOCATE(sizeof *sub * subnodes);
 		
@@ -966,15 +1071,49 @@ static dew_TreeNode *dew_match(dew_Script *script, dew_Parser *parser, dew_Rule
 			value = dew_makeLiteralNode(DEW_NODE_NULL, (dew_Value) {0});
 		}
 		
+		if (value && CURRENT_TOKEN.type != DEW_TOKEN_SEMICOLON) {
+			dew_raiseError(script, (dew_Error) {parser->head, "Error: Expected ';' to end declaration."});
+		}
+		
+		parser->head++;
+		
 		return dew_trinaryTree(DEW_NODE_VAR_DECLARE, (dew_Value) {0}, type, name, value);
 	}
 	
+	// Assignment
+	else if (rule == DEW_RULE_ASSIGN) {
+		dew_TreeNode *name = dew_makeLiteralNode(DEW_NODE_SYMBOL, CURRENT_TOKEN.value);
+		parser->head += 2;
+		
+		dew_TreeNode *value = dew_match(script, parser, DEW_RULE_EXPRESSION);
+		
+		if (!value) {
+			dew_raiseError(script, (dew_Error) {parser->head, "Error: Expected a value to assign."});
+		}
+		
+		if (CURRENT_TOKEN.type != DEW_TOKEN_SEMICOLON) {
+			dew_raiseError(script, (dew_Error) {parser->head, "Error: Expected ';' to end assignment."});
+		}
+		
+		parser->head++;
+		
+		return dew_binaryTree(DEW_NODE_ASSIGN, (dew_Value) {0}, name, value);
+	}
+	
 	// Expression
 	else if (rule == DEW_RULE_STATEMENT || rule == DEW_RULE_DEFAULT) {
+		if (CURRENT_TOKEN.type == DEW_TOKEN_INVALID) {
+			return NULL;
+		}
+		
 		if (CURRENT_TOKEN.type == DEW_TOKEN_SYMBOL && GET_TOKEN(1).type == DEW_TOKEN_SYMBOL) {
 			return dew_match(script, parser, DEW_RULE_VAR_DECLARE);
 		}
 		
+		if (CURRENT_TOKEN.type == DEW_TOKEN_SYMBOL && GET_TOKEN(1).type == DEW_TOKEN_EQUAL) {
+			return dew_match(script, parser, DEW_RULE_ASSIGN);
+		}
+		
 		return dew_match(script, parser, DEW_RULE_EXPR_STATEMENT);
 	}
 	
@@ -997,6 +1136,9 @@ static dew_TreeNode *dew_parse(dew_Script *script, dew_TokenArray *code) {
 	// parse code
 	dew_TreeNode *root = dew_makeTree(0);
 	
+	// The end marker means rules can always look at the current token
+	dew_pushToken(script, code, (dew_Token) {DEW_TOKEN_INVALID, {0}, 0, 0});
+	
 	root->type = DEW_NODE_SEQUENCE;
 	root->value.as_integer = 0;
 	
@@ -1082,135 +1224,2417 @@ static void dew_printTree(dew_TreeNode *node, const dew_Index level) {
 
 /**
  * =============================================================================
- * Virtual Machine
+ * Type Checker
  * =============================================================================
  */
 
-// Opcodes
-enum {
-	DEW_OP_NOP = 0,
-	DEW_OP_RET,
-	DEW_OP_SET,
+typedef struct dew_TypeName {
+	dew_String name;
+	dew_Integer type;
+	dew_Byte bits;
+	dew_String spelling;
+} dew_TypeName;
+
+// Declared type names, with their storage width and C spelling
+static const dew_TypeName dew_typeNames[] = {
+	{"int", DEW_TYPE_INTEGER, 64, "int64_t"},
+	{"int64", DEW_TYPE_INTEGER, 64, "int64_t"},
+	{"int32", DEW_TYPE_INTEGER, 32, "int32_t"},
+	{"int16", DEW_TYPE_INTEGER, 16, "int16_t"},
+	{"short", DEW_TYPE_INTEGER, 16, "int16_t"},
+	{"number", DEW_TYPE_NUMBER, 64, "double"},
+	{"float32", DEW_TYPE_NUMBER, 32, "float"},
+	{"bool", DEW_TYPE_BOOLEAN, 8, "bool"},
+	{"string", DEW_TYPE_STRING, 64, "const char *"},
+	{"var", DEW_TYPE_BOXED, 64, "dew_RtValue"},
 };
 
-// Dynamic Array Implementation
-// typedef struct dew_Chunk {
-//   dew_Byte *data;
-//   size_t count;
-//   size_t alloc;
-// } dew_Chunk;
+typedef struct dew_Checker {
+	dew_Script *script;
+} dew_Checker;
 
-static dew_Chunk *dew_chunkInit(void) {
-	dew_Chunk *chunk = DEW_ALLOCATE(sizeof *chunk);
+static dew_Integer dew_reserveGlobal(dew_Script *script, dew_String name);
+
+static const dew_TypeName *dew_findTypeName(dew_String name) {
+	/**
+	 * Find a declared type by name, or return NULL.
+	 */
 	
-	if (!chunk) {
-		return NULL;
+	for (dew_Index i = 0; i < sizeof dew_typeNames / sizeof *dew_typeNames; i++) {
+		if (!strcmp(dew_typeNames[i].name, name)) {
+			return &dew_typeNames[i];
+		}
 	}
 	
-	chunk->data = NULL;
-	chunk->count = 0;
-	chunk->alloc = 0;
-	
-	return chunk;
+	return NULL;
 }
 
-static void dew_chunkFree(dew_Chunk *chunk) {
-	if (chunk->data) {
-		DEW_FREE(chunk);
+static const char *dew_typeString(dew_Integer type) {
+	switch (type) {
+		case DEW_TYPE_NULL: return "null";
+		case DEW_TYPE_INTEGER: return "an integer";
+		case DEW_TYPE_NUMBER: return "a number";
+		case DEW_TYPE_BOOLEAN: return "a boolean";
+		case DEW_TYPE_STRING: return "a string";
+		default: return "a value";
 	}
-	
-	DEW_FREE(chunk);
 }
 
-static void dew_addChunk(dew_Chunk *chunk, uint8_t byte) {
-	if (chunk->count >= chunk->alloc) {
-		chunk->alloc = 2 + chunk->alloc * 2;
-		chunk->data = DEW_REALLOCATE(chunk->data, chunk->alloc);
+static dew_Boolean dew_isLiteralName(dew_String name) {
+	return !strcmp(name, "true") || !strcmp(name, "false") || !strcmp(name, "null");
+}
+
+static dew_Boolean dew_isNumericType(dew_Integer type) {
+	return type == DEW_TYPE_INTEGER || type == DEW_TYPE_NUMBER;
+}
+
+static dew_Boolean dew_isArithmeticNode(dew_Integer type) {
+	return type == DEW_NODE_ADD || type == DEW_NODE_SUBTRACT || type == DEW_NODE_MULTIPLY || type == DEW_NODE_DIVIDE || type == DEW_NODE_MODULO;
+}
+
+static dew_Boolean dew_isOrderingNode(dew_Integer type) {
+	return type == DEW_NODE_LESS || type == DEW_NODE_LESS_EQUAL || type == DEW_NODE_GREATER || type == DEW_NODE_GREATER_EQUAL;
+}
+
+static dew_Integer dew_checkExpression(dew_Checker *checker, dew_TreeNode *node) {
+	/**
+	 * Work out and record the static type of an expression.
+	 */
+	
+	dew_Integer type = DEW_TYPE_BOXED;
+	
+	switch (node->type) {
+		case DEW_NODE_INTEGER: type = DEW_TYPE_INTEGER; break;
+		case DEW_NODE_NUMBER: type = DEW_TYPE_NUMBER; break;
+		case DEW_NODE_STRING: type = DEW_TYPE_STRING; break;
+		case DEW_NODE_NULL: type = DEW_TYPE_NULL; break;
+		case DEW_NODE_GROUPING: type = dew_checkExpression(checker, &node->sub[0]); break;
 		
-		if (!chunk->data) {
-			dew_panic("Failed to allocate chunk memory.");
+		case DEW_NODE_SYMBOL: {
+			if (!strcmp(node->value.as_string, "null")) {
+				type = DEW_TYPE_NULL;
+				break;
+			}
+			
+			if (dew_isLiteralName(node->value.as_string)) {
+				type = DEW_TYPE_BOOLEAN;
+				break;
+			}
+			
+			dew_Script *script = checker->script;
+			dew_Integer slot = dew_findGlobal(script, node->value.as_string);
+			
+			// Names that are not declared yet get a slot now, which their
+			// declaration will take over, and are checked when they run
+			if (slot < 0) {
+				slot = dew_reserveGlobal(script, node->value.as_string);
+			}
+			
+			if (slot < 0) {
+				dew_raiseError(script, (dew_Error) {-1, "Error: Too many variables."});
+			}
+			
+			node->slot = slot;
+			
+			if (!script->global[slot].defined) {
+				node->late = true;
+				break;
+			}
+			
+			type = script->global[slot].type;
+			break;
+		
+		
+		}
+		
+		case DEW_NODE_NOT: {
+			dew_checkExpression(checker, &node->sub[0]);
+			type = DEW_TYPE_BOOLEAN;
+			break;
+		}
+		
+		case DEW_NODE_OPPOSITE: {
+			type = dew_checkExpression(checker, &node->sub[0]);
+			
+			if (type != DEW_TYPE_BOXED && !dew_isNumericType(type)) {
+				dew_raiseError(checker->script, (dew_Error) {-1, "Error: Only numbers can be negated."});
+			}
+			
+			break;
+		}
+		
+		case DEW_NODE_LESS:
+		case DEW_NODE_LESS_EQUAL:
+		case DEW_NODE_GREATER:
+		case DEW_NODE_GREATER_EQUAL:
+		case DEW_NODE_EQUAL:
+		case DEW_NODE_NOT_EQUAL: {
+			dew_Integer a = dew_checkExpression(checker, &node->sub[0]);
+			dew_Integer b = dew_checkExpression(checker, &node->sub[1]);
+			
+			if (dew_isOrderingNode(node->type) && ((a != DEW_TYPE_BOXED && !dew_isNumericType(a)) || (b != DEW_TYPE_BOXED && !dew_isNumericType(b)))) {
+				dew_raiseError(checker->script, (dew_Error) {-1, "Error: Only numbers can be ordered."});
+			}
+			
+			type = DEW_TYPE_BOOLEAN;
+			break;
+		}
+		
+		case DEW_NODE_ADD:
+		case DEW_NODE_SUBTRACT:
+		case DEW_NODE_MULTIPLY:
+		case DEW_NODE_DIVIDE:
+		case DEW_NODE_MODULO: {
+			dew_Integer a = dew_checkExpression(checker, &node->sub[0]);
+			dew_Integer b = dew_checkExpression(checker, &node->sub[1]);
+			
+			if (a == DEW_TYPE_BOXED || b == DEW_TYPE_BOXED) {
+				type = DEW_TYPE_BOXED;
+			}
+			else if (node->type == DEW_NODE_ADD && a == DEW_TYPE_STRING && b == DEW_TYPE_STRING) {
+				type = DEW_TYPE_STRING;
+			}
+			else if (!dew_isNumericType(a) || !dew_isNumericType(b)) {
+				dew_raiseError(checker->script, (dew_Error) {-1, "Error: Arithmetic on something that is not a number."});
+			}
+			else {
+				type = (a == DEW_TYPE_INTEGER && b == DEW_TYPE_INTEGER) ? DEW_TYPE_INTEGER : DEW_TYPE_NUMBER;
+			}
+			
+			break;
+		}
+		
+		default: {
+			dew_raiseError(checker->script, (dew_Error) {-1, "Error: This kind of expression cannot be compiled."});
 		}
 	}
+	
+	node->static_type = type;
+	
+	return type;
 }
 
-/**
- * =============================================================================
- * Script Chunk Running
- * =============================================================================
- */
-
-dew_Error dew_runChunk(dew_Script *script, dew_String code) {
+static void dew_checkConvert(dew_Checker *checker, dew_Integer have, dew_Integer want) {
 	/**
-	 * Runs a chunk of code. ´code´ should be a string to the code, and ´script´
-	 * should be an active scripting instance.
-	 * 
-	 * IMPLEMENTATION NOTES
-	 * ====================
-	 *   * I use a lot of casts to avoid adding volatile to the function
-	 *     declarations because I wrote them before the error infrastrcture was
-	 *     in place. In the future, these should be changed so that the
-	 *     functions accept volatile arguments.
+	 * Check that a value of type ´have´ can be stored where ´want´ is
+	 * expected. Boxed values are checked again at runtime.
 	 */
 	
-	// Initialise token array
-	// Note: Use volatite otherwise the exact contents of tokens and tree will
-	// not be defined after a longjmp.
-	// https://man7.org/linux/man-pages/man3/setjmp.3.html § NOTES
-	volatile dew_TokenArray tokens = {NULL, 0};
-	volatile dew_TreeNode *tree = NULL;
+	if (have == want || want == DEW_TYPE_BOXED || (have == DEW_TYPE_BOXED && want != DEW_TYPE_NULL)) {
+		return;
+	}
 	
-	int result = setjmp(script->onError);
+	if (have == DEW_TYPE_INTEGER && want == DEW_TYPE_NUMBER) {
+		return;
+	}
 	
-	// We are running for the first time
-	if (!result) {
-		// Tokenise code
-		dew_tokenise(script, (dew_TokenArray *) &tokens, code);
-		
-		// Check for errors
-		if (!tokens.count || !tokens.data) {
-			return (dew_Error) {-1, "No tokens to be had, which cannot be a valid input."};
-		}
+	static char message[96];
+	snprintf(message, sizeof message, "Error: Cannot use %s as %s.", dew_typeString(have), dew_typeString(want));
+	dew_raiseError(checker->script, (dew_Error) {-1, message});
+}
+
+static void dew_checkStatement(dew_Checker *checker, dew_TreeNode *node) {
+	/**
+	 * Check a single statement, declaring any new variable.
+	 */
+	
+	if (node->type == DEW_NODE_VAR_DECLARE) {
+		dew_String name = node->sub[1].value.as_string;
+		const dew_TypeName *decl = dew_findTypeName(node->sub[0].value.as_string);
 		
-		if (dew_countErrors(script)) {
-			return (dew_Error) {-1, "Tokenising failed."};
+		if (!decl) {
+			dew_raiseError(checker->script, (dew_Error) {-1, "Error: Unknown type in declaration."});
 		}
 		
-		// Parse tokens
-		tree = dew_parse(script, (dew_TokenArray *) &tokens);
+		dew_Integer slot = dew_findGlobal(checker->script, name);
 		
-		for (size_t i = 0; i < tokens.count; i++) {
-			printf("Char(%.3d) -> %.3d : %.16X\n", i + 1, tokens.data[i].type, tokens.data[i].value.as_integer);
+		if (dew_isLiteralName(name) || (slot >= 0 && checker->script->global[slot].defined)) {
+			dew_raiseError(checker->script, (dew_Error) {-1, "Error: Variable is already declared."});
 		}
 		
-		if (dew_countErrors(script)) {
-			return (dew_Error) {-1, "Parsing failed."};
+		// Typed variables without a value start at zero
+		if (node->sub[2].type == DEW_NODE_NULL) {
+			node->sub[2].static_type = decl->type;
+		}
+		else {
+			dew_checkConvert(checker, dew_checkExpression(checker, &node->sub[2]), decl->type);
 		}
 		
-		dew_printTree((dew_TreeNode *) tree, 0);
+		// Only visible after its own initialiser
+		slot = dew_defineGlobal(checker->script, name, decl->type);
 		
-		if (tokens.count) {
-			dew_freeTokenArray(&tokens);
+		if (slot < 0) {
+			dew_raiseError(checker->script, (dew_Error) {-1, "Error: Too many variables."});
 		}
 		
-		if (tree) {
-			dew_treeFree((dew_TreeNode *) tree, 0);
+		node->static_type = decl->type;
+		node->slot = slot;
+		checker->script->global[slot].bits = decl->bits;
+	}
+	
+	else if (node->type == DEW_NODE_ASSIGN) {
+		dew_Integer slot = dew_findGlobal(checker->script, node->sub[0].value.as_string);
+		
+		if (slot < 0 || !checker->script->global[slot].defined) {
+			dew_raiseError(checker->script, (dew_Error) {-1, "Error: Assignment to an undeclared variable."});
 		}
 		
-		return (dew_Error) {0, "Finished okay!"};
+		dew_Integer type = checker->script->global[slot].type;
+		
+		dew_checkConvert(checker, dew_checkExpression(checker, &node->sub[1]), type);
+		
+		node->static_type = type;
+		node->slot = slot;
 	}
-	// There was an error, note that it's on the error stack so this is 
-	// (probably) a bit more acceptable than if we just returned normally.
+	
 	else {
-		if (tokens.count) {
-			dew_freeTokenArray(&tokens);
+		dew_checkExpression(checker, node);
+	}
+}
+
+static void dew_typeCheck(dew_Script *script, dew_TreeNode *root) {
+	/**
+	 * Resolve declared types and record the static type of every expression
+	 * in the tree. Expressions whose type is only known at runtime are left
+	 * as DEW_TYPE_BOXED. Declarations add to the script's globals, so later
+	 * chunks can see them.
+	 */
+	
+	dew_Checker checker;
+	checker.script = script;
+	
+	for (dew_Index i = 0; i < root->sub_count; i++) {
+		dew_checkStatement(&checker, &root->sub[i]);
+	}
+}
+
+/**
+ * =============================================================================
+ * C Emitter
+ * =============================================================================
+ */
+
+typedef struct dew_CEmitter {
+	dew_Script *script;
+	FILE *out;
+} dew_CEmitter;
+
+static void dew_emitExpression(dew_CEmitter *emitter, dew_TreeNode *node, dew_Integer want);
+
+static void dew_emitBox(dew_CEmitter *emitter, dew_TreeNode *node, dew_Integer have) {
+	/**
+	 * Emit an expression of a known static type as a boxed runtime value.
+	 */
+	
+	switch (have) {
+		case DEW_TYPE_NULL: fprintf(emitter->out, "dew_rtNull()"); return;
+		case DEW_TYPE_INTEGER: fprintf(emitter->out, "dew_rtInteger("); break;
+		case DEW_TYPE_NUMBER: fprintf(emitter->out, "dew_rtNumber("); break;
+		case DEW_TYPE_BOOLEAN: fprintf(emitter->out, "dew_rtBoolean("); break;
+		case DEW_TYPE_STRING: fprintf(emitter->out, "dew_rtString("); break;
+	}
+	
+	dew_emitExpression(emitter, node, have);
+	fprintf(emitter->out, ")");
+}
+
+static void dew_emitOperator(dew_CEmitter *emitter, dew_TreeNode *node, dew_Integer operand, const char *op) {
+	/**
+	 * Emit a binary operator on two unboxed operands of the given type.
+	 */
+	
+	fprintf(emitter->out, "(");
+	dew_emitExpression(emitter, &node->sub[0], operand);
+	fprintf(emitter->out, " %s ", op);
+	dew_emitExpression(emitter, &node->sub[1], operand);
+	fprintf(emitter->out, ")");
+}
+
+static void dew_emitCall(dew_CEmitter *emitter, dew_TreeNode *node, dew_Integer operand, const char *function, const char *op) {
+	/**
+	 * Emit a call to a runtime helper taking the two operands of a node, with
+	 * an optional leading operator argument.
+	 */
+	
+	fprintf(emitter->out, "%s(", function);
+	
+	if (op) {
+		fprintf(emitter->out, "%s, ", op);
+	}
+	
+	dew_emitExpression(emitter, &node->sub[0], operand);
+	fprintf(emitter->out, ", ");
+	dew_emitExpression(emitter, &node->sub[1], operand);
+	fprintf(emitter->out, ")");
+}
+
+static void dew_emitExpression(dew_CEmitter *emitter, dew_TreeNode *node, dew_Integer want) {
+	/**
+	 * Emit an expression as a C expression of the wanted static type,
+	 * converting or boxing it when needed.
+	 */
+	
+	dew_Integer have = node->static_type;
+	
+	// Convert to the wanted type, which the type checker has allowed
+	if (have != want) {
+		if (want == DEW_TYPE_BOXED) {
+			dew_emitBox(emitter, node, have);
 		}
-		
-		if (tree) {
-			dew_treeFree((dew_TreeNode *) tree, 0);
+		else if (have == DEW_TYPE_BOXED) {
+			switch (want) {
+				case DEW_TYPE_INTEGER: fprintf(emitter->out, "dew_rtToInteger("); break;
+				case DEW_TYPE_NUMBER: fprintf(emitter->out, "dew_rtToNumber("); break;
+				case DEW_TYPE_BOOLEAN: fprintf(emitter->out, "dew_rtToBoolean("); break;
+				case DEW_TYPE_STRING: fprintf(emitter->out, "dew_rtToString("); break;
+			}
+			
+			dew_emitExpression(emitter, node, DEW_TYPE_BOXED);
+			fprintf(emitter->out, ")");
+		}
+		else {
+			fprintf(emitter->out, "((double) ");
+			dew_emitExpression(emitter, node, DEW_TYPE_INTEGER);
+			fprintf(emitter->out, ")");
 		}
 		
-		return (dew_Error) {result, "Failed to run program."};
+		return;
 	}
+	
+	switch (node->type) {
+		case DEW_NODE_INTEGER: {
+			fprintf(emitter->out, "INT64_C(%" PRId64 ")", node->value.as_integer);
+			break;
+		}
+		
+		case DEW_NODE_NUMBER: {
+			fprintf(emitter->out, "%.17g", node->value.as_number);
+			
+			// Keep integral values as double constants
+			if (node->value.as_number == (dew_Integer) node->value.as_number) {
+				fprintf(emitter->out, ".0");
+			}
+			
+			break;
+		}
+		
+		case DEW_NODE_STRING: {
+			fputc('"', emitter->out);
+			
+			for (dew_String c = node->value.as_string; *c; c++) {
+				if (*c == '"' || *c == '\\') {
+					fprintf(emitter->out, "\\%c", *c);
+				}
+				else if (*c == '\n') {
+					fprintf(emitter->out, "\\n");
+				}
+				else {
+					fputc(*c, emitter->out);
+				}
+			}
+			
+			fputc('"', emitter->out);
+			break;
+		}
+		
+		case DEW_NODE_NULL: {
+			fprintf(emitter->out, "dew_rtNull()");
+			break;
+		}
+		
+		case DEW_NODE_SYMBOL: {
+			if (!strcmp(node->value.as_string, "null")) {
+				fprintf(emitter->out, "dew_rtNull()");
+			}
+			else if (dew_isLiteralName(node->value.as_string)) {
+				fprintf(emitter->out, "%s", node->value.as_string);
+			}
+			else if (node->late) {
+				dew_raiseError(emitter->script, (dew_Error) {-1, "Error: Use of an undeclared variable."});
+			}
+			else {
+				fprintf(emitter->out, "dew_var_%s", node->value.as_string);
+			}
+			
+			break;
+		}
+		
+		case DEW_NODE_GROUPING: {
+			dew_emitExpression(emitter, &node->sub[0], want);
+			break;
+		}
+		
+		case DEW_NODE_NOT: {
+			if (node->sub[0].static_type == DEW_TYPE_BOOLEAN) {
+				fprintf(emitter->out, "(!");
+				dew_emitExpression(emitter, &node->sub[0], DEW_TYPE_BOOLEAN);
+			}
+			else {
+				fprintf(emitter->out, "(!dew_rtTruthy(");
+				dew_emitExpression(emitter, &node->sub[0], DEW_TYPE_BOXED);
+				fprintf(emitter->out, ")");
+			}
+			
+			fprintf(emitter->out, ")");
+			break;
+		}
+		
+		case DEW_NODE_OPPOSITE: {
+			fprintf(emitter->out, (have == DEW_TYPE_BOXED) ? "dew_rtNegate(" : (have == DEW_TYPE_INTEGER) ? "dew_rtNegateInteger(" : "(-");
+			dew_emitExpression(emitter, &node->sub[0], have);
+			fprintf(emitter->out, ")");
+			break;
+		}
+		
+		default: {
+			dew_Integer a = node->sub[0].static_type;
+			dew_Integer b = node->sub[1].static_type;
+			
+			// Runtime operator constant for the boxed helpers, and the helper
+			// for integers, which wraps instead of overflowing
+			const char *op = NULL;
+			const char *symbol = NULL;
+			const char *integer = NULL;
+			
+			switch (node->type) {
+				case DEW_NODE_ADD: op = "DEW_RT_ADD"; symbol = "+"; integer = "dew_rtAddInteger"; break;
+				case DEW_NODE_SUBTRACT: op = "DEW_RT_SUBTRACT"; symbol = "-"; integer = "dew_rtSubtractInteger"; break;
+				case DEW_NODE_MULTIPLY: op = "DEW_RT_MULTIPLY"; symbol = "*"; integer = "dew_rtMultiplyInteger"; break;
+				case DEW_NODE_DIVIDE: op = "DEW_RT_DIVIDE"; symbol = "/"; integer = "dew_rtDivideInteger"; break;
+				case DEW_NODE_MODULO: op = "DEW_RT_MODULO"; symbol = "%"; integer = "dew_rtModuloInteger"; break;
+				case DEW_NODE_LESS: op = "DEW_RT_LESS"; symbol = "<"; break;
+				case DEW_NODE_LESS_EQUAL: op = "DEW_RT_LESS_EQUAL"; symbol = "<="; break;
+				case DEW_NODE_GREATER: op = "DEW_RT_GREATER"; symbol = ">"; break;
+				case DEW_NODE_GREATER_EQUAL: op = "DEW_RT_GREATER_EQUAL"; symbol = ">="; break;
+				case DEW_NODE_EQUAL: op = NULL; symbol = "=="; break;
+				case DEW_NODE_NOT_EQUAL: op = NULL; symbol = "!="; break;
+			}
+			
+			// Arithmetic, with the result type as the operand type
+			if (dew_isArithmeticNode(node->type)) {
+				if (have == DEW_TYPE_BOXED) {
+					dew_emitCall(emitter, node, DEW_TYPE_BOXED, "dew_rtArith", op);
+				}
+				else if (have == DEW_TYPE_STRING) {
+					dew_emitCall(emitter, node, DEW_TYPE_STRING, "dew_rtConcat", NULL);
+				}
+				else if (have == DEW_TYPE_INTEGER) {
+					dew_emitCall(emitter, node, DEW_TYPE_INTEGER, integer, NULL);
+				}
+				else if (have == DEW_TYPE_NUMBER && node->type == DEW_NODE_MODULO) {
+					dew_emitCall(emitter, node, DEW_TYPE_NUMBER, "fmod", NULL);
+				}
+				else {
+					dew_emitOperator(emitter, node, have, symbol);
+				}
+			}
+			
+			// Comparisons, unboxed when both sides are known numbers
+			else if (dew_isNumericType(a) && dew_isNumericType(b)) {
+				dew_Integer operand = (a == DEW_TYPE_INTEGER && b == DEW_TYPE_INTEGER) ? DEW_TYPE_INTEGER : DEW_TYPE_NUMBER;
+				dew_emitOperator(emitter, node, operand, symbol);
+			}
+			else if (dew_isOrderingNode(node->type)) {
+				dew_emitCall(emitter, node, DEW_TYPE_BOXED, "dew_rtCompare", op);
+			}
+			else if (a == DEW_TYPE_BOOLEAN && b == DEW_TYPE_BOOLEAN) {
+				dew_emitOperator(emitter, node, DEW_TYPE_BOOLEAN, symbol);
+			}
+			else {
+				fprintf(emitter->out, (node->type == DEW_NODE_EQUAL) ? "dew_rtEqual(" : "(!dew_rtEqual(");
+				dew_emitExpression(emitter, &node->sub[0], DEW_TYPE_BOXED);
+				fprintf(emitter->out, ", ");
+				dew_emitExpression(emitter, &node->sub[1], DEW_TYPE_BOXED);
+				fprintf(emitter->out, (node->type == DEW_NODE_EQUAL) ? ")" : "))");
+			}
+			
+			break;
+		}
+	}
+}
+
+static void dew_emitStatement(dew_CEmitter *emitter, dew_TreeNode *node) {
+	/**
+	 * Emit a single statement into the body of main().
+	 */
+	
+	// Declarations become C locals of the declared type
+	if (node->type == DEW_NODE_VAR_DECLARE) {
+		const dew_TypeName *decl = dew_findTypeName(node->sub[0].value.as_string);
+		dew_String name = node->sub[1].value.as_string;
+		
+		fprintf(emitter->out, "\t%s dew_var_%s = ", decl->spelling, name);
+		
+		if (node->sub[2].type == DEW_NODE_NULL && decl->type != DEW_TYPE_BOXED) {
+			fprintf(emitter->out, (decl->type == DEW_TYPE_STRING) ? "\"\"" : "0");
+		}
+		else {
+			dew_emitExpression(emitter, &node->sub[2], decl->type);
+		}
+		
+		fprintf(emitter->out, ";\n\t(void) dew_var_%s;\n", name);
+	}
+	
+	else if (node->type == DEW_NODE_ASSIGN) {
+		fprintf(emitter->out, "\tdew_var_%s = ", node->sub[0].value.as_string);
+		dew_emitExpression(emitter, &node->sub[1], node->static_type);
+		fprintf(emitter->out, ";\n");
+	}
+	
+	// Expression statements print their value like the REPL would
+	else {
+		fprintf(emitter->out, "\tdew_rtPrint(");
+		dew_emitExpression(emitter, node, DEW_TYPE_BOXED);
+		fprintf(emitter->out, ");\n");
+	}
+}
+
+static void dew_emitProgram(dew_CEmitter *emitter, dew_TreeNode *root) {
+	/**
+	 * Emit a whole translation unit for a type checked script.
+	 */
+	
+	fprintf(emitter->out,
+		"/**\n"
+		" * Generated by `dew --emit-c`. Build with any C99 compiler:\n"
+		" * \n"
+		" *     cc -O2 -I path/to/dew program.c -lm\n"
+		" */\n"
+		"\n"
+		"#include \"dew_runtime.h\"\n"
+		"\n"
+		"int main(void) {\n");
+	
+	for (dew_Index i = 0; i < root->sub_count; i++) {
+		dew_emitStatement(emitter, &root->sub[i]);
+	}
+	
+	fprintf(emitter->out, "\treturn 0;\n}\n");
+}
+
+/**
+ * =============================================================================
+ * Garbage Collector
+ * =============================================================================
+ * 
+ * Strings made while running live on a generational heap. New objects are
+ * bump allocated in the nursery. When it fills up, the objects the machine can
+ * still reach are copied into the old generation and the whole nursery is
+ * reused. The old generation is a list of separately allocated objects that
+ * is marked and swept once it has grown to twice its size after the last
+ * sweep.
+ * 
+ * The roots are the machine's stack and the global slots, so anything that
+ * might allocate has to be given an up to date top of stack first. Strings
+ * hold no references, so copying one is the whole of promoting it; objects
+ * that do will need tracing here and a remembered set for old objects that
+ * point into the nursery.
+ * 
+ * Unless DEW_NO_THREADS is defined, the old generation is marked and swept
+ * on a background thread while the machine keeps running:
+ * 
+ *   1. A short pause marks what the stack points at and hands the list of
+ *      old objects to the background thread. Objects made from here on are
+ *      born marked and go on a new list.
+ *   2. The thread marks from the local slots. Stores to a local slot go
+ *      through a snapshot-at-the-beginning barrier, which records the value
+ *      being overwritten, so anything reachable when the cycle began gets
+ *      marked even if the machine moves it around.
+ *   3. A short pause marks the recorded values, and the thread then frees
+ *      everything on its list that was not marked.
+ *   4. A last short pause puts the survivors back on the old list.
+ * 
+ * Whether an object is marked is the DEW_GC_MARKED bit compared with the
+ * heap's ´black´, which flips after every cycle so nothing has to be
+ * unmarked.
+ */
+
+#ifndef DEW_NO_THREADS
+#include <pthread.h>
+#include <stdatomic.h>
+#endif
+
+enum {
+	DEW_OBJECT_STRING = 0,
+};
+
+enum {
+	DEW_GC_OLD = 1,        // In the old generation
+	DEW_GC_MARKED = 2,     // Marked if it matches the heap's ´black´
+	DEW_GC_PERMANENT = 4,  // Kept while the chunk using it runs, used for literals
+	DEW_GC_FORWARDED = 8,  // Copied out of the nursery to ´next´
+};
+
+enum {
+	DEW_GC_IDLE = 0,
+	DEW_GC_MARKING,        // Background thread is marking
+	DEW_GC_SWEEPING,       // Background thread is sweeping
+};
+
+// Header in front of every object, the object's data follows it
+typedef struct dew_Object {
+	struct dew_Object *next;  // Next old object, or the copy of a nursery object
+	uint32_t size;            // Bytes including this header
+	uint8_t type;             // DEW_OBJECT_*
+	uint8_t flags;            // DEW_GC_*
+} dew_Object;
+
+struct dew_Heap {
+	dew_Byte *nursery;
+	dew_Index nursery_used;
+	dew_Object *old;
+	dew_Object *old_tail;
+	dew_Index old_limit;      // Old generation size that starts a major collection
+	dew_Byte black;           // DEW_GC_MARKED bit of marked objects this cycle
+	bool concurrent;          // Collect the old generation in the background
+	
+	// Roots
+	dew_Boxed *stack;
+	dew_Boxed *top;
+	dew_Boxed *local;
+	dew_Index locals;
+	
+	// Pause times in seconds, only kept if ´pause_log´ is set
+	double *pause_log;
+	dew_Index pause_count;
+	dew_Index pause_alloc;
+
+#ifndef DEW_NO_THREADS
+	dew_Byte phase;           // DEW_GC_IDLE, MARKING or SWEEPING
+	bool barrier;             // Stores to local slots must be recorded
+	pthread_t thread;
+	pthread_mutex_t lock;     // Held to touch the local slots while marking
+	atomic_bool finished;     // The background thread is done with its phase
+	
+	// Values overwritten while marking
+	dew_Boxed *satb;
+	dew_Index satb_count;
+	dew_Index satb_alloc;
+	
+	// Old objects from before the cycle, which belong to the background
+	// thread until it has finished sweeping
+	dew_Object *sweep;
+	dew_Object *survivors;
+	dew_Object *survivors_tail;
+	dew_Index swept_bytes;
+#endif
+};
+
+#define DEW_GC_ALIGN(x) (((x) + 7) & ~(dew_Index) 7)
+#define DEW_GC_HEADER(STRING) ((dew_Object *) (STRING) - 1)
+
+static double dew_gcNow(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double) now.tv_sec + (double) now.tv_nsec * 1e-9;
+}
+
+static dew_Heap *dew_gcInit(void) {
+	dew_Heap *heap = DEW_ALLOCATE(sizeof *heap);
+	
+	if (!heap) {
+		return NULL;
+	}
+	
+	memset(heap, 0, sizeof *heap);
+	
+	heap->nursery = DEW_ALLOCATE(DEW_NURSERY_SIZE);
+	heap->old_limit = DEW_OLD_MINIMUM;
+	
+	if (!heap->nursery) {
+		DEW_FREE(heap);
+		return NULL;
+	}
+
+#ifndef DEW_NO_THREADS
+	heap->concurrent = true;
+	pthread_mutex_init(&heap->lock, NULL);
+	atomic_init(&heap->finished, false);
+#endif
+
+	return heap;
+}
+
+static void dew_gcPause(dew_Script *script, double start) {
+	/**
+	 * Add a pause that began at ´start´ to the histogram.
+	 */
+	
+	dew_Heap *heap = script->heap;
+	double seconds = dew_gcNow() - start;
+	dew_Index bucket = 0;
+	
+	while (bucket < DEW_GC_BUCKETS - 1 && (double) (1 << bucket) <= seconds * 1e6) {
+		bucket++;
+	}
+	
+	script->gc.pauses[bucket]++;
+	
+	if (heap->pause_log) {
+		if (heap->pause_count >= heap->pause_alloc) {
+			heap->pause_alloc *= 2;
+			heap->pause_log = DEW_REALLOCATE(heap->pause_log, sizeof *heap->pause_log * heap->pause_alloc);
+			
+			if (!heap->pause_log) {
+				dew_panic("Failed to allocate pause log memory.");
+			}
+		}
+		
+		heap->pause_log[heap->pause_count++] = seconds;
+	}
+}
+
+static bool dew_gcYoung(dew_Heap *heap, dew_String string) {
+	/**
+	 * Check if a string is in the nursery without looking at its header.
+	 */
+	
+	return (const dew_Byte *) string >= heap->nursery && (const dew_Byte *) string < heap->nursery + DEW_NURSERY_SIZE;
+}
+
+static dew_Object *dew_gcOld(dew_Script *script, dew_Byte type, dew_Index size) {
+	/**
+	 * Allocate an object straight into the old generation. While a cycle is
+	 * running it is born marked, since the cycle cannot have seen it.
+	 */
+	
+	dew_Heap *heap = script->heap;
+	dew_Object *object = DEW_ALLOCATE(size);
+	
+	if (!object) {
+		dew_panic("Failed to allocate object memory.");
+	}
+	
+	dew_Byte colour = heap->black ^ DEW_GC_MARKED;
+
+#ifndef DEW_NO_THREADS
+	if (heap->phase != DEW_GC_IDLE) {
+		colour = heap->black;
+	}
+#endif
+
+	object->next = heap->old;
+	object->size = size;
+	object->type = type;
+	object->flags = DEW_GC_OLD | colour;
+	
+	if (!heap->old) {
+		heap->old_tail = object;
+	}
+	
+	heap->old = object;
+	
+	script->gc.old += size;
+	
+	if (script->gc.old > script->gc.peak) {
+		script->gc.peak = script->gc.old;
+	}
+	
+	return object;
+}
+
+static void dew_gcEvacuate(dew_Script *script, dew_Boxed *value) {
+	/**
+	 * Move the object a root points at out of the nursery, or point the root
+	 * at where it has already been moved.
+	 */
+	
+	// Old objects are told apart by address, so their headers (which the
+	// background thread may be marking) are not read
+	if (value->type != DEW_TYPE_STRING || !dew_gcYoung(script->heap, value->value.as_string)) {
+		return;
+	}
+	
+	dew_Object *object = DEW_GC_HEADER(value->value.as_string);
+	
+	if (!(object->flags & DEW_GC_FORWARDED)) {
+		dew_Object *copy = dew_gcOld(script, object->type, object->size);
+		
+		memcpy(copy + 1, object + 1, object->size - sizeof *object);
+		
+		object->next = copy;
+		object->flags |= DEW_GC_FORWARDED;
+		
+		script->gc.promoted += object->size;
+	}
+	
+	value->value.as_string = (dew_String) (object->next + 1);
+}
+
+static void dew_gcMark(dew_Heap *heap, dew_Boxed value) {
+	/**
+	 * Mark an old object a value points at. Young objects are left alone, so
+	 * their headers are never read from the background thread.
+	 */
+	
+	if (value.type != DEW_TYPE_STRING || dew_gcYoung(heap, value.value.as_string)) {
+		return;
+	}
+	
+	dew_Object *object = DEW_GC_HEADER(value.value.as_string);
+	
+	object->flags = (object->flags & ~DEW_GC_MARKED) | heap->black;
+}
+
+static dew_Object *dew_gcSweepList(dew_Heap *heap, dew_Object *list, dew_Object **tail, dew_Index *freed) {
+	/**
+	 * Free the objects in a list that are not marked or permanent, and return
+	 * what is left of it.
+	 */
+	
+	dew_Object **link = &list;
+	
+	*tail = NULL;
+	
+	while (*link) {
+		dew_Object *object = *link;
+		
+		if ((object->flags & DEW_GC_PERMANENT) || (object->flags & DEW_GC_MARKED) == heap->black) {
+			*tail = object;
+			link = &object->next;
+			continue;
+		}
+		
+		*link = object->next;
+		*freed += object->size;
+		DEW_FREE(object);
+	}
+	
+	return list;
+}
+
+static void dew_gcSwept(dew_Script *script, dew_Index freed) {
+	/**
+	 * Finish a major collection once the old generation has been swept.
+	 */
+	
+	dew_Heap *heap = script->heap;
+	
+	script->gc.old -= freed;
+	script->gc.freed += freed;
+	script->gc.major++;
+	
+	heap->black ^= DEW_GC_MARKED;
+	heap->old_limit = (script->gc.old * 2 > DEW_OLD_MINIMUM) ? script->gc.old * 2 : DEW_OLD_MINIMUM;
+}
+
+static void dew_gcMajor(dew_Script *script) {
+	/**
+	 * Mark the old objects reachable from the roots and free the rest, all
+	 * while the machine waits. This only runs straight after a minor
+	 * collection, so the nursery is empty.
+	 */
+	
+	dew_Heap *heap = script->heap;
+	double start = dew_gcNow();
+	dew_Index freed = 0;
+	
+	for (dew_Boxed *value = heap->stack; value < heap->top; value++) {
+		dew_gcMark(heap, *value);
+	}
+	
+	for (dew_Index i = 0; i < heap->locals; i++) {
+		dew_gcMark(heap, heap->local[i]);
+	}
+	
+	heap->old = dew_gcSweepList(heap, heap->old, &heap->old_tail, &freed);
+	
+	dew_gcSwept(script, freed);
+	dew_gcPause(script, start);
+}
+
+#ifndef DEW_NO_THREADS
+
+#define DEW_GC_MARK_BATCH 256
+
+static void *dew_gcMarker(void *data) {
+	/**
+	 * Background marking: visit the local slots a batch at a time, holding
+	 * the lock so the machine cannot be halfway through a store.
+	 */
+	
+	dew_Heap *heap = data;
+	
+	for (dew_Index i = 0; i < heap->locals; i += DEW_GC_MARK_BATCH) {
+		dew_Index end = (i + DEW_GC_MARK_BATCH < heap->locals) ? i + DEW_GC_MARK_BATCH : heap->locals;
+		
+		pthread_mutex_lock(&heap->lock);
+		
+		for (dew_Index j = i; j < end; j++) {
+			dew_gcMark(heap, heap->local[j]);
+		}
+		
+		pthread_mutex_unlock(&heap->lock);
+	}
+	
+	atomic_store(&heap->finished, true);
+	
+	return NULL;
+}
+
+static void *dew_gcSweeper(void *data) {
+	/**
+	 * Background sweeping of the old objects from before the cycle, which
+	 * nothing else touches until it has finished.
+	 */
+	
+	dew_Heap *heap = data;
+	
+	heap->swept_bytes = 0;
+	heap->survivors = dew_gcSweepList(heap, heap->sweep, &heap->survivors_tail, &heap->swept_bytes);
+	heap->sweep = NULL;
+	
+	atomic_store(&heap->finished, true);
+	
+	return NULL;
+}
+
+static void dew_gcStartThread(dew_Heap *heap, void *(*phase)(void *)) {
+	atomic_store(&heap->finished, false);
+	
+	if (pthread_create(&heap->thread, NULL, phase, heap)) {
+		// Do the work here instead
+		phase(heap);
+		heap->thread = pthread_self();
+	}
+}
+
+static void dew_gcJoinThread(dew_Heap *heap) {
+	if (!pthread_equal(heap->thread, pthread_self())) {
+		pthread_join(heap->thread, NULL);
+	}
+}
+
+static void dew_gcStartCycle(dew_Script *script) {
+	/**
+	 * The initial pause: mark from the stack, take the old list away and let
+	 * the background thread mark from the local slots.
+	 */
+	
+	dew_Heap *heap = script->heap;
+	double start = dew_gcNow();
+	
+	for (dew_Boxed *value = heap->stack; value < heap->top; value++) {
+		dew_gcMark(heap, *value);
+	}
+	
+	heap->sweep = heap->old;
+	heap->old = NULL;
+	heap->old_tail = NULL;
+	heap->satb_count = 0;
+	heap->phase = DEW_GC_MARKING;
+	heap->barrier = true;
+	
+	dew_gcStartThread(heap, dew_gcMarker);
+	dew_gcPause(script, start);
+}
+
+static void dew_gcRemark(dew_Script *script) {
+	/**
+	 * The final marking pause: mark everything the barrier recorded, then
+	 * let the background thread sweep.
+	 */
+	
+	dew_Heap *heap = script->heap;
+	double start = dew_gcNow();
+	
+	dew_gcJoinThread(heap);
+	
+	for (dew_Index i = 0; i < heap->satb_count; i++) {
+		dew_gcMark(heap, heap->satb[i]);
+	}
+	
+	heap->satb_count = 0;
+	heap->barrier = false;
+	heap->phase = DEW_GC_SWEEPING;
+	
+	dew_gcStartThread(heap, dew_gcSweeper);
+	dew_gcPause(script, start);
+}
+
+static void dew_gcFinishCycle(dew_Script *script) {
+	/**
+	 * Put the objects that survived the sweep back on the old list.
+	 */
+	
+	dew_Heap *heap = script->heap;
+	double start = dew_gcNow();
+	
+	dew_gcJoinThread(heap);
+	
+	if (heap->survivors) {
+		if (heap->old) {
+			heap->old_tail->next = heap->survivors;
+		}
+		else {
+			heap->old = heap->survivors;
+		}
+		
+		heap->old_tail = heap->survivors_tail;
+	}
+	
+	heap->survivors = NULL;
+	heap->survivors_tail = NULL;
+	heap->phase = DEW_GC_IDLE;
+	
+	dew_gcSwept(script, heap->swept_bytes);
+	dew_gcPause(script, start);
+}
+
+static void dew_gcStep(dew_Script *script, bool wait) {
+	/**
+	 * Move a background cycle on if its thread is done with the current
+	 * phase, or after waiting for it if ´wait´ is set.
+	 */
+	
+	dew_Heap *heap = script->heap;
+	
+	if (heap->phase == DEW_GC_MARKING && (wait || atomic_load(&heap->finished))) {
+		dew_gcRemark(script);
+	}
+	
+	if (heap->phase == DEW_GC_SWEEPING && (wait || atomic_load(&heap->finished))) {
+		dew_gcFinishCycle(script);
+	}
+}
+
+#endif
+
+static void dew_gcStore(dew_Script *script, dew_Boxed *slot, dew_Boxed value) {
+	/**
+	 * Store a value in a local slot. While the background thread is marking,
+	 * the value being overwritten is recorded so it still gets marked.
+	 */
+
+#ifndef DEW_NO_THREADS
+	dew_Heap *heap = script->heap;
+	
+	if (heap->barrier) {
+		pthread_mutex_lock(&heap->lock);
+		
+		if (slot->type == DEW_TYPE_STRING && !dew_gcYoung(heap, slot->value.as_string)) {
+			if (heap->satb_count >= heap->satb_alloc) {
+				heap->satb_alloc = 64 + heap->satb_alloc * 2;
+				heap->satb = DEW_REALLOCATE(heap->satb, sizeof *heap->satb * heap->satb_alloc);
+				
+				if (!heap->satb) {
+					dew_panic("Failed to allocate barrier memory.");
+				}
+			}
+			
+			heap->satb[heap->satb_count++] = *slot;
+		}
+		
+		*slot = value;
+		
+		pthread_mutex_unlock(&heap->lock);
+		return;
+	}
+#endif
+
+	*slot = value;
+}
+
+static void dew_gcMinor(dew_Script *script) {
+	/**
+	 * Promote everything the roots reach in the nursery and empty it, then
+	 * start or move on a major collection if one is due.
+	 */
+	
+	dew_Heap *heap = script->heap;
+	double start = dew_gcNow();
+	
+	for (dew_Boxed *value = heap->stack; value < heap->top; value++) {
+		dew_gcEvacuate(script, value);
+	}
+
+#ifndef DEW_NO_THREADS
+	// Only nursery pointers are replaced here, which the marker ignores, but
+	// it must not read a slot while it is being written
+	if (heap->barrier) {
+		pthread_mutex_lock(&heap->lock);
+	}
+#endif
+
+	for (dew_Index i = 0; i < heap->locals; i++) {
+		dew_gcEvacuate(script, &heap->local[i]);
+	}
+
+#ifndef DEW_NO_THREADS
+	if (heap->barrier) {
+		pthread_mutex_unlock(&heap->lock);
+	}
+#endif
+
+	heap->nursery_used = 0;
+	
+	script->gc.minor++;
+	dew_gcPause(script, start);
+
+#ifndef DEW_NO_THREADS
+	if (heap->phase != DEW_GC_IDLE) {
+		// Wait for the cycle if the old generation is growing much faster
+		// than it is being collected
+		dew_gcStep(script, script->gc.old > heap->old_limit * 2);
+		return;
+	}
+	
+	if (heap->concurrent && script->gc.old > heap->old_limit) {
+		dew_gcStartCycle(script);
+		return;
+	}
+#endif
+
+	if (script->gc.old > heap->old_limit) {
+		dew_gcMajor(script);
+	}
+}
+
+static dew_Object *dew_gcAllocate(dew_Script *script, dew_Byte type, dew_Index data) {
+	/**
+	 * Allocate an object with ´data´ bytes after its header. This may collect,
+	 * which moves nursery objects, so values read from the roots before the
+	 * call must be read again afterwards.
+	 */
+	
+	dew_Heap *heap = script->heap;
+	dew_Index size = DEW_GC_ALIGN(sizeof (dew_Object) + data);
+	
+	script->gc.allocated += size;
+	
+	// Objects that would take up a good part of the nursery are not worth
+	// copying later
+	if (size > DEW_NURSERY_SIZE / 8) {
+		return dew_gcOld(script, type, size);
+	}
+	
+	if (heap->nursery_used + size > DEW_NURSERY_SIZE) {
+		dew_gcMinor(script);
+	}
+	
+	dew_Object *object = (dew_Object *) &heap->nursery[heap->nursery_used];
+	
+	heap->nursery_used += size;
+	
+	object->next = NULL;
+	object->size = size;
+	object->type = type;
+	object->flags = 0;
+	
+	return object;
+}
+
+static void dew_gcFree(dew_Script *script) {
+	/**
+	 * Free the heap and everything left on it, after letting a background
+	 * cycle finish.
+	 */
+	
+	dew_Heap *heap = script->heap;
+	
+	if (!heap) {
+		return;
+	}
+
+#ifndef DEW_NO_THREADS
+	dew_gcStep(script, true);
+	pthread_mutex_destroy(&heap->lock);
+	
+	if (heap->satb) {
+		DEW_FREE(heap->satb);
+	}
+#endif
+
+	dew_Object *object = heap->old;
+	
+	while (object) {
+		dew_Object *next = object->next;
+		script->gc.old -= object->size;
+		DEW_FREE(object);
+		object = next;
+	}
+	
+	if (heap->pause_log) {
+		DEW_FREE(heap->pause_log);
+	}
+	
+	DEW_FREE(heap->nursery);
+	DEW_FREE(heap);
+	
+	script->heap = NULL;
+}
+
+static dew_String dew_gcLiteral(dew_Script *script, dew_String string) {
+	/**
+	 * Copy a string literal onto the heap for the chunk being compiled, where
+	 * it stays until the chunk has finished.
+	 */
+	
+	dew_Index length = strlen(string);
+	dew_Object *object = dew_gcOld(script, DEW_OBJECT_STRING, DEW_GC_ALIGN(sizeof *object + length + 1));
+	
+	object->flags |= DEW_GC_PERMANENT;
+	memcpy(object + 1, string, length + 1);
+	
+	return (dew_String) (object + 1);
+}
+
+static void dew_gcEnsure(dew_Script *script) {
+	/**
+	 * Make the script's heap if it does not have one yet. It is kept until
+	 * the script is freed, since the global slots point into it.
+	 */
+	
+	if (script->heap) {
+		return;
+	}
+	
+	script->heap = dew_gcInit();
+	
+	if (!script->heap) {
+		dew_panic("Failed to allocate heap memory.");
+	}
+	
+	script->heap->local = script->slot;
+	script->heap->locals = script->global_count;
+}
+
+static void dew_gcSettle(dew_Script *script) {
+	/**
+	 * Wait for a background cycle to finish, so the old list and the local
+	 * slots can be changed without the collector's thread looking at them.
+	 */
+
+#ifndef DEW_NO_THREADS
+	if (script->heap) {
+		dew_gcStep(script, true);
+	}
+#endif
+}
+
+static void dew_gcEndChunk(dew_Script *script) {
+	/**
+	 * Let go of the chunk that has just run: its literals become ordinary
+	 * objects, which live on only if a global still points at them, and its
+	 * stack stops being a root.
+	 */
+	
+	dew_Heap *heap = script->heap;
+	
+	dew_gcSettle(script);
+	
+	for (dew_Object *object = heap->old; object; object = object->next) {
+		object->flags &= ~DEW_GC_PERMANENT;
+	}
+	
+	heap->stack = NULL;
+	heap->top = NULL;
+}
+
+void dew_printGcStats(dew_Script *script, FILE *out) {
+	/**
+	 * Print the collector's statistics, with the pause histogram.
+	 */
+	
+	dew_GcStats *gc = &script->gc;
+	
+	fprintf(out, "Allocated %zu bytes, promoted %zu, freed %zu, peak old generation %zu.\n", gc->allocated, gc->promoted, gc->freed, gc->peak);
+	fprintf(out, "%zu minor and %zu major collections.\n", gc->minor, gc->major);
+	
+	for (dew_Index i = 0; i < DEW_GC_BUCKETS; i++) {
+		if (gc->pauses[i]) {
+			fprintf(out, "  < %6d us: %zu\n", 1 << i, gc->pauses[i]);
+		}
+	}
+}
+
+#define DEW_GC_BENCH_LIVE 200000
+#define DEW_GC_BENCH_STEPS 2000000
+
+static int dew_gcComparePauses(const void *a, const void *b) {
+	double x = *(const double *) a, y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+static void dew_gcBenchmarkRun(FILE *out, bool concurrent) {
+	/**
+	 * Keep a large set of strings alive in local slots while replacing them
+	 * at random with new ones, and report the pauses that causes.
+	 */
+	
+	dew_Script script;
+	dew_init(&script);
+	
+	script.heap = dew_gcInit();
+	dew_Boxed *live = DEW_ALLOCATE(sizeof *live * DEW_GC_BENCH_LIVE);
+	
+	if (!script.heap || !live) {
+		dew_panic("Failed to allocate benchmark memory.");
+	}
+	
+	memset(live, 0, sizeof *live * DEW_GC_BENCH_LIVE);
+	
+	dew_Heap *heap = script.heap;
+	dew_Boxed stack[1];
+	
+	heap->concurrent = concurrent;
+	heap->stack = stack;
+	heap->top = stack;
+	heap->local = live;
+	heap->locals = DEW_GC_BENCH_LIVE;
+	
+	uint64_t seed = 1;
+	
+	for (dew_Index step = 0; step < DEW_GC_BENCH_LIVE + DEW_GC_BENCH_STEPS; step++) {
+		// Start timing pauses once the live set has been built
+		if (step == DEW_GC_BENCH_LIVE) {
+			heap->pause_alloc = 1024;
+			heap->pause_count = 0;
+			heap->pause_log = DEW_ALLOCATE(sizeof *heap->pause_log * heap->pause_alloc);
+			
+			if (!heap->pause_log) {
+				dew_panic("Failed to allocate benchmark memory.");
+			}
+		}
+		
+		seed = seed * 6364136223846793005 + 1442695040888963407;
+		
+		dew_Index slot = (step < DEW_GC_BENCH_LIVE) ? step : (seed >> 33) % DEW_GC_BENCH_LIVE;
+		char *string = (char *) (dew_gcAllocate(&script, DEW_OBJECT_STRING, 24) + 1);
+		
+		snprintf(string, 24, "string %zu", step);
+		
+		dew_gcStore(&script, &live[slot], (dew_Boxed) {DEW_TYPE_STRING, {.as_string = string}});
+	}
+	
+	double *pauses = heap->pause_log;
+	dew_Index count = heap->pause_count;
+	
+	qsort(pauses, count, sizeof *pauses, dew_gcComparePauses);
+	
+	fprintf(out, "%-16s %6zu pauses, p50 %8.1f us, p99 %8.1f us, max %8.1f us (%zu major)\n", concurrent ? "Concurrent:" : "Stop the world:", count, pauses[count / 2] * 1e6, pauses[count * 99 / 100] * 1e6, pauses[count - 1] * 1e6, script.gc.major);
+	
+	dew_gcFree(&script);
+	DEW_FREE(live);
+	dew_free(&script);
+}
+
+void dew_benchmarkGc(FILE *out) {
+	/**
+	 * Compare pause times with stop the world and background marking.
+	 */
+	
+	dew_gcBenchmarkRun(out, false);
+
+#ifndef DEW_NO_THREADS
+	dew_gcBenchmarkRun(out, true);
+#endif
+}
+
+/**
+ * =============================================================================
+ * Globals
+ * =============================================================================
+ * 
+ * Each global variable has a slot in the script, which is picked when the
+ * compiler first sees its name, so running code reads and writes globals by
+ * index. Names are only searched while compiling and from the embedding API.
+ * A name used before it is declared still gets its slot then, and the
+ * declaration takes that slot over, so the code that used it finds the value
+ * as soon as one has been stored.
+ */
+
+// Slots are 16-bit operands
+#define DEW_GLOBALS_MAX 65536
+
+dew_Integer dew_findGlobal(dew_Script *script, dew_String name) {
+	/**
+	 * Find the slot of a global variable by name, or return -1.
+	 */
+	
+	for (dew_Index i = 0; i < script->global_count; i++) {
+		if (!strcmp(script->global[i].name, name)) {
+			return i;
+		}
+	}
+	
+	return -1;
+}
+
+static dew_Integer dew_reserveGlobal(dew_Script *script, dew_String name) {
+	/**
+	 * Give a name that is not declared yet an empty slot, or return -1 if
+	 * there are no slots left.
+	 */
+	
+	if (script->global_count >= DEW_GLOBALS_MAX) {
+		return -1;
+	}
+	
+	// The background thread might be marking the slots
+	dew_gcSettle(script);
+	
+	if (script->global_count >= script->global_alloc) {
+		script->global_alloc = 16 + script->global_alloc * 2;
+		script->global = DEW_REALLOCATE(script->global, sizeof *script->global * script->global_alloc);
+		script->slot = DEW_REALLOCATE(script->slot, sizeof *script->slot * script->global_alloc);
+		
+		if (!script->global || !script->slot) {
+			dew_panic("Failed to allocate global memory.");
+		}
+	}
+	
+	dew_Index length = strlen(name);
+	char *copy = DEW_ALLOCATE(length + 1);
+	
+	if (!copy) {
+		dew_panic("Failed to allocate global memory.");
+	}
+	
+	memcpy(copy, name, length + 1);
+	
+	script->global[script->global_count] = (dew_Global) {copy, DEW_TYPE_BOXED, 64, false};
+	script->slot[script->global_count] = (dew_Boxed) {DEW_TYPE_BOXED};
+	
+	if (script->heap) {
+		script->heap->local = script->slot;
+		script->heap->locals = script->global_count + 1;
+	}
+	
+	return script->global_count++;
+}
+
+dew_Integer dew_defineGlobal(dew_Script *script, dew_String name, dew_Integer type) {
+	/**
+	 * Declare a global variable of a DEW_TYPE_* and return its slot, or -1 if
+	 * there is no room for it or it is already declared with another type.
+	 * It has no value until a chunk or dew_setGlobal stores one.
+	 */
+	
+	dew_Integer slot = dew_findGlobal(script, name);
+	
+	if (slot < 0) {
+		slot = dew_reserveGlobal(script, name);
+	}
+	
+	if (slot < 0) {
+		return -1;
+	}
+	
+	dew_Global *global = &script->global[slot];
+	
+	if (global->defined) {
+		return (global->type == type) ? slot : -1;
+	}
+	
+	global->type = type;
+	global->bits = 64;
+	global->defined = true;
+	
+	return slot;
+}
+
+dew_Boxed dew_getGlobal(dew_Script *script, dew_Index slot) {
+	/**
+	 * Get the value of a global. It has the type DEW_TYPE_BOXED if nothing
+	 * has been stored yet. Strings belong to the script's heap, so they must
+	 * be copied if they are needed after the script runs again.
+	 */
+	
+	if (slot >= script->global_count) {
+		return (dew_Boxed) {DEW_TYPE_BOXED};
+	}
+	
+	return script->slot[slot];
+}
+
+dew_Boolean dew_setGlobal(dew_Script *script, dew_Index slot, dew_Boxed value) {
+	/**
+	 * Store a value in a declared global, converting it to the declared type
+	 * like an assignment would. Strings are copied onto the script's heap
+	 * unless they are on it already. Returns false if the global is not
+	 * declared or the value does not fit.
+	 */
+	
+	if (slot >= script->global_count || !script->global[slot].defined || value.type == DEW_TYPE_BOXED) {
+		return false;
+	}
+	
+	dew_Global *global = &script->global[slot];
+	
+	if (global->type == DEW_TYPE_NUMBER && value.type == DEW_TYPE_INTEGER) {
+		value = (dew_Boxed) {DEW_TYPE_NUMBER, {.as_number = (dew_Number) value.value.as_integer}};
+	}
+	
+	if (global->type != DEW_TYPE_BOXED && global->type != value.type) {
+		return false;
+	}
+	
+	if (value.type == DEW_TYPE_INTEGER && global->bits < 64) {
+		value.value.as_integer = (global->bits == 16) ? (int16_t) value.value.as_integer : (int32_t) value.value.as_integer;
+	}
+	else if (value.type == DEW_TYPE_NUMBER && global->bits < 64) {
+		value.value.as_number = (float) value.value.as_number;
+	}
+	
+	dew_gcEnsure(script);
+	
+	// A string still in the nursery is already on the heap, and copying it
+	// could collect and move it before it is read, so it is stored as it is
+	if (value.type == DEW_TYPE_STRING && !dew_gcYoung(script->heap, value.value.as_string)) {
+		dew_Index length = strlen(value.value.as_string);
+		dew_Object *object = dew_gcAllocate(script, DEW_OBJECT_STRING, length + 1);
+		
+		memcpy(object + 1, value.value.as_string, length + 1);
+		value.value.as_string = (dew_String) (object + 1);
+	}
+	
+	dew_gcStore(script, &script->slot[slot], value);
+	
+	return true;
+}
+
+static void dew_forgetGlobals(dew_Script *script) {
+	/**
+	 * After a chunk fails, undo the declarations it never got as far as
+	 * storing a value for, so they can be declared again.
+	 */
+	
+	for (dew_Index i = 0; i < script->global_count; i++) {
+		if (script->global[i].defined && script->slot[i].type == DEW_TYPE_BOXED) {
+			script->global[i].defined = false;
+		}
+	}
+}
+
+/**
+ * =============================================================================
+ * Virtual Machine
+ * =============================================================================
+ */
+
+// Opcodes
+enum {
+	DEW_OP_NOP = 0,
+	DEW_OP_RET,
+	DEW_OP_SET,            // set <slot:16>, pops
+	DEW_OP_GET,            // get <slot:16>
+	DEW_OP_GET_LATE,       // get_late <slot:16>, for a global not declared yet
+	DEW_OP_INTEGER,        // integer <value:64>
+	DEW_OP_NUMBER,         // number <value:64>
+	DEW_OP_STRING,         // string <pointer>
+	DEW_OP_TRUE,
+	DEW_OP_FALSE,
+	DEW_OP_NULL,
+	DEW_OP_PRINT,          // pops
+	DEW_OP_CHECK,          // check <type>, unboxes a value into a typed variable
+	
+	// Generic operators, which dispatch on the types of their operands
+	DEW_OP_ADD,
+	DEW_OP_SUBTRACT,
+	DEW_OP_MULTIPLY,
+	DEW_OP_DIVIDE,
+	DEW_OP_MODULO,
+	DEW_OP_NEGATE,
+	DEW_OP_NOT,
+	DEW_OP_EQUAL,
+	DEW_OP_NOT_EQUAL,
+	DEW_OP_LESS,
+	DEW_OP_LESS_EQUAL,
+	DEW_OP_GREATER,
+	DEW_OP_GREATER_EQUAL,
+	
+	// Typed operators, only emitted when the type checker has proven the
+	// types of the operands, so they never look at the type tags
+	DEW_OP_IADD,
+	DEW_OP_ISUB,
+	DEW_OP_IMUL,
+	DEW_OP_IDIV,
+	DEW_OP_IMOD,
+	DEW_OP_INEG,
+	DEW_OP_IEQ,
+	DEW_OP_INE,
+	DEW_OP_ILT,
+	DEW_OP_ILE,
+	DEW_OP_IGT,
+	DEW_OP_IGE,
+	DEW_OP_ITRUNC,         // itrunc <bits>
+	DEW_OP_FADD,
+	DEW_OP_FSUB,
+	DEW_OP_FMUL,
+	DEW_OP_FDIV,
+	DEW_OP_FNEG,
+	DEW_OP_FEQ,
+	DEW_OP_FNE,
+	DEW_OP_FLT,
+	DEW_OP_FLE,
+	DEW_OP_FGT,
+	DEW_OP_FGE,
+	DEW_OP_FTRUNC,
+	DEW_OP_ITOF,
+	DEW_OP_BNOT,
+};
+
+#define DEW_STACK_MAX 256
+
+typedef struct dew_Compiler {
+	dew_Script *script;
+	dew_Chunk *chunk;
+	dew_Index depth;
+} dew_Compiler;
+
+typedef struct dew_Machine {
+	dew_Boxed *local;
+} dew_Machine;
+
+static dew_Chunk *dew_chunkInit(void) {
+	dew_Chunk *chunk = DEW_ALLOCATE(sizeof *chunk);
+	
+	if (!chunk) {
+		return NULL;
+	}
+	
+	memset(chunk, 0, sizeof *chunk);
+	
+	return chunk;
+}
+
+static void dew_chunkFree(dew_Chunk *chunk) {
+	if (chunk->data) {
+		DEW_FREE(chunk->data);
+	}
+	
+	DEW_FREE(chunk);
+}
+
+static void dew_addChunk(dew_Chunk *chunk, uint8_t byte) {
+	if (chunk->count >= chunk->alloc) {
+		chunk->alloc = 2 + chunk->alloc * 2;
+		chunk->data = DEW_REALLOCATE(chunk->data, chunk->alloc);
+		
+		if (!chunk->data) {
+			dew_panic("Failed to allocate chunk memory.");
+		}
+	}
+	
+	chunk->data[chunk->count++] = byte;
+}
+
+static void dew_compileOp(dew_Compiler *compiler, dew_Byte op) {
+	/**
+	 * Write an opcode and count it for the specialisation report.
+	 */
+	
+	dew_addChunk(compiler->chunk, op);
+	
+	compiler->script->instructions++;
+	
+	if (op >= DEW_OP_IADD) {
+		compiler->script->specialised++;
+	}
+}
+
+static void dew_compileBytes(dew_Compiler *compiler, const void *data, dew_Index size) {
+	for (dew_Index i = 0; i < size; i++) {
+		dew_addChunk(compiler->chunk, ((const dew_Byte *) data)[i]);
+	}
+}
+
+static void dew_compileExpression(dew_Compiler *compiler, dew_TreeNode *node);
+
+static void dew_compileAs(dew_Compiler *compiler, dew_TreeNode *node, dew_Integer want) {
+	/**
+	 * Compile an expression and convert it to the wanted static type. Values
+	 * on the stack are always tagged, so boxing is free.
+	 */
+	
+	dew_compileExpression(compiler, node);
+	
+	dew_Integer have = node->static_type;
+	
+	if (have == want || want == DEW_TYPE_BOXED) {
+		return;
+	}
+	
+	if (have == DEW_TYPE_BOXED) {
+		dew_compileOp(compiler, DEW_OP_CHECK);
+		dew_addChunk(compiler->chunk, want);
+	}
+	else {
+		dew_compileOp(compiler, DEW_OP_ITOF);
+	}
+}
+
+static void dew_compileBinary(dew_Compiler *compiler, dew_TreeNode *node, dew_Integer operand, dew_Byte op) {
+	dew_compileAs(compiler, &node->sub[0], operand);
+	dew_compileAs(compiler, &node->sub[1], operand);
+	dew_compileOp(compiler, op);
+}
+
+static void dew_compileExpression(dew_Compiler *compiler, dew_TreeNode *node) {
+	/**
+	 * Compile an expression, leaving its value on the stack. Typed opcodes
+	 * are used wherever the static types of the operands are known.
+	 */
+	
+	if (++compiler->depth >= DEW_STACK_MAX) {
+		dew_raiseError(compiler->script, (dew_Error) {-1, "Error: Expression is nested too deeply."});
+	}
+	
+	dew_Integer have = node->static_type;
+	
+	switch (node->type) {
+		case DEW_NODE_INTEGER: {
+			dew_compileOp(compiler, DEW_OP_INTEGER);
+			dew_compileBytes(compiler, &node->value.as_integer, sizeof node->value.as_integer);
+			break;
+		}
+		
+		case DEW_NODE_NUMBER: {
+			dew_compileOp(compiler, DEW_OP_NUMBER);
+			dew_compileBytes(compiler, &node->value.as_number, sizeof node->value.as_number);
+			break;
+		}
+		
+		case DEW_NODE_STRING: {
+			dew_String string = dew_gcLiteral(compiler->script, node->value.as_string);
+			dew_compileOp(compiler, DEW_OP_STRING);
+			dew_compileBytes(compiler, &string, sizeof string);
+			break;
+		}
+		
+		case DEW_NODE_NULL: {
+			dew_compileOp(compiler, DEW_OP_NULL);
+			break;
+		}
+		
+		case DEW_NODE_SYMBOL: {
+			if (!strcmp(node->value.as_string, "null")) {
+				dew_compileOp(compiler, DEW_OP_NULL);
+			}
+			else if (!strcmp(node->value.as_string, "true")) {
+				dew_compileOp(compiler, DEW_OP_TRUE);
+			}
+			else if (!strcmp(node->value.as_string, "false")) {
+				dew_compileOp(compiler, DEW_OP_FALSE);
+			}
+			else {
+				uint16_t slot = node->slot;
+				dew_compileOp(compiler, node->late ? DEW_OP_GET_LATE : DEW_OP_GET);
+				dew_compileBytes(compiler, &slot, sizeof slot);
+			}
+			
+			break;
+		}
+		
+		case DEW_NODE_GROUPING: {
+			dew_compileExpression(compiler, &node->sub[0]);
+			break;
+		}
+		
+		case DEW_NODE_NOT: {
+			dew_compileExpression(compiler, &node->sub[0]);
+			dew_compileOp(compiler, (node->sub[0].static_type == DEW_TYPE_BOOLEAN) ? DEW_OP_BNOT : DEW_OP_NOT);
+			break;
+		}
+		
+		case DEW_NODE_OPPOSITE: {
+			dew_compileExpression(compiler, &node->sub[0]);
+			dew_compileOp(compiler, (have == DEW_TYPE_INTEGER) ? DEW_OP_INEG : (have == DEW_TYPE_NUMBER) ? DEW_OP_FNEG : DEW_OP_NEGATE);
+			break;
+		}
+		
+		default: {
+			dew_Integer a = node->sub[0].static_type;
+			dew_Integer b = node->sub[1].static_type;
+			
+			// Generic, integer and number forms of each operator
+			dew_Byte generic = DEW_OP_NOP, integer = DEW_OP_NOP, number = DEW_OP_NOP;
+			
+			switch (node->type) {
+				case DEW_NODE_ADD: generic = DEW_OP_ADD; integer = DEW_OP_IADD; number = DEW_OP_FADD; break;
+				case DEW_NODE_SUBTRACT: generic = DEW_OP_SUBTRACT; integer = DEW_OP_ISUB; number = DEW_OP_FSUB; break;
+				case DEW_NODE_MULTIPLY: generic = DEW_OP_MULTIPLY; integer = DEW_OP_IMUL; number = DEW_OP_FMUL; break;
+				case DEW_NODE_DIVIDE: generic = DEW_OP_DIVIDE; integer = DEW_OP_IDIV; number = DEW_OP_FDIV; break;
+				case DEW_NODE_MODULO: generic = DEW_OP_MODULO; integer = DEW_OP_IMOD; number = DEW_OP_MODULO; break;
+				case DEW_NODE_EQUAL: generic = DEW_OP_EQUAL; integer = DEW_OP_IEQ; number = DEW_OP_FEQ; break;
+				case DEW_NODE_NOT_EQUAL: generic = DEW_OP_NOT_EQUAL; integer = DEW_OP_INE; number = DEW_OP_FNE; break;
+				case DEW_NODE_LESS: generic = DEW_OP_LESS; integer = DEW_OP_ILT; number = DEW_OP_FLT; break;
+				case DEW_NODE_LESS_EQUAL: generic = DEW_OP_LESS_EQUAL; integer = DEW_OP_ILE; number = DEW_OP_FLE; break;
+				case DEW_NODE_GREATER: generic = DEW_OP_GREATER; integer = DEW_OP_IGT; number = DEW_OP_FGT; break;
+				case DEW_NODE_GREATER_EQUAL: generic = DEW_OP_GREATER_EQUAL; integer = DEW_OP_IGE; number = DEW_OP_FGE; break;
+			}
+			
+			if (a == DEW_TYPE_INTEGER && b == DEW_TYPE_INTEGER) {
+				dew_compileBinary(compiler, node, DEW_TYPE_INTEGER, integer);
+			}
+			else if (dew_isNumericType(a) && dew_isNumericType(b)) {
+				dew_compileBinary(compiler, node, DEW_TYPE_NUMBER, number);
+			}
+			else {
+				dew_compileBinary(compiler, node, DEW_TYPE_BOXED, generic);
+			}
+			
+			break;
+		}
+	}
+	
+	compiler->depth--;
+}
+
+static void dew_compileStore(dew_Compiler *compiler, dew_Index slot, dew_Integer type) {
+	/**
+	 * Store the top of the stack in a variable, narrowing it to the declared
+	 * width first.
+	 */
+	
+	dew_Byte bits = compiler->script->global[slot].bits;
+	uint16_t operand = slot;
+	
+	if (type == DEW_TYPE_INTEGER && bits < 64) {
+		dew_compileOp(compiler, DEW_OP_ITRUNC);
+		dew_addChunk(compiler->chunk, bits);
+	}
+	else if (type == DEW_TYPE_NUMBER && bits < 64) {
+		dew_compileOp(compiler, DEW_OP_FTRUNC);
+	}
+	
+	dew_compileOp(compiler, DEW_OP_SET);
+	dew_compileBytes(compiler, &operand, sizeof operand);
+}
+
+static void dew_compile(dew_Script *script, dew_Chunk *chunk, dew_TreeNode *root) {
+	/**
+	 * Compile a type checked tree into a chunk of bytecode.
+	 */
+	
+	dew_Compiler compiler;
+	compiler.script = script;
+	compiler.chunk = chunk;
+	compiler.depth = 0;
+	
+	script->instructions = 0;
+	script->specialised = 0;
+	
+	for (dew_Index i = 0; i < root->sub_count; i++) {
+		dew_TreeNode *node = &root->sub[i];
+		
+		if (node->type == DEW_NODE_VAR_DECLARE) {
+			// Typed variables without a value start at zero
+			if (node->sub[2].type == DEW_NODE_NULL && node->static_type != DEW_TYPE_BOXED) {
+				switch (node->static_type) {
+					case DEW_TYPE_INTEGER: {
+						dew_Integer zero = 0;
+						dew_compileOp(&compiler, DEW_OP_INTEGER);
+						dew_compileBytes(&compiler, &zero, sizeof zero);
+						break;
+					}
+					case DEW_TYPE_NUMBER: {
+						dew_Number zero = 0.0;
+						dew_compileOp(&compiler, DEW_OP_NUMBER);
+						dew_compileBytes(&compiler, &zero, sizeof zero);
+						break;
+					}
+					case DEW_TYPE_BOOLEAN: {
+						dew_compileOp(&compiler, DEW_OP_FALSE);
+						break;
+					}
+					case DEW_TYPE_STRING: {
+						dew_String empty = dew_gcLiteral(script, "");
+						dew_compileOp(&compiler, DEW_OP_STRING);
+						dew_compileBytes(&compiler, &empty, sizeof empty);
+						break;
+					}
+				}
+			}
+			else {
+				dew_compileAs(&compiler, &node->sub[2], node->static_type);
+			}
+			
+			dew_compileStore(&compiler, node->slot, node->static_type);
+		}
+		else if (node->type == DEW_NODE_ASSIGN) {
+			dew_compileAs(&compiler, &node->sub[1], node->static_type);
+			dew_compileStore(&compiler, node->slot, node->static_type);
+		}
+		else {
+			dew_compileExpression(&compiler, node);
+			dew_compileOp(&compiler, DEW_OP_PRINT);
+		}
+	}
+	
+	dew_compileOp(&compiler, DEW_OP_RET);
+}
+
+static dew_Number dew_boxedNumber(dew_Script *script, dew_Boxed value) {
+	if (value.type == DEW_TYPE_INTEGER) {
+		return (dew_Number) value.value.as_integer;
+	}
+	
+	if (value.type != DEW_TYPE_NUMBER) {
+		dew_raiseError(script, (dew_Error) {-1, "Runtime error: Expected a number."});
+	}
+	
+	return value.value.as_number;
+}
+
+static dew_Boolean dew_boxedTruthy(dew_Boxed value) {
+	switch (value.type) {
+		case DEW_TYPE_NULL: return false;
+		case DEW_TYPE_INTEGER: return value.value.as_integer != 0;
+		case DEW_TYPE_NUMBER: return value.value.as_number != 0.0;
+		case DEW_TYPE_BOOLEAN: return value.value.as_boolean;
+		default: return true;
+	}
+}
+
+static dew_Boolean dew_boxedEqual(dew_Boxed a, dew_Boxed b) {
+	/**
+	 * Compare two values for equality. Integers and numbers compare by value.
+	 */
+	
+	if (dew_isNumericType(a.type) && dew_isNumericType(b.type) && a.type != b.type) {
+		return ((a.type == DEW_TYPE_INTEGER) ? (dew_Number) a.value.as_integer : a.value.as_number) == ((b.type == DEW_TYPE_INTEGER) ? (dew_Number) b.value.as_integer : b.value.as_number);
+	}
+	
+	if (a.type != b.type) {
+		return false;
+	}
+	
+	switch (a.type) {
+		case DEW_TYPE_NULL: return true;
+		case DEW_TYPE_INTEGER: return a.value.as_integer == b.value.as_integer;
+		case DEW_TYPE_NUMBER: return a.value.as_number == b.value.as_number;
+		case DEW_TYPE_BOOLEAN: return a.value.as_boolean == b.value.as_boolean;
+		case DEW_TYPE_STRING: return !strcmp(a.value.as_string, b.value.as_string);
+		default: return false;
+	}
+}
+
+static dew_String dew_machineConcat(dew_Script *script, dew_Boxed *operands) {
+	/**
+	 * Join the two strings in ´operands´, which must still be on the stack so
+	 * the collector can find them while the result is allocated.
+	 */
+	
+	size_t la = strlen(operands[0].value.as_string), lb = strlen(operands[1].value.as_string);
+	char *res = (char *) (dew_gcAllocate(script, DEW_OBJECT_STRING, la + lb + 1) + 1);
+	
+	memcpy(res, operands[0].value.as_string, la);
+	memcpy(res + la, operands[1].value.as_string, lb + 1);
+	
+	return res;
+}
+
+// Integer arithmetic wraps around instead of overflowing. Dividing the smallest
+// integer by -1 gives itself back instead of trapping, and dividing by zero
+// has to be checked for first.
+#define DEW_INTEGER_ADD(X, Y) ((dew_Integer) ((uint64_t) (X) + (uint64_t) (Y)))
+#define DEW_INTEGER_SUBTRACT(X, Y) ((dew_Integer) ((uint64_t) (X) - (uint64_t) (Y)))
+#define DEW_INTEGER_MULTIPLY(X, Y) ((dew_Integer) ((uint64_t) (X) * (uint64_t) (Y)))
+#define DEW_INTEGER_DIVIDE(X, Y) (((Y) == -1) ? DEW_INTEGER_NEGATE(X) : (X) / (Y))
+#define DEW_INTEGER_MODULO(X, Y) (((Y) == -1) ? 0 : (X) % (Y))
+#define DEW_INTEGER_NEGATE(X) ((dew_Integer) -(uint64_t) (X))
+
+static dew_Boxed dew_genericArith(dew_Script *script, dew_Byte op, dew_Boxed *operands) {
+	/**
+	 * Apply a generic arithmetic operator by looking at the operand types.
+	 */
+	
+	dew_Boxed a = operands[0], b = operands[1];
+	
+	if (op == DEW_OP_ADD && a.type == DEW_TYPE_STRING && b.type == DEW_TYPE_STRING) {
+		return (dew_Boxed) {DEW_TYPE_STRING, {.as_string = dew_machineConcat(script, operands)}};
+	}
+	
+	if (a.type == DEW_TYPE_INTEGER && b.type == DEW_TYPE_INTEGER) {
+		dew_Integer x = a.value.as_integer, y = b.value.as_integer;
+		
+		if ((op == DEW_OP_DIVIDE || op == DEW_OP_MODULO) && y == 0) {
+			dew_raiseError(script, (dew_Error) {-1, "Runtime error: Division by zero."});
+		}
+		
+		switch (op) {
+			case DEW_OP_ADD: x = DEW_INTEGER_ADD(x, y); break;
+			case DEW_OP_SUBTRACT: x = DEW_INTEGER_SUBTRACT(x, y); break;
+			case DEW_OP_MULTIPLY: x = DEW_INTEGER_MULTIPLY(x, y); break;
+			case DEW_OP_DIVIDE: x = DEW_INTEGER_DIVIDE(x, y); break;
+			case DEW_OP_MODULO: x = DEW_INTEGER_MODULO(x, y); break;
+		}
+		
+		return (dew_Boxed) {DEW_TYPE_INTEGER, {.as_integer = x}};
+	}
+	
+	dew_Number x = dew_boxedNumber(script, a), y = dew_boxedNumber(script, b);
+	
+	switch (op) {
+		case DEW_OP_ADD: x = x + y; break;
+		case DEW_OP_SUBTRACT: x = x - y; break;
+		case DEW_OP_MULTIPLY: x = x * y; break;
+		case DEW_OP_DIVIDE: x = x / y; break;
+		case DEW_OP_MODULO: x = fmod(x, y); break;
+	}
+	
+	return (dew_Boxed) {DEW_TYPE_NUMBER, {.as_number = x}};
+}
+
+static void dew_printBoxed(dew_Boxed value) {
+	switch (value.type) {
+		case DEW_TYPE_NULL: printf("null\n"); break;
+		case DEW_TYPE_INTEGER: printf("%" PRId64 "\n", value.value.as_integer); break;
+		case DEW_TYPE_NUMBER: printf("%g\n", value.value.as_number); break;
+		case DEW_TYPE_BOOLEAN: printf("%s\n", value.value.as_boolean ? "true" : "false"); break;
+		case DEW_TYPE_STRING: printf("%s\n", value.value.as_string); break;
+	}
+}
+
+static void dew_execute(dew_Script *script, dew_Chunk *chunk, dew_Machine *machine) {
+	/**
+	 * Run a compiled chunk. Runtime errors are raised on the script.
+	 */
+	
+	dew_Boxed stack[DEW_STACK_MAX];
+	dew_Boxed *top = stack;
+	dew_Boxed *local = machine->local;
+	const dew_Byte *ip = chunk->data;
+	
+	script->heap->stack = stack;
+	script->heap->top = stack;
+
+#define DEW_POP() (*--top)
+#define DEW_PEEK() (top[-1])
+#define DEW_READ(T, VAR) do { memcpy(&(VAR), ip, sizeof (T)); ip += sizeof (T); } while (0)
+#define DEW_INTEGER_BINARY(EXPR) { dew_Integer y = DEW_POP().value.as_integer; dew_Integer x = DEW_PEEK().value.as_integer; DEW_PEEK().value.as_integer = (EXPR); break; }
+#define DEW_NUMBER_BINARY(EXPR) { dew_Number y = DEW_POP().value.as_number; dew_Number x = DEW_PEEK().value.as_number; DEW_PEEK().value.as_number = (EXPR); break; }
+#define DEW_INTEGER_COMPARE(OP) { dew_Integer y = DEW_POP().value.as_integer; dew_Integer x = DEW_PEEK().value.as_integer; DEW_PEEK() = (dew_Boxed) {DEW_TYPE_BOOLEAN, {.as_boolean = x OP y}}; break; }
+#define DEW_NUMBER_COMPARE(OP) { dew_Number y = DEW_POP().value.as_number; dew_Number x = DEW_PEEK().value.as_number; DEW_PEEK() = (dew_Boxed) {DEW_TYPE_BOOLEAN, {.as_boolean = x OP y}}; break; }
+#define DEW_GENERIC_COMPARE(OP) { dew_Boxed b = DEW_POP(); dew_Boxed a = DEW_PEEK(); dew_Boolean r = dew_boxedNumber(script, a) OP dew_boxedNumber(script, b); DEW_PEEK() = (dew_Boxed) {DEW_TYPE_BOOLEAN, {.as_boolean = r}}; break; }
+
+	for (;;) {
+		dew_Byte op = *ip++;
+		
+		switch (op) {
+			case DEW_OP_NOP: break;
+			case DEW_OP_RET: goto done;
+			case DEW_OP_SET: {
+				uint16_t slot;
+				DEW_READ(uint16_t, slot);
+				top--;
+				dew_gcStore(script, &local[slot], *top);
+				break;
+			}
+			
+			case DEW_OP_GET: {
+				uint16_t slot;
+				DEW_READ(uint16_t, slot);
+				*top++ = local[slot];
+				break;
+			}
+			
+			case DEW_OP_GET_LATE: {
+				uint16_t slot;
+				DEW_READ(uint16_t, slot);
+				
+				if (local[slot].type == DEW_TYPE_BOXED) {
+					dew_raiseError(script, (dew_Error) {-1, "Runtime error: Use of a variable before it is declared."});
+				}
+				
+				*top++ = local[slot];
+				break;
+			}
+			case DEW_OP_INTEGER: top->type = DEW_TYPE_INTEGER; DEW_READ(dew_Integer, top->value.as_integer); top++; break;
+			case DEW_OP_NUMBER: top->type = DEW_TYPE_NUMBER; DEW_READ(dew_Number, top->value.as_number); top++; break;
+			case DEW_OP_STRING: top->type = DEW_TYPE_STRING; DEW_READ(dew_String, top->value.as_string); top++; break;
+			case DEW_OP_TRUE: *top++ = (dew_Boxed) {DEW_TYPE_BOOLEAN, {.as_boolean = true}}; break;
+			case DEW_OP_FALSE: *top++ = (dew_Boxed) {DEW_TYPE_BOOLEAN, {.as_boolean = false}}; break;
+			case DEW_OP_NULL: *top++ = (dew_Boxed) {DEW_TYPE_NULL, {0}}; break;
+			case DEW_OP_PRINT: dew_printBoxed(DEW_POP()); break;
+			
+			case DEW_OP_CHECK: {
+				dew_Integer want = *ip++;
+				
+				if (want == DEW_TYPE_NUMBER) {
+					DEW_PEEK() = (dew_Boxed) {DEW_TYPE_NUMBER, {.as_number = dew_boxedNumber(script, DEW_PEEK())}};
+				}
+				else if (DEW_PEEK().type != want) {
+					static char message[64];
+					snprintf(message, sizeof message, "Runtime error: Expected %s.", dew_typeString(want));
+					dew_raiseError(script, (dew_Error) {ip - chunk->data, message});
+				}
+				
+				break;
+			}
+			
+			case DEW_OP_ADD:
+			case DEW_OP_SUBTRACT:
+			case DEW_OP_MULTIPLY:
+			case DEW_OP_DIVIDE:
+			case DEW_OP_MODULO: {
+				script->heap->top = top;
+				dew_Boxed r = dew_genericArith(script, op, top - 2);
+				top--;
+				DEW_PEEK() = r;
+				break;
+			}
+			
+			case DEW_OP_NEGATE: {
+				if (DEW_PEEK().type == DEW_TYPE_INTEGER) {
+					DEW_PEEK().value.as_integer = DEW_INTEGER_NEGATE(DEW_PEEK().value.as_integer);
+				}
+				else {
+					DEW_PEEK() = (dew_Boxed) {DEW_TYPE_NUMBER, {.as_number = -dew_boxedNumber(script, DEW_PEEK())}};
+				}
+				
+				break;
+			}
+			
+			case DEW_OP_NOT: DEW_PEEK() = (dew_Boxed) {DEW_TYPE_BOOLEAN, {.as_boolean = !dew_boxedTruthy(DEW_PEEK())}}; break;
+			case DEW_OP_EQUAL: { dew_Boxed b = DEW_POP(); DEW_PEEK() = (dew_Boxed) {DEW_TYPE_BOOLEAN, {.as_boolean = dew_boxedEqual(DEW_PEEK(), b)}}; break; }
+			case DEW_OP_NOT_EQUAL: { dew_Boxed b = DEW_POP(); DEW_PEEK() = (dew_Boxed) {DEW_TYPE_BOOLEAN, {.as_boolean = !dew_boxedEqual(DEW_PEEK(), b)}}; break; }
+			case DEW_OP_LESS: DEW_GENERIC_COMPARE(<)
+			case DEW_OP_LESS_EQUAL: DEW_GENERIC_COMPARE(<=)
+			case DEW_OP_GREATER: DEW_GENERIC_COMPARE(>)
+			case DEW_OP_GREATER_EQUAL: DEW_GENERIC_COMPARE(>=)
+			
+			case DEW_OP_IADD: DEW_INTEGER_BINARY(DEW_INTEGER_ADD(x, y))
+			case DEW_OP_ISUB: DEW_INTEGER_BINARY(DEW_INTEGER_SUBTRACT(x, y))
+			case DEW_OP_IMUL: DEW_INTEGER_BINARY(DEW_INTEGER_MULTIPLY(x, y))
+			
+			case DEW_OP_IDIV:
+			case DEW_OP_IMOD: {
+				if (DEW_PEEK().value.as_integer == 0) {
+					dew_raiseError(script, (dew_Error) {ip - chunk->data, "Runtime error: Division by zero."});
+				}
+				
+				if (op == DEW_OP_IDIV) DEW_INTEGER_BINARY(DEW_INTEGER_DIVIDE(x, y))
+				else DEW_INTEGER_BINARY(DEW_INTEGER_MODULO(x, y))
+			}
+			
+			case DEW_OP_INEG: DEW_PEEK().value.as_integer = DEW_INTEGER_NEGATE(DEW_PEEK().value.as_integer); break;
+			case DEW_OP_IEQ: DEW_INTEGER_COMPARE(==)
+			case DEW_OP_INE: DEW_INTEGER_COMPARE(!=)
+			case DEW_OP_ILT: DEW_INTEGER_COMPARE(<)
+			case DEW_OP_ILE: DEW_INTEGER_COMPARE(<=)
+			case DEW_OP_IGT: DEW_INTEGER_COMPARE(>)
+			case DEW_OP_IGE: DEW_INTEGER_COMPARE(>=)
+			
+			case DEW_OP_ITRUNC: {
+				dew_Byte bits = *ip++;
+				DEW_PEEK().value.as_integer = (bits == 16) ? (int16_t) DEW_PEEK().value.as_integer : (int32_t) DEW_PEEK().value.as_integer;
+				break;
+			}
+			
+			case DEW_OP_FADD: DEW_NUMBER_BINARY(x + y)
+			case DEW_OP_FSUB: DEW_NUMBER_BINARY(x - y)
+			case DEW_OP_FMUL: DEW_NUMBER_BINARY(x * y)
+			case DEW_OP_FDIV: DEW_NUMBER_BINARY(x / y)
+			case DEW_OP_FNEG: DEW_PEEK().value.as_number = -DEW_PEEK().value.as_number; break;
+			case DEW_OP_FEQ: DEW_NUMBER_COMPARE(==)
+			case DEW_OP_FNE: DEW_NUMBER_COMPARE(!=)
+			case DEW_OP_FLT: DEW_NUMBER_COMPARE(<)
+			case DEW_OP_FLE: DEW_NUMBER_COMPARE(<=)
+			case DEW_OP_FGT: DEW_NUMBER_COMPARE(>)
+			case DEW_OP_FGE: DEW_NUMBER_COMPARE(>=)
+			case DEW_OP_FTRUNC: DEW_PEEK().value.as_number = (float) DEW_PEEK().value.as_number; break;
+			case DEW_OP_ITOF: DEW_PEEK() = (dew_Boxed) {DEW_TYPE_NUMBER, {.as_number = (dew_Number) DEW_PEEK().value.as_integer}}; break;
+			case DEW_OP_BNOT: DEW_PEEK().value.as_boolean = !DEW_PEEK().value.as_boolean; break;
+			
+			default: {
+				dew_raiseError(script, (dew_Error) {ip - chunk->data, "Runtime error: Unknown opcode."});
+			}
+		}
+	}
+
+done:
+	return;
+
+#undef DEW_POP
+#undef DEW_PEEK
+#undef DEW_READ
+#undef DEW_INTEGER_BINARY
+#undef DEW_NUMBER_BINARY
+#undef DEW_INTEGER_COMPARE
+#undef DEW_NUMBER_COMPARE
+#undef DEW_GENERIC_COMPARE
+}
+
+/**
+ * =============================================================================
+ * Script Chunk Running
+ * =============================================================================
+ */
+
+static dew_Error dew_runChunkTimes(dew_Script *script, dew_String code, dew_Index runs, double *seconds) {
+	/**
+	 * Compiles a chunk of code and runs it ´runs´ times, storing the time
+	 * spent running it in ´seconds´ if that is not NULL.
+	 * 
+	 * IMPLEMENTATION NOTES
+	 * ====================
+	 *   * I use a lot of casts to avoid adding volatile to the function
+	 *     declarations because I wrote them before the error infrastrcture was
+	 *     in place. In the future, these should be changed so that the
+	 *     functions accept volatile arguments.
+	 */
+	
+	// Initialise token array
+	// Note: Use volatite otherwise the exact contents of tokens and tree will
+	// not be defined after a longjmp.
+	// https://man7.org/linux/man-pages/man3/setjmp.3.html § NOTES
+	volatile dew_TokenArray tokens = {NULL, 0};
+	dew_TreeNode * volatile tree = NULL;
+	dew_Chunk * volatile chunk = NULL;
+	volatile dew_Machine machine = {NULL};
+	
+	int result = setjmp(script->onError);
+	
+	// We are running for the first time
+	if (!result) {
+		// Tokenise code
+		dew_tokenise(script, (dew_TokenArray *) &tokens, code);
+		
+		// Check for errors
+		if (!tokens.count || !tokens.data) {
+			return (dew_Error) {-1, "No tokens to be had, which cannot be a valid input."};
+		}
+		
+		if (dew_countErrors(script)) {
+			dew_freeTokenArray(&tokens);
+			return (dew_Error) {-1, "Tokenising failed."};
+		}
+		
+		// Parse tokens
+		tree = dew_parse(script, (dew_TokenArray *) &tokens);
+
+#ifdef DEW_DEBUG
+		for (size_t i = 0; i < tokens.count; i++) {
+			printf("Char(%.3d) -> %.3d : %.16X\n", i + 1, tokens.data[i].type, tokens.data[i].value.as_integer);
+		}
+		
+		dew_printTree((dew_TreeNode *) tree, 0);
+#endif
+
+		if (dew_countErrors(script)) {
+			dew_freeTokenArray(&tokens);
+			dew_treeFree((dew_TreeNode *) tree, 0);
+			return (dew_Error) {-1, "Parsing failed."};
+		}
+		
+		// Check types, compile and run
+		dew_typeCheck(script, (dew_TreeNode *) tree);
+		
+		chunk = dew_chunkInit();
+		
+		if (!chunk) {
+			dew_raiseError(script, (dew_Error) {-1, "Failed to allocate memory."});
+		}
+		
+		dew_gcEnsure(script);
+		dew_compile(script, chunk, (dew_TreeNode *) tree);
+		
+		double start = dew_gcNow();
+		
+		for (dew_Index run = 0; run < runs; run++) {
+			machine.local = script->slot;
+			
+			dew_execute(script, chunk, (dew_Machine *) &machine);
+		}
+		
+		if (seconds) {
+			*seconds = dew_gcNow() - start;
+		}
+	}
+	
+	// On an error, note that it's on the error stack so this is (probably) a
+	// bit more acceptable than if we just returned normally.
+	if (script->heap) {
+		dew_gcEndChunk(script);
+	}
+	
+	if (result) {
+		dew_forgetGlobals(script);
+	}
+	
+	if (chunk) {
+		dew_chunkFree(chunk);
+	}
+	
+	if (tokens.count) {
+		dew_freeTokenArray(&tokens);
+	}
+	
+	if (tree) {
+		dew_treeFree((dew_TreeNode *) tree, 0);
+	}
+	
+	return result ? (dew_Error) {result, "Failed to run program."} : (dew_Error) {0, "Finished okay!"};
+}
+
+dew_Error dew_runChunk(dew_Script *script, dew_String code) {
+	/**
+	 * Runs a chunk of code. ´code´ should be a string to the code, and ´script´
+	 * should be an active scripting instance.
+	 */
+	
+	return dew_runChunkTimes(script, code, 1, NULL);
+}
+
+dew_Error dew_benchmarkChunk(dew_Script *script, dew_String code, dew_Index runs, double *seconds) {
+	/**
+	 * Compiles a chunk of code once and runs it ´runs´ times, storing how
+	 * long the runs took in ´seconds´. Compiling is not timed.
+	 */
+	
+	return dew_runChunkTimes(script, code, runs, seconds);
+}
+
+dew_Error dew_emitC(dew_Script *script, dew_String code, FILE *out) {
+	/**
+	 * Compiles a chunk of code to a standalone C program written to ´out´.
+	 * The program includes dew_runtime.h, and declared variables become
+	 * unboxed C locals.
+	 */
+	
+	volatile dew_TokenArray tokens = {NULL, 0};
+	dew_TreeNode * volatile tree = NULL;
+	
+	int result = setjmp(script->onError);
+	
+	if (!result) {
+		dew_tokenise(script, (dew_TokenArray *) &tokens, code);
+		
+		if (!tokens.count || !tokens.data) {
+			return (dew_Error) {-1, "No tokens to be had, which cannot be a valid input."};
+		}
+		
+		if (dew_countErrors(script)) {
+			dew_freeTokenArray(&tokens);
+			return (dew_Error) {-1, "Tokenising failed."};
+		}
+		
+		tree = dew_parse(script, (dew_TokenArray *) &tokens);
+		
+		if (dew_countErrors(script)) {
+			dew_freeTokenArray(&tokens);
+			dew_treeFree((dew_TreeNode *) tree, 0);
+			return (dew_Error) {-1, "Parsing failed."};
+		}
+		
+		dew_typeCheck(script, (dew_TreeNode *) tree);
+		
+		dew_CEmitter emitter = {script, out};
+		dew_emitProgram(&emitter, (dew_TreeNode *) tree);
+	}
+	
+	if (tokens.count) {
+		dew_freeTokenArray(&tokens);
+	}
+	
+	if (tree) {
+		dew_treeFree((dew_TreeNode *) tree, 0);
+	}
+	
+	return result ? (dew_Error) {result, "Failed to compile program."} : (dew_Error) {0, "Finished okay!"};
 }
 
 #endif
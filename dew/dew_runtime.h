@@ -0,0 +1,295 @@
+/**
+ * DewScript C Runtime
+ * ===================
+ * 
+ * This is the runtime for C translation units produced by `dew --emit-c`. The
+ * variables that have a declared type become plain C locals, so this is only
+ * used for dynamically typed (`var`) values, string concatenation and
+ * printing.
+ * 
+ * Everything in here is static, so a generated file only needs this header
+ * on its include path:
+ * 
+ *     cc -O2 -I path/to/dew program.c -lm
+ */
+
+#ifndef DEW_RUNTIME_INCLUDED
+#define DEW_RUNTIME_INCLUDED
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+	DEW_RT_NULL = 0,
+	DEW_RT_INTEGER,
+	DEW_RT_NUMBER,
+	DEW_RT_BOOLEAN,
+	DEW_RT_STRING,
+};
+
+// Operators for the dynamically typed helpers
+enum {
+	DEW_RT_ADD = 0,
+	DEW_RT_SUBTRACT,
+	DEW_RT_MULTIPLY,
+	DEW_RT_DIVIDE,
+	DEW_RT_MODULO,
+	DEW_RT_LESS,
+	DEW_RT_LESS_EQUAL,
+	DEW_RT_GREATER,
+	DEW_RT_GREATER_EQUAL,
+};
+
+typedef struct dew_RtValue {
+	int type;
+	
+	union {
+		int64_t integer;
+		double number;
+		bool boolean;
+		const char *string;
+	} as;
+} dew_RtValue;
+
+static inline void dew_rtPanic(const char * const reason) {
+	/**
+	 * Report a runtime error and exit the application.
+	 */
+	
+	fprintf(stderr, "\033[1mPANIC\033[0m: %s\n\n", reason);
+	
+	exit(1);
+}
+
+static inline dew_RtValue dew_rtNull(void) {
+	return (dew_RtValue) {.type = DEW_RT_NULL};
+}
+
+static inline dew_RtValue dew_rtInteger(int64_t value) {
+	return (dew_RtValue) {.type = DEW_RT_INTEGER, .as.integer = value};
+}
+
+static inline dew_RtValue dew_rtNumber(double value) {
+	return (dew_RtValue) {.type = DEW_RT_NUMBER, .as.number = value};
+}
+
+static inline dew_RtValue dew_rtBoolean(bool value) {
+	return (dew_RtValue) {.type = DEW_RT_BOOLEAN, .as.boolean = value};
+}
+
+static inline dew_RtValue dew_rtString(const char *value) {
+	return (dew_RtValue) {.type = DEW_RT_STRING, .as.string = value};
+}
+
+static inline int64_t dew_rtToInteger(dew_RtValue value) {
+	if (value.type != DEW_RT_INTEGER) {
+		dew_rtPanic("Expected an integer.");
+	}
+	
+	return value.as.integer;
+}
+
+static inline double dew_rtToNumber(dew_RtValue value) {
+	if (value.type == DEW_RT_INTEGER) {
+		return (double) value.as.integer;
+	}
+	
+	if (value.type != DEW_RT_NUMBER) {
+		dew_rtPanic("Expected a number.");
+	}
+	
+	return value.as.number;
+}
+
+static inline bool dew_rtToBoolean(dew_RtValue value) {
+	if (value.type != DEW_RT_BOOLEAN) {
+		dew_rtPanic("Expected a boolean.");
+	}
+	
+	return value.as.boolean;
+}
+
+static inline const char *dew_rtToString(dew_RtValue value) {
+	if (value.type != DEW_RT_STRING) {
+		dew_rtPanic("Expected a string.");
+	}
+	
+	return value.as.string;
+}
+
+// Integer arithmetic wraps around instead of overflowing, and dividing the
+// smallest integer by -1 gives itself back instead of trapping.
+static inline int64_t dew_rtAddInteger(int64_t a, int64_t b) {
+	return (int64_t) ((uint64_t) a + (uint64_t) b);
+}
+
+static inline int64_t dew_rtSubtractInteger(int64_t a, int64_t b) {
+	return (int64_t) ((uint64_t) a - (uint64_t) b);
+}
+
+static inline int64_t dew_rtMultiplyInteger(int64_t a, int64_t b) {
+	return (int64_t) ((uint64_t) a * (uint64_t) b);
+}
+
+static inline int64_t dew_rtNegateInteger(int64_t a) {
+	return (int64_t) -(uint64_t) a;
+}
+
+static inline int64_t dew_rtDivideInteger(int64_t a, int64_t b) {
+	if (b == 0) {
+		dew_rtPanic("Division by zero.");
+	}
+	
+	if (b == -1) {
+		return dew_rtNegateInteger(a);
+	}
+	
+	return a / b;
+}
+
+static inline int64_t dew_rtModuloInteger(int64_t a, int64_t b) {
+	if (b == 0) {
+		dew_rtPanic("Division by zero.");
+	}
+	
+	if (b == -1) {
+		return 0;
+	}
+	
+	return a % b;
+}
+
+static inline const char *dew_rtConcat(const char *a, const char *b) {
+	/**
+	 * Join two strings. Generated programs are short-lived, so the result is
+	 * never freed.
+	 */
+	
+	size_t la = strlen(a), lb = strlen(b);
+	char *res = malloc(la + lb + 1);
+	
+	if (!res) {
+		dew_rtPanic("Failed to allocate string memory.");
+	}
+	
+	memcpy(res, a, la);
+	memcpy(res + la, b, lb + 1);
+	
+	return res;
+}
+
+static inline bool dew_rtTruthy(dew_RtValue value) {
+	switch (value.type) {
+		case DEW_RT_NULL: return false;
+		case DEW_RT_INTEGER: return value.as.integer != 0;
+		case DEW_RT_NUMBER: return value.as.number != 0.0;
+		case DEW_RT_BOOLEAN: return value.as.boolean;
+		default: return true;
+	}
+}
+
+static inline bool dew_rtEqual(dew_RtValue a, dew_RtValue b) {
+	/**
+	 * Compare two values for equality. Integers and numbers compare by value.
+	 */
+	
+	if (a.type == DEW_RT_INTEGER && b.type == DEW_RT_NUMBER) {
+		return (double) a.as.integer == b.as.number;
+	}
+	
+	if (a.type == DEW_RT_NUMBER && b.type == DEW_RT_INTEGER) {
+		return a.as.number == (double) b.as.integer;
+	}
+	
+	if (a.type != b.type) {
+		return false;
+	}
+	
+	switch (a.type) {
+		case DEW_RT_NULL: return true;
+		case DEW_RT_INTEGER: return a.as.integer == b.as.integer;
+		case DEW_RT_NUMBER: return a.as.number == b.as.number;
+		case DEW_RT_BOOLEAN: return a.as.boolean == b.as.boolean;
+		case DEW_RT_STRING: return !strcmp(a.as.string, b.as.string);
+		default: return false;
+	}
+}
+
+static inline dew_RtValue dew_rtArith(int op, dew_RtValue a, dew_RtValue b) {
+	/**
+	 * Apply an arithmetic operator to two dynamically typed values.
+	 */
+	
+	if (op == DEW_RT_ADD && a.type == DEW_RT_STRING && b.type == DEW_RT_STRING) {
+		return dew_rtString(dew_rtConcat(a.as.string, b.as.string));
+	}
+	
+	if (a.type == DEW_RT_INTEGER && b.type == DEW_RT_INTEGER) {
+		switch (op) {
+			case DEW_RT_ADD: return dew_rtInteger(dew_rtAddInteger(a.as.integer, b.as.integer));
+			case DEW_RT_SUBTRACT: return dew_rtInteger(dew_rtSubtractInteger(a.as.integer, b.as.integer));
+			case DEW_RT_MULTIPLY: return dew_rtInteger(dew_rtMultiplyInteger(a.as.integer, b.as.integer));
+			case DEW_RT_DIVIDE: return dew_rtInteger(dew_rtDivideInteger(a.as.integer, b.as.integer));
+			case DEW_RT_MODULO: return dew_rtInteger(dew_rtModuloInteger(a.as.integer, b.as.integer));
+		}
+	}
+	
+	double x = dew_rtToNumber(a), y = dew_rtToNumber(b);
+	
+	switch (op) {
+		case DEW_RT_ADD: return dew_rtNumber(x + y);
+		case DEW_RT_SUBTRACT: return dew_rtNumber(x - y);
+		case DEW_RT_MULTIPLY: return dew_rtNumber(x * y);
+		case DEW_RT_DIVIDE: return dew_rtNumber(x / y);
+		case DEW_RT_MODULO: return dew_rtNumber(fmod(x, y));
+	}
+	
+	dew_rtPanic("Unknown arithmetic operator.");
+	return dew_rtNull();
+}
+
+static inline bool dew_rtCompare(int op, dew_RtValue a, dew_RtValue b) {
+	/**
+	 * Apply an ordering operator to two dynamically typed values.
+	 */
+	
+	double x = dew_rtToNumber(a), y = dew_rtToNumber(b);
+	
+	switch (op) {
+		case DEW_RT_LESS: return x < y;
+		case DEW_RT_LESS_EQUAL: return x <= y;
+		case DEW_RT_GREATER: return x > y;
+		case DEW_RT_GREATER_EQUAL: return x >= y;
+	}
+	
+	dew_rtPanic("Unknown comparison operator.");
+	return false;
+}
+
+static inline dew_RtValue dew_rtNegate(dew_RtValue value) {
+	if (value.type == DEW_RT_INTEGER) {
+		return dew_rtInteger(dew_rtNegateInteger(value.as.integer));
+	}
+	
+	return dew_rtNumber(-dew_rtToNumber(value));
+}
+
+static inline void dew_rtPrint(dew_RtValue value) {
+	/**
+	 * Print a value followed by a new line.
+	 */
+	
+	switch (value.type) {
+		case DEW_RT_NULL: printf("null\n"); break;
+		case DEW_RT_INTEGER: printf("%" PRId64 "\n", value.as.integer); break;
+		case DEW_RT_NUMBER: printf("%g\n", value.as.number); break;
+		case DEW_RT_BOOLEAN: printf("%s\n", value.as.boolean ? "true" : "false"); break;
+		case DEW_RT_STRING: printf("%s\n", value.as.string); break;
+	}
+}
+
+#endif
@@ -7,14 +7,245 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #define DEW_IMPLEMENTATION
 #include "dew.h"
 
+// Dew has no loops, so the benchmark runs the whole script over and over
+#define EMIT_BENCH_RUNS 1000000
+
+static char *readFile(const char *path) {
+	/**
+	 * Read a whole file into a new string, or return NULL.
+	 */
+	
+	FILE *file = fopen(path, "rb");
+	
+	if (!file) {
+		return NULL;
+	}
+	
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	
+	char *data = malloc(size + 1);
+	
+	if (data) {
+		data[fread(data, 1, size, file)] = '\0';
+	}
+	
+	fclose(file);
+	
+	return data;
+}
+
+static int emitC(dew_Script *script, const char *path) {
+	/**
+	 * Handle `dew --emit-c <file>`, writing the C program to stdout.
+	 */
+	
+	char *code = readFile(path);
+	
+	if (!code) {
+		fprintf(stderr, "Could not read '%s'.\n", path);
+		return 1;
+	}
+	
+	dew_Error status = dew_emitC(script, code, stdout);
+	dew_Error err = dew_popError(script);
+	
+	while (err.message != NULL) {
+		fprintf(stderr, "%.3d: %s\n", (int) err.offset, err.message);
+		err = dew_popError(script);
+	}
+	
+	free(code);
+	
+	return status.offset != 0;
+}
+
+static double secondsNow(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double) now.tv_sec + (double) now.tv_nsec * 1e-9;
+}
+
+static int benchmarkEmitC(dew_Script *script, const char *path) {
+	/**
+	 * Handle `dew --emit-c-bench <file>`, timing runs of the file on the VM
+	 * against the same number of runs of the C program emitted for it. The
+	 * program is built with the system's cc, and dew_runtime.h is expected
+	 * next to this file. Output from both is thrown away.
+	 */
+	
+	char *code = readFile(path);
+	
+	if (!code) {
+		fprintf(stderr, "Could not read '%s'.\n", path);
+		return 1;
+	}
+	
+	// The emitted main becomes a function that a new main calls repeatedly
+	char source[] = "/tmp/dew-benchXXXXXX.c";
+	int fd = mkstemps(source, 2);
+	FILE *file = (fd < 0) ? NULL : fdopen(fd, "w");
+	
+	if (!file) {
+		fprintf(stderr, "Could not create a temporary file.\n");
+		free(code);
+		return 1;
+	}
+	
+	fprintf(file, "#define main dew_program\n");
+	
+	dew_Error status = dew_emitC(script, code, file);
+	dew_Error err = dew_popError(script);
+	
+	fprintf(file, "#undef main\n\nint main(void) {\n\tfor (long run = 0; run < %d; run++) {\n\t\tdew_program();\n\t}\n\t\n\treturn 0;\n}\n", EMIT_BENCH_RUNS);
+	fclose(file);
+	
+	while (err.message != NULL) {
+		fprintf(stderr, "%.3d: %s\n", (int) err.offset, err.message);
+		err = dew_popError(script);
+	}
+	
+	char program[sizeof source];
+	char runtime[512];
+	char command[2048];
+	
+	strcpy(program, source);
+	program[strlen(program) - 2] = '\0';
+	
+	snprintf(runtime, sizeof runtime, "%s", __FILE__);
+	char *slash = strrchr(runtime, '/');
+	
+	if (slash) {
+		*slash = '\0';
+	}
+	else {
+		strcpy(runtime, ".");
+	}
+	
+	snprintf(command, sizeof command, "cc -O2 -I '%s' '%s' -o '%s' -lm", runtime, source, program);
+	
+	if (status.offset != 0 || system(command)) {
+		fprintf(stderr, "Could not build the emitted program.\n");
+		remove(source);
+		free(code);
+		return 1;
+	}
+	
+	snprintf(command, sizeof command, "'%s' > /dev/null", program);
+	
+	double start = secondsNow();
+	int failed = system(command);
+	double c_seconds = secondsNow() - start;
+	
+	// Send the VM's output to the same place. Emitting declared the script's
+	// variables, so the VM gets a script of its own.
+	dew_Script machine;
+	double vm_seconds = 0.0;
+	int saved = dup(STDOUT_FILENO);
+	int null = open("/dev/null", O_WRONLY);
+	
+	fflush(stdout);
+	dup2(null, STDOUT_FILENO);
+	
+	dew_init(&machine);
+	status = dew_benchmarkChunk(&machine, code, EMIT_BENCH_RUNS, &vm_seconds);
+	
+	fflush(stdout);
+	dup2(saved, STDOUT_FILENO);
+	close(saved);
+	close(null);
+	
+	err = dew_popError(&machine);
+	
+	while (err.message != NULL) {
+		fprintf(stderr, "%.3d: %s\n", (int) err.offset, err.message);
+		err = dew_popError(&machine);
+	}
+	
+	dew_free(&machine);
+	
+	if (!failed && status.offset == 0) {
+		printf("Ran '%s' %d times: %.3fs on the VM, %.3fs as C (%.1fx)\n", path, EMIT_BENCH_RUNS, vm_seconds, c_seconds, vm_seconds / c_seconds);
+	}
+	
+	remove(source);
+	remove(program);
+	free(code);
+	
+	return failed || status.offset != 0;
+}
+
+static int runFile(dew_Script *script, const char *path) {
+	/**
+	 * Handle `dew <file>`, reporting how much of the bytecode the type checker
+	 * was able to specialise.
+	 */
+	
+	char *code = readFile(path);
+	
+	if (!code) {
+		fprintf(stderr, "Could not read '%s'.\n", path);
+		return 1;
+	}
+	
+	dew_Error status = dew_runChunk(script, code);
+	dew_Error err = dew_popError(script);
+	
+	while (err.message != NULL) {
+		fprintf(stderr, "%.3d: %s\n", (int) err.offset, err.message);
+		err = dew_popError(script);
+	}
+	
+	fprintf(stderr, "Specialised %zu of %zu instructions.\n", script->specialised, script->instructions);
+	
+	free(code);
+	
+	return status.offset != 0;
+}
+
 int main(int argc, const char *argv[]) {
 	dew_Script script;
 	dew_init(&script);
 	
+	if (argc > 2 && !strcmp(argv[1], "--emit-c")) {
+		int status = emitC(&script, argv[2]);
+		dew_free(&script);
+		return status;
+	}
+	
+	if (argc > 2 && !strcmp(argv[1], "--emit-c-bench")) {
+		int status = benchmarkEmitC(&script, argv[2]);
+		dew_free(&script);
+		return status;
+	}
+	
+	if (argc > 1 && !strcmp(argv[1], "--gc-bench")) {
+		dew_benchmarkGc(stdout);
+		dew_free(&script);
+		return 0;
+	}
+	
+	if (argc > 2 && !strcmp(argv[1], "--gc-stats")) {
+		int status = runFile(&script, argv[2]);
+		dew_printGcStats(&script, stderr);
+		dew_free(&script);
+		return status;
+	}
+	
+	if (argc > 1) {
+		int status = runFile(&script, argv[1]);
+		dew_free(&script);
+		return status;
+	}
+	
 	char next[256];
 	
 	while (!feof(stdin)) {
@@ -0,0 +1,226 @@
+// =============================================================================
+// Typed Arrays
+// =============================================================================
+
+// Arrays hold one of the sized types from the documentation at its natural
+// width, so a byte array takes a sixteenth of the memory of the same values as
+// hdw_values. The element-wise builtins are plain loops over the two arrays,
+// which the compiler turns into vector instructions.
+
+// At -O2 GCC only vectorises loops that need no alias check, and the result
+// array may be one of the operands, so the kernels ask for more. Clang
+// vectorises these at -O2 already.
+#if defined(__GNUC__) && !defined(__clang__)
+#define HDW_VECTORISE __attribute__((optimize("tree-vectorize", "vect-cost-model=cheap")))
+#else
+#define HDW_VECTORISE
+#endif
+
+typedef void (*hdw_arraykernel)(void *out, const void *left, const void *right, size_t count);
+
+static const size_t hdw_arraySizes[HDW_ARRAY_TYPE_COUNT] = {
+	[HDW_ARRAY_BYTE] = sizeof (uint8_t),
+	[HDW_ARRAY_INT16] = sizeof (int16_t),
+	[HDW_ARRAY_INT32] = sizeof (int32_t),
+	[HDW_ARRAY_INT64] = sizeof (int64_t),
+	[HDW_ARRAY_INDEX] = sizeof (size_t),
+	[HDW_ARRAY_FLOAT32] = sizeof (float),
+	[HDW_ARRAY_NUMBER] = sizeof (double),
+};
+
+// A kernel applying EXPR of the elements x and y to every pair of elements.
+// Signed integers are added and multiplied as unsigned, so they wrap instead of
+// overflowing.
+#define HDW_ARRAY_KERNEL(NAME, TYPE, EXPR) \
+	HDW_VECTORISE static void NAME(void *out, const void *left, const void *right, size_t count) { \
+		TYPE *dst = out; \
+		const TYPE *a = left; \
+		const TYPE *b = right; \
+		\
+		for (size_t i = 0; i < count; i++) { \
+			TYPE x = a[i]; \
+			TYPE y = b[i]; \
+			dst[i] = EXPR; \
+		} \
+	}
+
+HDW_ARRAY_KERNEL(hdw_arrayAddByte, uint8_t, x + y)
+HDW_ARRAY_KERNEL(hdw_arraySubByte, uint8_t, x - y)
+HDW_ARRAY_KERNEL(hdw_arrayMulByte, uint8_t, x * y)
+HDW_ARRAY_KERNEL(hdw_arrayDivByte, uint8_t, x / y)
+
+HDW_ARRAY_KERNEL(hdw_arrayAddInt16, int16_t, (uint16_t) x + (uint16_t) y)
+HDW_ARRAY_KERNEL(hdw_arraySubInt16, int16_t, (uint16_t) x - (uint16_t) y)
+HDW_ARRAY_KERNEL(hdw_arrayMulInt16, int16_t, (uint16_t) ((uint32_t) (uint16_t) x * (uint16_t) y))
+HDW_ARRAY_KERNEL(hdw_arrayDivInt16, int16_t, (y == -1) ? (uint16_t) -(uint16_t) x : x / y)
+
+HDW_ARRAY_KERNEL(hdw_arrayAddInt32, int32_t, (uint32_t) x + (uint32_t) y)
+HDW_ARRAY_KERNEL(hdw_arraySubInt32, int32_t, (uint32_t) x - (uint32_t) y)
+HDW_ARRAY_KERNEL(hdw_arrayMulInt32, int32_t, (uint32_t) x * (uint32_t) y)
+HDW_ARRAY_KERNEL(hdw_arrayDivInt32, int32_t, (y == -1) ? -(uint32_t) x : (uint32_t) (x / y))
+
+HDW_ARRAY_KERNEL(hdw_arrayAddInt64, int64_t, (uint64_t) x + (uint64_t) y)
+HDW_ARRAY_KERNEL(hdw_arraySubInt64, int64_t, (uint64_t) x - (uint64_t) y)
+HDW_ARRAY_KERNEL(hdw_arrayMulInt64, int64_t, (uint64_t) x * (uint64_t) y)
+HDW_ARRAY_KERNEL(hdw_arrayDivInt64, int64_t, (y == -1) ? -(uint64_t) x : (uint64_t) (x / y))
+
+HDW_ARRAY_KERNEL(hdw_arrayAddIndex, size_t, x + y)
+HDW_ARRAY_KERNEL(hdw_arraySubIndex, size_t, x - y)
+HDW_ARRAY_KERNEL(hdw_arrayMulIndex, size_t, x * y)
+HDW_ARRAY_KERNEL(hdw_arrayDivIndex, size_t, x / y)
+
+HDW_ARRAY_KERNEL(hdw_arrayAddFloat32, float, x + y)
+HDW_ARRAY_KERNEL(hdw_arraySubFloat32, float, x - y)
+HDW_ARRAY_KERNEL(hdw_arrayMulFloat32, float, x * y)
+HDW_ARRAY_KERNEL(hdw_arrayDivFloat32, float, x / y)
+
+HDW_ARRAY_KERNEL(hdw_arrayAddNumber, double, x + y)
+HDW_ARRAY_KERNEL(hdw_arraySubNumber, double, x - y)
+HDW_ARRAY_KERNEL(hdw_arrayMulNumber, double, x * y)
+HDW_ARRAY_KERNEL(hdw_arrayDivNumber, double, x / y)
+
+#undef HDW_ARRAY_KERNEL
+
+enum {
+	HDW_ARRAY_ADD,
+	HDW_ARRAY_SUB,
+	HDW_ARRAY_MUL,
+	HDW_ARRAY_DIV,
+};
+
+static const hdw_arraykernel hdw_arrayKernels[HDW_ARRAY_TYPE_COUNT][4] = {
+	[HDW_ARRAY_BYTE] = {hdw_arrayAddByte, hdw_arraySubByte, hdw_arrayMulByte, hdw_arrayDivByte},
+	[HDW_ARRAY_INT16] = {hdw_arrayAddInt16, hdw_arraySubInt16, hdw_arrayMulInt16, hdw_arrayDivInt16},
+	[HDW_ARRAY_INT32] = {hdw_arrayAddInt32, hdw_arraySubInt32, hdw_arrayMulInt32, hdw_arrayDivInt32},
+	[HDW_ARRAY_INT64] = {hdw_arrayAddInt64, hdw_arraySubInt64, hdw_arrayMulInt64, hdw_arrayDivInt64},
+	[HDW_ARRAY_INDEX] = {hdw_arrayAddIndex, hdw_arraySubIndex, hdw_arrayMulIndex, hdw_arrayDivIndex},
+	[HDW_ARRAY_FLOAT32] = {hdw_arrayAddFloat32, hdw_arraySubFloat32, hdw_arrayMulFloat32, hdw_arrayDivFloat32},
+	[HDW_ARRAY_NUMBER] = {hdw_arrayAddNumber, hdw_arraySubNumber, hdw_arrayMulNumber, hdw_arrayDivNumber},
+};
+
+static bool hdw_arrayIsInteger(uint8_t type) {
+	return type != HDW_ARRAY_FLOAT32 && type != HDW_ARRAY_NUMBER;
+}
+
+bool hdw_arraynew(hdw_array * const restrict array, uint8_t type, size_t count) {
+	/**
+	 * Make an array of count elements of the given type, all zero.
+	 */
+	
+	*array = (hdw_array) {.type = type, .count = count};
+	
+	if (type >= HDW_ARRAY_TYPE_COUNT) {
+		return false;
+	}
+	
+	array->data = hdw_calloc(count ? count : 1, hdw_arraySizes[type]);
+	
+	return array->data != NULL;
+}
+
+void hdw_arrayfree(hdw_array * const restrict array) {
+	free(array->data);
+	
+	*array = (hdw_array) {0};
+}
+
+hdw_value hdw_arrayget(const hdw_array * const restrict array, size_t index) {
+	/**
+	 * Get an element as a value, which is an integer or a number depending on
+	 * the type of the array.
+	 */
+	
+	if (index >= array->count) {
+		return hdw_nullValue();
+	}
+	
+	switch (array->type) {
+		case HDW_ARRAY_BYTE: return hdw_newValue(HDW_TYPE_INTEGER, array->as_bytes[index]);
+		case HDW_ARRAY_INT16: return hdw_newValue(HDW_TYPE_INTEGER, array->as_int16[index]);
+		case HDW_ARRAY_INT32: return hdw_newValue(HDW_TYPE_INTEGER, array->as_int32[index]);
+		case HDW_ARRAY_INT64: return hdw_newValue(HDW_TYPE_INTEGER, array->as_int64[index]);
+		case HDW_ARRAY_INDEX: return hdw_newValue(HDW_TYPE_INTEGER, (int64_t) array->as_index[index]);
+		case HDW_ARRAY_FLOAT32: return hdw_newNumberValue(array->as_float32[index]);
+		case HDW_ARRAY_NUMBER: return hdw_newNumberValue(array->as_number[index]);
+		default: return hdw_nullValue();
+	}
+}
+
+bool hdw_arrayset(hdw_array * const restrict array, size_t index, hdw_value value) {
+	/**
+	 * Store a value in an array. Integer arrays only take integers, which wrap
+	 * to the width of the array, and float arrays take integers and numbers.
+	 */
+	
+	if (index >= array->count) {
+		return false;
+	}
+	
+	if (value.type == HDW_TYPE_INTEGER) {
+		int64_t integer = value.as_integer;
+		
+		switch (array->type) {
+			case HDW_ARRAY_BYTE: array->as_bytes[index] = (uint8_t) integer; return true;
+			case HDW_ARRAY_INT16: array->as_int16[index] = (int16_t) integer; return true;
+			case HDW_ARRAY_INT32: array->as_int32[index] = (int32_t) integer; return true;
+			case HDW_ARRAY_INT64: array->as_int64[index] = integer; return true;
+			case HDW_ARRAY_INDEX: array->as_index[index] = (size_t) integer; return true;
+			case HDW_ARRAY_FLOAT32: array->as_float32[index] = (float) integer; return true;
+			case HDW_ARRAY_NUMBER: array->as_number[index] = (double) integer; return true;
+		}
+	}
+	
+	if (value.type == HDW_TYPE_NUMBER) {
+		switch (array->type) {
+			case HDW_ARRAY_FLOAT32: array->as_float32[index] = (float) value.as_number; return true;
+			case HDW_ARRAY_NUMBER: array->as_number[index] = value.as_number; return true;
+		}
+	}
+	
+	return false;
+}
+
+static int32_t hdw_arrayApply(hdw_array * const dst, const hdw_array * const a, const hdw_array * const b, int op) {
+	/**
+	 * Apply an operator to each pair of elements of two arrays, storing the
+	 * results in dst, which can be one of them. All three must have the same
+	 * type and length.
+	 */
+	
+	hdw_interpreter interpreter = {0};
+	
+	if (a->type != b->type || dst->type != a->type || a->count != b->count || dst->count != a->count || a->type >= HDW_ARRAY_TYPE_COUNT) {
+		hdw_interpreterError(&interpreter, "Element-wise operations need arrays of the same type and length");
+		return HDW_ERR_INTERPRETER;
+	}
+	
+	// Integer division by zero would crash, so check before changing anything
+	if (op == HDW_ARRAY_DIV && hdw_arrayIsInteger(b->type)) {
+		for (size_t i = 0; i < b->count; i++) {
+			if (hdw_arrayget(b, i).as_integer == 0) {
+				hdw_interpreterError(&interpreter, "Division by zero in an integer array");
+				return HDW_ERR_INTERPRETER;
+			}
+		}
+	}
+	
+	hdw_arrayKernels[a->type][op](dst->data, a->data, b->data, a->count);
+	
+	return 0;
+}
+
+int32_t hdw_arrayadd(hdw_array * const dst, const hdw_array * const a, const hdw_array * const b) {
+	return hdw_arrayApply(dst, a, b, HDW_ARRAY_ADD);
+}
+
+int32_t hdw_arraysub(hdw_array * const dst, const hdw_array * const a, const hdw_array * const b) {
+	return hdw_arrayApply(dst, a, b, HDW_ARRAY_SUB);
+}
+
+int32_t hdw_arraymul(hdw_array * const dst, const hdw_array * const a, const hdw_array * const b) {
+	return hdw_arrayApply(dst, a, b, HDW_ARRAY_MUL);
+}
+
+int32_t hdw_arraydiv(hdw_array * const dst, const hdw_array * const a, const hdw_array * const b) {
+	return hdw_arrayApply(dst, a, b, HDW_ARRAY_DIV);
+}
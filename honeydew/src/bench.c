@@ -0,0 +1,285 @@
+// =============================================================================
+// Benchmarks
+// =============================================================================
+
+#define HDW_BENCH_NODES 100000
+#define HDW_BENCH_RUNS 100
+#define HDW_BENCH_LITERALS 1000
+#define HDW_BENCH_TEXTS 16
+#define HDW_BENCH_LIST 4000000
+#define HDW_BENCH_ARRAY 4000000
+
+static hdw_treenode hdw_benchTree(size_t nodes, size_t *leaf) {
+	/**
+	 * Build a balanced arithmetic tree with the given (odd) number of nodes.
+	 * Operators alternate between add and subtract so the value stays small.
+	 */
+	
+	hdw_treenode node = {0};
+	
+	if (nodes <= 1) {
+		node.type = HDW_INTEGER;
+		node.as_integer = (*leaf)++ % 3 + 1;
+		return node;
+	}
+	
+	size_t left = ((nodes - 1) / 2) | 1;
+	
+	node.type = (*leaf % 2) ? HDW_MINUS : HDW_PLUS;
+	node.children_count = 2;
+	node.children = malloc(sizeof *node.children * 2);
+	
+	if (!node.children) {
+		printf("Error: Failed to allocate benchmark tree.\n");
+		exit(1);
+	}
+	
+	node.children[0] = hdw_benchTree(left, leaf);
+	node.children[1] = hdw_benchTree(nodes - 1 - left, leaf);
+	
+	return node;
+}
+
+static void hdw_benchStrings(void) {
+	/**
+	 * Time comparing string literals that share a long prefix, both as
+	 * separately allocated C strings the way the tokeniser used to keep them
+	 * and as interned string values.
+	 */
+	
+	char *copies[HDW_BENCH_LITERALS];
+	hdw_value values[HDW_BENCH_LITERALS];
+	uint64_t copy_allocations = 0, intern_allocations = 0;
+	
+	for (size_t i = 0; i < HDW_BENCH_LITERALS; i++) {
+		char text[64];
+		int length = snprintf(text, sizeof text, "a string literal in the benchmark, number %zu", i % HDW_BENCH_TEXTS);
+		uint64_t allocations = hdw_allocations;
+		
+		copies[i] = hdw_strndup(text, length);
+		copy_allocations += hdw_allocations - allocations;
+		allocations = hdw_allocations;
+		
+		values[i] = (hdw_value) {.type = HDW_TYPE_STRING, .as_string = hdw_stringintern(text, length)};
+		intern_allocations += hdw_allocations - allocations;
+		
+		if (!copies[i] || !values[i].as_string) {
+			printf("Error: Failed to allocate benchmark strings.\n");
+			exit(1);
+		}
+	}
+	
+	hdw_interpreter interpreter = {0};
+	size_t equal = 0;
+	clock_t start = clock();
+	
+	for (size_t n = 0; n < HDW_BENCH_RUNS; n++) {
+		for (size_t i = 0; i < HDW_BENCH_NODES; i++) {
+			equal += !strcmp(copies[i % HDW_BENCH_LITERALS], copies[(i * 7 + n) % HDW_BENCH_LITERALS]);
+		}
+	}
+	
+	double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+	
+	start = clock();
+	
+	for (size_t n = 0; n < HDW_BENCH_RUNS; n++) {
+		for (size_t i = 0; i < HDW_BENCH_NODES; i++) {
+			equal -= hdw_valueEqual(&interpreter, values[i % HDW_BENCH_LITERALS], values[(i * 7 + n) % HDW_BENCH_LITERALS]).as_boolean;
+		}
+	}
+	
+	double interned_seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+	
+	printf("Compared strings %d times: %.2f ns with strcmp, %.2f ns interned (%.2fx)%s\n", HDW_BENCH_NODES * HDW_BENCH_RUNS, seconds * 1e9 / ((double) HDW_BENCH_NODES * HDW_BENCH_RUNS), interned_seconds * 1e9 / ((double) HDW_BENCH_NODES * HDW_BENCH_RUNS), seconds / interned_seconds, equal ? ", results differ" : "");
+	printf("%d string literals took %" PRIu64 " allocations as copies and %" PRIu64 " interned.\n", HDW_BENCH_LITERALS, copy_allocations, intern_allocations);
+	
+	for (size_t i = 0; i < HDW_BENCH_LITERALS; i++) {
+		free(copies[i]);
+	}
+}
+
+static void hdw_benchLists(void) {
+	/**
+	 * Time searching and summing a long list of integers with the builtins,
+	 * packed and boxed. A script searching the list itself does at least what
+	 * the boxed search does, one value comparison per element.
+	 */
+	
+	hdw_list packed = {0}, boxed = {0};
+	
+	for (size_t i = 0; i < HDW_BENCH_LIST; i++) {
+		hdw_value value = hdw_newValue(HDW_TYPE_INTEGER, i % 1000);
+		
+		if (!hdw_listpush(&packed, value) || !hdw_listpush(&boxed, value)) {
+			printf("Error: Failed to allocate benchmark lists.\n");
+			exit(1);
+		}
+	}
+	
+	if (!hdw_listBox(&boxed)) {
+		printf("Error: Failed to allocate benchmark lists.\n");
+		exit(1);
+	}
+	
+	// Not in the list, so every search goes all the way to the end
+	hdw_value missing = hdw_newValue(HDW_TYPE_INTEGER, -1);
+	hdw_list *lists[2] = {&packed, &boxed};
+	double search[2], sum[2];
+	int64_t found[2] = {0}, total[2] = {0};
+	
+	for (size_t l = 0; l < 2; l++) {
+		clock_t start = clock();
+		
+		for (size_t n = 0; n < HDW_BENCH_RUNS / 10; n++) {
+			found[l] += hdw_listindexof(lists[l], missing);
+		}
+		
+		search[l] = (double) (clock() - start) / CLOCKS_PER_SEC;
+		start = clock();
+		
+		for (size_t n = 0; n < HDW_BENCH_RUNS / 10; n++) {
+			hdw_value result;
+			hdw_listsum(lists[l], &result);
+			total[l] += result.as_integer;
+		}
+		
+		sum[l] = (double) (clock() - start) / CLOCKS_PER_SEC;
+	}
+	
+	double elements = (double) HDW_BENCH_LIST * (HDW_BENCH_RUNS / 10);
+	
+	printf("Searched %d integers: %.3f ns/element packed%s, %.3f ns/element boxed (%.2fx)\n", HDW_BENCH_LIST, search[0] * 1e9 / elements, hdw_listUseAvx2() ? " with AVX2" : "", search[1] * 1e9 / elements, search[1] / search[0]);
+	printf("Summed %d integers: %.3f ns/element packed, %.3f ns/element boxed (%.2fx)%s\n", HDW_BENCH_LIST, sum[0] * 1e9 / elements, sum[1] * 1e9 / elements, sum[1] / sum[0], (found[0] != found[1] || total[0] != total[1]) ? ", results differ" : "");
+	
+	hdw_listfree(&packed);
+	hdw_listfree(&boxed);
+}
+
+static void hdw_benchArrays(void) {
+	/**
+	 * Time adding two long arrays element by element, as typed arrays and as
+	 * arrays of values added with the interpreter's value function.
+	 */
+	
+	static const struct {
+		uint8_t type;
+		const char *name;
+	} types[] = {
+		{HDW_ARRAY_BYTE, "byte"},
+		{HDW_ARRAY_INT32, "int32"},
+		{HDW_ARRAY_FLOAT32, "float32"},
+		{HDW_ARRAY_NUMBER, "number"},
+	};
+	
+	hdw_value *values = malloc(sizeof *values * HDW_BENCH_ARRAY);
+	
+	if (!values) {
+		printf("Error: Failed to allocate benchmark arrays.\n");
+		exit(1);
+	}
+	
+	for (size_t i = 0; i < HDW_BENCH_ARRAY; i++) {
+		values[i] = hdw_newNumberValue((double) (i % 100));
+	}
+	
+	hdw_interpreter interpreter = {0};
+	clock_t start = clock();
+	
+	for (size_t n = 0; n < HDW_BENCH_RUNS / 10; n++) {
+		for (size_t i = 0; i < HDW_BENCH_ARRAY; i++) {
+			values[i] = hdw_valueAdd(&interpreter, values[i], values[i]);
+		}
+	}
+	
+	double boxed = (double) (clock() - start) / CLOCKS_PER_SEC;
+	double elements = (double) HDW_BENCH_ARRAY * (HDW_BENCH_RUNS / 10);
+	
+	printf("Added %d values: %.3f ns/element, %zu bytes each\n", HDW_BENCH_ARRAY, boxed * 1e9 / elements, sizeof *values);
+	
+	free(values);
+	
+	for (size_t t = 0; t < sizeof types / sizeof *types; t++) {
+		hdw_array array;
+		
+		if (!hdw_arraynew(&array, types[t].type, HDW_BENCH_ARRAY)) {
+			printf("Error: Failed to allocate benchmark arrays.\n");
+			exit(1);
+		}
+		
+		for (size_t i = 0; i < HDW_BENCH_ARRAY; i++) {
+			hdw_arrayset(&array, i, hdw_newValue(HDW_TYPE_INTEGER, i % 100));
+		}
+		
+		start = clock();
+		
+		for (size_t n = 0; n < HDW_BENCH_RUNS / 10; n++) {
+			hdw_arrayadd(&array, &array, &array);
+		}
+		
+		double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+		
+		printf("Added %d %s elements: %.3f ns/element (%.2fx), %zu bytes each\n", HDW_BENCH_ARRAY, types[t].name, seconds * 1e9 / elements, boxed / seconds, hdw_arraySizes[types[t].type]);
+		
+		hdw_arrayfree(&array);
+	}
+}
+
+void hdw_benchmark(void) {
+	/**
+	 * Time the tree interpreter and the closure compiler on a large
+	 * arithmetic expression, counting the allocations they make, then string
+	 * comparisons.
+	 */
+	
+	size_t leaf = 0;
+	hdw_treenode tree = hdw_benchTree(HDW_BENCH_NODES - 1, &leaf);
+	hdw_value result;
+	
+	uint64_t allocations = hdw_allocations;
+	clock_t start = clock();
+	
+	for (size_t i = 0; i < HDW_BENCH_RUNS; i++) {
+		hdw_interpret(&tree, &result);
+	}
+	
+	double seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+	
+	allocations = hdw_allocations - allocations;
+	
+	printf("Interpreted %d nodes %d times in %.3fs (%.2f ns/node, %" PRIu64 " allocations), result ", HDW_BENCH_NODES - 1, HDW_BENCH_RUNS, seconds, seconds * 1e9 / ((double) (HDW_BENCH_NODES - 1) * HDW_BENCH_RUNS), allocations);
+	hdw_printValue(&result);
+	
+	// Closures, including the time to build them. The expression is all
+	// literals, so folding is turned off or there would be nothing to run.
+	hdw_closure closure;
+	hdw_interpreter interpreter = {0};
+	uint64_t build_allocations = 0;
+	
+	allocations = hdw_allocations;
+	start = clock();
+	
+	for (size_t i = 0; i < HDW_BENCH_RUNS; i++) {
+		if (i == 0) {
+			hdw_closureBuild(&tree, &closure, false);
+			build_allocations = hdw_allocations - allocations;
+		}
+		
+		hdw_closurerun(&interpreter, &closure, &result);
+	}
+	
+	double closure_seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+	
+	allocations = hdw_allocations - allocations - build_allocations;
+	
+	printf("Ran closures %d times in %.3fs (%.2fx, %" PRIu64 " allocations to build and %" PRIu64 " to run), result ", HDW_BENCH_RUNS, closure_seconds, seconds / closure_seconds, build_allocations, allocations);
+	hdw_printValue(&result);
+	printf("Closures specialised %u times and despecialised %u times.\n", interpreter.specialisations, interpreter.despecialisations);
+	
+	hdw_closurefree(&closure);
+	hdw_treefree(&tree);
+	
+	hdw_benchStrings();
+	hdw_benchLists();
+	hdw_benchArrays();
+}
@@ -2,8 +2,439 @@
 // Bytecode Compiler
 // =============================================================================
 
-#if 0
+static const char * const hdw_opNames[] = {
+	"const", "move", "neg", "not", "add", "sub", "mul", "div", "eq", "noteq",
+	"lt", "gt", "lteq", "gteq", "jump", "jumpifnot", "return",
+};
+
+static double hdw_seconds(void) {
+	struct timespec now;
+	
+	timespec_get(&now, TIME_UTC);
+	
+	return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+static bool hdw_splitCriticalEdges(hdw_irfunction *fn) {
+	/**
+	 * Put an empty block on every edge from a block with two successors to a
+	 * block with phis. The moves for a phi go at the end of the predecessor,
+	 * which would otherwise also run when it goes the other way.
+	 */
+	
+	uint32_t block_count = fn->block_count;
+	
+	for (uint32_t i = 0; i < block_count; i++) {
+		for (uint32_t j = 0; fn->blocks[i].succs_count == 2 && j < 2; j++) {
+			uint32_t succ = fn->blocks[i].succs[j];
+			bool phis = false;
+			
+			for (uint32_t k = 0; k < fn->blocks[succ].count; k++) {
+				phis = phis || fn->instrs[fn->blocks[succ].code[k]].op == HDW_IR_PHI;
+			}
+			
+			if (!phis) {
+				continue;
+			}
+			
+			uint32_t split = hdw_irNewBlock(fn);
+			
+			if (split == HDW_IR_NONE || hdw_irNew(fn, split, HDW_IR_JUMP, 0, 0, 0) == HDW_IR_NONE) {
+				return false;
+			}
+			
+			fn->blocks[i].succs[j] = split;
+			fn->blocks[split].succs[0] = succ;
+			fn->blocks[split].succs_count = 1;
+			
+			if (!hdw_irAppend(fn, &fn->blocks[split].preds, &fn->blocks[split].preds_count, i)) {
+				return false;
+			}
+			
+			// Keep the position in the list, which is what phi arguments
+			// are matched up by
+			for (uint32_t k = 0; k < fn->blocks[succ].preds_count; k++) {
+				if (fn->blocks[succ].preds[k] == i) {
+					fn->blocks[succ].preds[k] = split;
+					break;
+				}
+			}
+		}
+	}
+	
+	return true;
+}
+
+static bool hdw_emit(hdw_bytecode *out, size_t *alloc, uint16_t op, uint32_t dst, uint32_t a, uint32_t b) {
+	if (out->count >= *alloc) {
+		*alloc = *alloc ? *alloc * 2 : 64;
+		hdw_instruction *code = hdw_realloc(out->code, sizeof *code * *alloc);
+		
+		if (!code) {
+			return false;
+		}
+		
+		out->code = code;
+	}
+	
+	out->code[out->count++] = (hdw_instruction) {dst, a, b, op};
+	
+	return true;
+}
+
+static bool hdw_emitPhiMoves(hdw_irfunction *fn, hdw_bytecode *out, size_t *alloc, const uint32_t *reg, uint32_t from, uint32_t to, uint32_t *temps) {
+	/**
+	 * Emit the moves that give the phis in block to their values for the edge
+	 * coming from block from. All the phis take their values at once, so when
+	 * one phi's value is another phi of the same block (as when two variables
+	 * are swapped in a loop) everything goes through temporary registers.
+	 */
+	
+	const hdw_irblock *b = &fn->blocks[to];
+	uint32_t pred = 0;
+	uint32_t phis = 0;
+	bool overlap = false;
+	
+	while (b->preds[pred] != from) {
+		pred++;
+	}
+	
+	for (uint32_t i = 0; i < b->count; i++) {
+		const hdw_irinstr *phi = &fn->instrs[b->code[i]];
+		
+		if (phi->op == HDW_IR_PHI) {
+			const hdw_irinstr *arg = &fn->instrs[phi->phi_args[pred]];
+			
+			overlap = overlap || (arg->op == HDW_IR_PHI && arg->block == to);
+			phis++;
+		}
+	}
+	
+	if (overlap && phis > *temps) {
+		*temps = phis;
+	}
+	
+	uint32_t temp = 0;
+	bool ok = true;
+	
+	for (uint32_t i = 0; i < b->count; i++) {
+		uint32_t id = b->code[i];
+		const hdw_irinstr *phi = &fn->instrs[id];
+		
+		if (phi->op != HDW_IR_PHI) {
+			continue;
+		}
+		
+		uint32_t src = reg[phi->phi_args[pred]];
+		uint32_t dst = overlap ? reg[fn->count] + temp++ : reg[id];
+		
+		if (src != dst) {
+			ok = ok && hdw_emit(out, alloc, HDW_OP_MOVE, dst, src, 0);
+		}
+	}
+	
+	temp = 0;
+	
+	for (uint32_t i = 0; overlap && i < b->count; i++) {
+		uint32_t id = b->code[i];
+		
+		if (fn->instrs[id].op == HDW_IR_PHI) {
+			ok = ok && hdw_emit(out, alloc, HDW_OP_MOVE, reg[id], reg[fn->count] + temp++, 0);
+		}
+	}
+	
+	return ok;
+}
+
+static int32_t hdw_emitFunction(hdw_irfunction *fn, hdw_bytecode *out) {
+	/**
+	 * Emit register bytecode for a function. Every value gets its own
+	 * register, phis become moves at the end of their predecessors, and
+	 * blocks are laid out in reverse postorder so that most jumps to the next
+	 * block can be left out.
+	 */
+	
+	if (!hdw_splitCriticalEdges(fn) || !hdw_irComputeOrder(fn)) {
+		return HDW_ERR_COMPILER;
+	}
+	
+	// One more entry for the first temporary register
+	uint32_t *reg = hdw_malloc(sizeof *reg * (fn->count + 1));
+	size_t *start = hdw_malloc(sizeof *start * fn->block_count);
+	size_t alloc = 0, constant_alloc = 0;
+	uint32_t registers = 0, temps = 0;
+	bool ok = reg && start;
+	
+	for (uint32_t i = 0; ok && i < fn->order_count; i++) {
+		const hdw_irblock *b = &fn->blocks[fn->order[i]];
+		
+		for (uint32_t j = 0; j < b->count; j++) {
+			if (!hdw_irIsTerminator(fn->instrs[b->code[j]].op)) {
+				reg[b->code[j]] = registers++;
+			}
+		}
+	}
+	
+	if (ok) {
+		reg[fn->count] = registers;
+	}
+	
+	for (uint32_t i = 0; ok && i < fn->order_count; i++) {
+		uint32_t block = fn->order[i];
+		uint32_t next = (i + 1 < fn->order_count) ? fn->order[i + 1] : HDW_IR_NONE;
+		const hdw_irblock *b = &fn->blocks[block];
+		
+		start[block] = out->count;
+		
+		for (uint32_t j = 0; ok && j < b->count; j++) {
+			const hdw_irinstr *instr = &fn->instrs[b->code[j]];
+			uint32_t dst = hdw_irIsTerminator(instr->op) ? 0 : reg[b->code[j]];
+			uint32_t a = (instr->args_count > 0 && instr->op != HDW_IR_PHI) ? reg[instr->args[0]] : 0;
+			uint32_t c = (instr->args_count > 1 && instr->op != HDW_IR_PHI) ? reg[instr->args[1]] : 0;
+			
+			// Phi moves go before the jump out of the block
+			if (b->succs_count == 1 && hdw_irIsTerminator(instr->op)) {
+				ok = hdw_emitPhiMoves(fn, out, &alloc, reg, block, b->succs[0], &temps);
+				
+				if (!ok) {
+					break;
+				}
+			}
+			
+			switch (instr->op) {
+				case HDW_IR_PHI: {
+					break;
+				}
+				case HDW_IR_CONST: {
+					if (out->constant_count >= constant_alloc) {
+						constant_alloc = constant_alloc ? constant_alloc * 2 : 16;
+						hdw_value *constants = hdw_realloc(out->constants, sizeof *constants * constant_alloc);
+						
+						if (!constants) {
+							ok = false;
+							break;
+						}
+						
+						out->constants = constants;
+					}
+					
+					out->constants[out->constant_count] = instr->constant;
+					ok = hdw_emit(out, &alloc, HDW_OP_CONST, dst, out->constant_count++, 0);
+					break;
+				}
+				case HDW_IR_COPY: {
+					ok = hdw_emit(out, &alloc, HDW_OP_MOVE, dst, a, 0);
+					break;
+				}
+				case HDW_IR_JUMP: {
+					if (b->succs[0] != next) {
+						ok = hdw_emit(out, &alloc, HDW_OP_JUMP, 0, b->succs[0], 0);
+					}
+					
+					break;
+				}
+				case HDW_IR_BRANCH: {
+					ok = hdw_emit(out, &alloc, HDW_OP_JUMPIFNOT, 0, a, b->succs[1]);
+					
+					if (ok && b->succs[0] != next) {
+						ok = hdw_emit(out, &alloc, HDW_OP_JUMP, 0, b->succs[0], 0);
+					}
+					
+					break;
+				}
+				case HDW_IR_RETURN: {
+					ok = hdw_emit(out, &alloc, HDW_OP_RETURN, 0, a, 0);
+					break;
+				}
+				default: {
+					// The rest map straight on to a bytecode instruction
+					ok = hdw_emit(out, &alloc, HDW_OP_NEG + (instr->op - HDW_IR_NEG), dst, a, c);
+					break;
+				}
+			}
+		}
+	}
+	
+	// Jumps were emitted with the block they go to
+	for (size_t i = 0; ok && i < out->count; i++) {
+		if (out->code[i].op == HDW_OP_JUMP) {
+			out->code[i].a = start[out->code[i].a];
+		}
+		else if (out->code[i].op == HDW_OP_JUMPIFNOT) {
+			out->code[i].b = start[out->code[i].b];
+		}
+	}
+	
+	out->registers = registers + temps;
+	
+	free(reg);
+	free(start);
+	
+	if (!ok) {
+		fn->error = "Out of memory";
+		return HDW_ERR_COMPILER;
+	}
+	
+	return HDW_ERR_OKAY;
+}
+
+static void hdw_recordPass(hdw_compiler *compiler, const char *name, double start, size_t before, size_t after) {
+	if (compiler->pass_count < HDW_PASS_MAX) {
+		compiler->passes[compiler->pass_count++] = (hdw_passtime) {name, hdw_seconds() - start, before, after};
+	}
+}
+
+static void hdw_runPass(hdw_compiler *compiler, hdw_irfunction *fn, const char *name, void (*pass)(hdw_irfunction *)) {
+	/**
+	 * Run an optimisation pass, timing it and noting how many instructions it
+	 * removed.
+	 */
+	
+	if (fn->error) {
+		return;
+	}
+	
+	size_t before = hdw_irSize(fn);
+	double start = hdw_seconds();
+	
+	pass(fn);
+	
+	hdw_recordPass(compiler, name, start, before, hdw_irSize(fn));
+	
+	if (compiler->dump) {
+		hdw_irPrint(fn, name);
+	}
+}
+
 int32_t hdw_compile(hdw_compiler * const restrict compiler, hdw_treenode * const restrict tree) {
+	/**
+	 * Compile a tree to bytecode in compiler->output. The tree is lowered to
+	 * SSA form, optimised if compiler->optimise is set, and then emitted. How
+	 * long each step took is kept in compiler->passes, and the IR is printed
+	 * after each step if compiler->dump is set.
+	 * 
+	 * The bytecode refers to strings in the tree, so the tree has to be kept
+	 * around for as long as the bytecode is.
+	 */
+	
+	hdw_irfunction fn;
+	
+	hdw_irInit(&fn);
+	memset(&compiler->output, 0, sizeof compiler->output);
+	compiler->pass_count = 0;
+	
+	double start = hdw_seconds();
+	int32_t status = hdw_irBuild(&fn, tree);
+	
+	hdw_recordPass(compiler, "lower", start, 0, hdw_irSize(&fn));
+	
+	if (!status && compiler->dump) {
+		hdw_irPrint(&fn, "lower");
+	}
+	
+	if (!status && compiler->optimise) {
+		hdw_runPass(compiler, &fn, "copy propagation", hdw_irCopyPropagation);
+		hdw_runPass(compiler, &fn, "value numbering", hdw_irValueNumbering);
+		hdw_runPass(compiler, &fn, "copy propagation", hdw_irCopyPropagation);
+		hdw_runPass(compiler, &fn, "loop invariant code motion", hdw_irLoopInvariantCodeMotion);
+		hdw_runPass(compiler, &fn, "dead code elimination", hdw_irDeadCodeElimination);
+		
+		if (fn.error) {
+			status = HDW_ERR_COMPILER;
+		}
+	}
+	
+	if (!status) {
+		size_t before = hdw_irSize(&fn);
+		
+		start = hdw_seconds();
+		status = hdw_emitFunction(&fn, &compiler->output);
+		hdw_recordPass(compiler, "emit", start, before, compiler->output.count);
+	}
+	
+	if (status) {
+		printf("Compiler error: %s.\n", fn.error ? fn.error : "Unknown error");
+		hdw_freebytecode(&compiler->output);
+	}
+	
+	hdw_irFree(&fn);
+	
+	return status;
+}
+
+void hdw_printpasses(const hdw_compiler * const restrict compiler) {
+	/**
+	 * Print how long each step of the last compile took and how many
+	 * instructions there were before and after it.
+	 */
+	
+	double total = 0.0;
+	
+	printf("%-28s %12s %8s %8s\n", "pass", "time (ms)", "before", "after");
+	
+	for (size_t i = 0; i < compiler->pass_count; i++) {
+		const hdw_passtime *pass = &compiler->passes[i];
+		
+		printf("%-28s %12.3f %8zu %8zu\n", pass->name, pass->seconds * 1000.0, pass->before, pass->after);
+		total += pass->seconds;
+	}
+	
+	printf("%-28s %12.3f\n", "total", total * 1000.0);
+}
+
+void hdw_printbytecode(const hdw_bytecode * const restrict code) {
+	/**
+	 * Print a listing of some bytecode.
+	 */
+	
+	printf("== bytecode (%zu instructions, %u registers) ==\n", code->count, code->registers);
+	
+	for (size_t i = 0; i < code->count; i++) {
+		const hdw_instruction *instr = &code->code[i];
+		
+		printf("%.4zX  %-10s", i, hdw_opNames[instr->op]);
+		
+		switch (instr->op) {
+			case HDW_OP_CONST: {
+				printf("r%u = ", instr->dst);
+				hdw_irPrintConstant(code->constants[instr->a]);
+				break;
+			}
+			case HDW_OP_MOVE:
+			case HDW_OP_NEG:
+			case HDW_OP_NOT: {
+				printf("r%u = r%u", instr->dst, instr->a);
+				break;
+			}
+			case HDW_OP_JUMP: {
+				printf("%.4X", instr->a);
+				break;
+			}
+			case HDW_OP_JUMPIFNOT: {
+				printf("r%u %.4X", instr->a, instr->b);
+				break;
+			}
+			case HDW_OP_RETURN: {
+				printf("r%u", instr->a);
+				break;
+			}
+			default: {
+				printf("r%u = r%u r%u", instr->dst, instr->a, instr->b);
+				break;
+			}
+		}
+		
+		printf("\n");
+	}
+}
+
+void hdw_freebytecode(hdw_bytecode * const restrict code) {
+	/**
+	 * Free the bytecode from hdw_compile.
+	 */
+	
+	free(code->code);
+	free(code->constants);
 	
+	memset(code, 0, sizeof *code);
 }
-#endif
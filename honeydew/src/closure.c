@@ -0,0 +1,368 @@
+// =============================================================================
+// Closure Compiler
+// =============================================================================
+
+// Each tree node becomes a closure holding a pointer to the function that
+// evaluates exactly that kind of node, so evaluation is a chain of indirect
+// calls with no dispatch on the node type. Constant subtrees are folded, and
+// operators with a literal operand get their own evaluators that read it
+// straight out of the closure.
+// 
+// Operators on two subtrees also rewrite themselves from the types they see.
+// They start out uninitialised, become an integer or number node with a guard
+// the first time they run, and fall back to the generic node for good if the
+// guard ever fails.
+
+static hdw_value hdw_closureConstant(hdw_interpreter *interpreter, hdw_closure * const restrict self) {
+	(void) interpreter;
+	
+	return self->constant;
+}
+
+static hdw_value hdw_closureError(hdw_interpreter *interpreter, hdw_closure * const restrict self) {
+	hdw_interpreterError(interpreter, self->constant.as_string ? self->constant.as_string->data : "Out of memory");
+	return hdw_nullValue();
+}
+
+static hdw_value hdw_valueNotEqual(hdw_interpreter *interpreter, const hdw_value left, const hdw_value right) {
+	return hdw_not(hdw_valueEqual(interpreter, left, right));
+}
+
+// Whether integer division by X can't trap, which is left to hdw_valueDiv
+#define HDW_CLOSURE_SAFE_DIVISOR(X) ((X) != 0 && (X) != -1)
+
+// Evaluators for a binary operator with two subtrees, a constant left operand
+// and a constant right operand.
+#define HDW_CLOSURE_BINARY(NAME, FN) \
+	static hdw_value hdw_closure##NAME##Generic(hdw_interpreter *interpreter, hdw_closure * const restrict self) { \
+		hdw_value left = self->children[0].eval(interpreter, &self->children[0]); \
+		hdw_value right = self->children[1].eval(interpreter, &self->children[1]); \
+		return FN(interpreter, left, right); \
+	} \
+	static hdw_value hdw_closure##NAME##Left(hdw_interpreter *interpreter, hdw_closure * const restrict self) { \
+		return FN(interpreter, self->constant, self->children[0].eval(interpreter, &self->children[0])); \
+	} \
+	static hdw_value hdw_closure##NAME##Right(hdw_interpreter *interpreter, hdw_closure * const restrict self) { \
+		return FN(interpreter, self->children[0].eval(interpreter, &self->children[0]), self->constant); \
+	}
+
+// Evaluator for a subtree combined with an integer literal, which only checks
+// the type of the subtree's value and generalises if that is not an integer.
+// INTEGER(X, Y) is the operator on two integers.
+#define HDW_CLOSURE_INTEGER(NAME, FN, TYPE, INTEGER) \
+	static hdw_value hdw_closure##NAME##Integer(hdw_interpreter *interpreter, hdw_closure * const restrict self) { \
+		hdw_value left = self->children[0].eval(interpreter, &self->children[0]); \
+		if (left.type == HDW_TYPE_INTEGER) { \
+			return hdw_newValue(TYPE, INTEGER(left.as_integer, self->constant.as_integer)); \
+		} \
+		self->eval = hdw_closure##NAME##Right; \
+		interpreter->despecialisations++; \
+		return FN(interpreter, left, self->constant); \
+	}
+
+// Evaluators for a binary operator on two subtrees that specialise themselves
+// on the operand types they observe. INTEGER_OP is the operator on integers and
+// OP the one on numbers. The integer form also generalises when GUARD rejects
+// the right operand.
+#define HDW_CLOSURE_FEEDBACK(NAME, FN, INTEGER, NUMBER, INTEGER_OP, OP, GUARD) \
+	static hdw_value hdw_closure##NAME##Integers(hdw_interpreter *interpreter, hdw_closure * const restrict self) { \
+		hdw_value left = self->children[0].eval(interpreter, &self->children[0]); \
+		hdw_value right = self->children[1].eval(interpreter, &self->children[1]); \
+		if (left.type == HDW_TYPE_INTEGER && right.type == HDW_TYPE_INTEGER && GUARD(right.as_integer)) { \
+			return INTEGER(INTEGER_OP(left.as_integer, right.as_integer)); \
+		} \
+		self->eval = hdw_closure##NAME##Generic; \
+		interpreter->despecialisations++; \
+		return FN(interpreter, left, right); \
+	} \
+	static hdw_value hdw_closure##NAME##Numbers(hdw_interpreter *interpreter, hdw_closure * const restrict self) { \
+		hdw_value left = self->children[0].eval(interpreter, &self->children[0]); \
+		hdw_value right = self->children[1].eval(interpreter, &self->children[1]); \
+		if (left.type == HDW_TYPE_NUMBER && right.type == HDW_TYPE_NUMBER) { \
+			return NUMBER(left.as_number OP right.as_number); \
+		} \
+		self->eval = hdw_closure##NAME##Generic; \
+		interpreter->despecialisations++; \
+		return FN(interpreter, left, right); \
+	} \
+	static hdw_value hdw_closure##NAME(hdw_interpreter *interpreter, hdw_closure * const restrict self) { \
+		hdw_value left = self->children[0].eval(interpreter, &self->children[0]); \
+		hdw_value right = self->children[1].eval(interpreter, &self->children[1]); \
+		if (left.type == HDW_TYPE_INTEGER && right.type == HDW_TYPE_INTEGER) { \
+			self->eval = hdw_closure##NAME##Integers; \
+			interpreter->specialisations++; \
+		} \
+		else if (left.type == HDW_TYPE_NUMBER && right.type == HDW_TYPE_NUMBER) { \
+			self->eval = hdw_closure##NAME##Numbers; \
+			interpreter->specialisations++; \
+		} \
+		else { \
+			self->eval = hdw_closure##NAME##Generic; \
+		} \
+		return FN(interpreter, left, right); \
+	}
+
+#define HDW_INTEGER_RESULT(X) hdw_newValue(HDW_TYPE_INTEGER, (X))
+#define HDW_NUMBER_RESULT(X) hdw_newNumberValue((X))
+#define HDW_BOOLEAN_RESULT(X) hdw_newValue(HDW_TYPE_BOOLEAN, (X))
+#define HDW_ANY_INTEGER(X) true
+#define HDW_INTEGER_DIV(X, Y) ((X) / (Y))
+#define HDW_INTEGER_GT(X, Y) ((X) > (Y))
+#define HDW_INTEGER_GTE(X, Y) ((X) >= (Y))
+#define HDW_INTEGER_LT(X, Y) ((X) < (Y))
+#define HDW_INTEGER_LTE(X, Y) ((X) <= (Y))
+
+HDW_CLOSURE_BINARY(Add, hdw_valueAdd)
+HDW_CLOSURE_BINARY(Sub, hdw_valueSub)
+HDW_CLOSURE_BINARY(Mul, hdw_valueMul)
+HDW_CLOSURE_BINARY(Div, hdw_valueDiv)
+HDW_CLOSURE_BINARY(GT, hdw_valueGT)
+HDW_CLOSURE_BINARY(GTE, hdw_valueGTE)
+HDW_CLOSURE_BINARY(LT, hdw_valueLT)
+HDW_CLOSURE_BINARY(LTE, hdw_valueLTE)
+HDW_CLOSURE_BINARY(Equal, hdw_valueEqual)
+HDW_CLOSURE_BINARY(NotEqual, hdw_valueNotEqual)
+
+HDW_CLOSURE_INTEGER(Add, hdw_valueAdd, HDW_TYPE_INTEGER, HDW_INTEGER_ADD)
+HDW_CLOSURE_INTEGER(Sub, hdw_valueSub, HDW_TYPE_INTEGER, HDW_INTEGER_SUB)
+HDW_CLOSURE_INTEGER(Mul, hdw_valueMul, HDW_TYPE_INTEGER, HDW_INTEGER_MUL)
+HDW_CLOSURE_INTEGER(GT, hdw_valueGT, HDW_TYPE_BOOLEAN, HDW_INTEGER_GT)
+HDW_CLOSURE_INTEGER(GTE, hdw_valueGTE, HDW_TYPE_BOOLEAN, HDW_INTEGER_GTE)
+HDW_CLOSURE_INTEGER(LT, hdw_valueLT, HDW_TYPE_BOOLEAN, HDW_INTEGER_LT)
+HDW_CLOSURE_INTEGER(LTE, hdw_valueLTE, HDW_TYPE_BOOLEAN, HDW_INTEGER_LTE)
+
+HDW_CLOSURE_FEEDBACK(Add, hdw_valueAdd, HDW_INTEGER_RESULT, HDW_NUMBER_RESULT, HDW_INTEGER_ADD, +, HDW_ANY_INTEGER)
+HDW_CLOSURE_FEEDBACK(Sub, hdw_valueSub, HDW_INTEGER_RESULT, HDW_NUMBER_RESULT, HDW_INTEGER_SUB, -, HDW_ANY_INTEGER)
+HDW_CLOSURE_FEEDBACK(Mul, hdw_valueMul, HDW_INTEGER_RESULT, HDW_NUMBER_RESULT, HDW_INTEGER_MUL, *, HDW_ANY_INTEGER)
+HDW_CLOSURE_FEEDBACK(Div, hdw_valueDiv, HDW_INTEGER_RESULT, HDW_NUMBER_RESULT, HDW_INTEGER_DIV, /, HDW_CLOSURE_SAFE_DIVISOR)
+HDW_CLOSURE_FEEDBACK(GT, hdw_valueGT, HDW_BOOLEAN_RESULT, HDW_BOOLEAN_RESULT, HDW_INTEGER_GT, >, HDW_ANY_INTEGER)
+HDW_CLOSURE_FEEDBACK(GTE, hdw_valueGTE, HDW_BOOLEAN_RESULT, HDW_BOOLEAN_RESULT, HDW_INTEGER_GTE, >=, HDW_ANY_INTEGER)
+HDW_CLOSURE_FEEDBACK(LT, hdw_valueLT, HDW_BOOLEAN_RESULT, HDW_BOOLEAN_RESULT, HDW_INTEGER_LT, <, HDW_ANY_INTEGER)
+HDW_CLOSURE_FEEDBACK(LTE, hdw_valueLTE, HDW_BOOLEAN_RESULT, HDW_BOOLEAN_RESULT, HDW_INTEGER_LTE, <=, HDW_ANY_INTEGER)
+
+#undef HDW_CLOSURE_BINARY
+#undef HDW_CLOSURE_INTEGER
+#undef HDW_CLOSURE_FEEDBACK
+#undef HDW_INTEGER_RESULT
+#undef HDW_NUMBER_RESULT
+#undef HDW_BOOLEAN_RESULT
+#undef HDW_ANY_INTEGER
+#undef HDW_INTEGER_DIV
+#undef HDW_INTEGER_GT
+#undef HDW_INTEGER_GTE
+#undef HDW_INTEGER_LT
+#undef HDW_INTEGER_LTE
+
+typedef struct hdw_closurebinary {
+	uint32_t type;
+	hdw_value (*fold)(hdw_interpreter *interpreter, const hdw_value left, const hdw_value right);
+	hdw_closurefn generic;  // Uninitialised node for two subtrees
+	hdw_closurefn left;
+	hdw_closurefn right;
+	hdw_closurefn integer;  // NULL if there is no integer form
+} hdw_closurebinary;
+
+static const hdw_closurebinary hdw_closureBinaries[] = {
+	{HDW_PLUS, hdw_valueAdd, hdw_closureAdd, hdw_closureAddLeft, hdw_closureAddRight, hdw_closureAddInteger},
+	{HDW_MINUS, hdw_valueSub, hdw_closureSub, hdw_closureSubLeft, hdw_closureSubRight, hdw_closureSubInteger},
+	{HDW_ASTRESK, hdw_valueMul, hdw_closureMul, hdw_closureMulLeft, hdw_closureMulRight, hdw_closureMulInteger},
+	{HDW_BACK, hdw_valueDiv, hdw_closureDiv, hdw_closureDivLeft, hdw_closureDivRight, NULL},
+	{HDW_GT, hdw_valueGT, hdw_closureGT, hdw_closureGTLeft, hdw_closureGTRight, hdw_closureGTInteger},
+	{HDW_GTEQ, hdw_valueGTE, hdw_closureGTE, hdw_closureGTELeft, hdw_closureGTERight, hdw_closureGTEInteger},
+	{HDW_LT, hdw_valueLT, hdw_closureLT, hdw_closureLTLeft, hdw_closureLTRight, hdw_closureLTInteger},
+	{HDW_LTEQ, hdw_valueLTE, hdw_closureLTE, hdw_closureLTELeft, hdw_closureLTERight, hdw_closureLTEInteger},
+	{HDW_EQ, hdw_valueEqual, hdw_closureEqualGeneric, hdw_closureEqualLeft, hdw_closureEqualRight, NULL},
+	{HDW_NOTEQ, hdw_valueNotEqual, hdw_closureNotEqualGeneric, hdw_closureNotEqualLeft, hdw_closureNotEqualRight, NULL},
+};
+
+static bool hdw_closureNumeric(const hdw_value value) {
+	return value.type == HDW_TYPE_INTEGER || value.type == HDW_TYPE_NUMBER;
+}
+
+static void hdw_closureSetConstant(hdw_closure *closure, hdw_value value) {
+	closure->eval = hdw_closureConstant;
+	closure->children = NULL;
+	closure->children_count = 0;
+	closure->constant = value;
+}
+
+static void hdw_closureSetError(hdw_closure *closure, const char * const message) {
+	/**
+	 * Make a closure that reports an error when it is evaluated, which is
+	 * when the tree interpreter would have reported it. The message is kept as
+	 * an interned string.
+	 */
+	
+	closure->eval = hdw_closureError;
+	closure->children = NULL;
+	closure->children_count = 0;
+	closure->constant = (hdw_value) {.type = HDW_TYPE_STRING, .as_string = hdw_stringintern(message, strlen(message))};
+}
+
+static int32_t hdw_closureBuild(const hdw_treenode * const restrict tree, hdw_closure * const restrict closure, bool fold) {
+	/**
+	 * Convert a tree into closures, folding operators on two constants only
+	 * if ´fold´ is set.
+	 */
+	
+	if (!tree) {
+		hdw_closureSetConstant(closure, hdw_nullValue());
+		return 0;
+	}
+	
+	switch (tree->type) {
+		case HDW_NULL: hdw_closureSetConstant(closure, hdw_newValue(HDW_TYPE_NULL, tree->as_integer)); return 0;
+		case HDW_STRING: hdw_closureSetConstant(closure, hdw_newValue(HDW_TYPE_STRING, tree->as_integer)); return 0;
+		case HDW_NUMBER: hdw_closureSetConstant(closure, hdw_newValue(HDW_TYPE_NUMBER, tree->as_integer)); return 0;
+		case HDW_INTEGER: hdw_closureSetConstant(closure, hdw_newValue(HDW_TYPE_INTEGER, tree->as_integer)); return 0;
+		case HDW_FALSE: hdw_closureSetConstant(closure, hdw_newValue(HDW_TYPE_BOOLEAN, 0)); return 0;
+		case HDW_TRUE: hdw_closureSetConstant(closure, hdw_newValue(HDW_TYPE_BOOLEAN, -1)); return 0;
+		case HDW_EXPR: return hdw_closureBuild(&tree->children[0], closure, fold);
+	}
+	
+	// Unary operators only ever look at literals, so they are always folded
+	if (tree->type == HDW_MINUS && tree->children_count == 1) {
+		if (tree->children[0].type == HDW_INTEGER) {
+			hdw_closureSetConstant(closure, hdw_newValue(HDW_TYPE_INTEGER, -tree->children[0].as_integer));
+		}
+		else if (tree->children[0].type == HDW_NUMBER) {
+			hdw_closureSetConstant(closure, hdw_newNumberValue(-tree->children[0].as_number));
+		}
+		else {
+			hdw_closureSetError(closure, "Cannot negate something that isn't an integer or number.");
+		}
+		
+		return 0;
+	}
+	
+	if (tree->type == HDW_NOT && tree->children_count == 1) {
+		hdw_closureSetConstant(closure, hdw_not(hdw_isTrue(&tree->children[0])));
+		return 0;
+	}
+	
+	// Binary operators
+	const hdw_closurebinary *binary = NULL;
+	
+	for (size_t i = 0; i < sizeof hdw_closureBinaries / sizeof *hdw_closureBinaries; i++) {
+		if (hdw_closureBinaries[i].type == tree->type) {
+			binary = &hdw_closureBinaries[i];
+		}
+	}
+	
+	if (!binary || tree->children_count != 2) {
+		hdw_closureSetError(closure, "Unknown kind of expression.");
+		return 0;
+	}
+	
+	hdw_closure *children = hdw_malloc(sizeof *children * 2);
+	
+	if (!children) {
+		return HDW_ERR_INTERPRETER;
+	}
+	
+	int32_t status = hdw_closureBuild(&tree->children[0], &children[0], fold);
+	
+	if (!status) {
+		status = hdw_closureBuild(&tree->children[1], &children[1], fold);
+		
+		if (status) {
+			hdw_closurefree(&children[0]);
+		}
+	}
+	
+	if (status) {
+		free(children);
+		return status;
+	}
+	
+	bool left = (children[0].eval == hdw_closureConstant);
+	bool right = (children[1].eval == hdw_closureConstant);
+	
+	// Fold constant operands, unless the operator would report an error.
+	// Integer division by zero or -1 is left to run, like in the IR.
+	bool traps = binary->type == HDW_BACK && children[0].constant.type == HDW_TYPE_INTEGER && children[1].constant.type == HDW_TYPE_INTEGER && !HDW_CLOSURE_SAFE_DIVISOR(children[1].constant.as_integer);
+	
+	if (fold && left && right && !traps && (binary->type == HDW_EQ || binary->type == HDW_NOTEQ || (hdw_closureNumeric(children[0].constant) && hdw_closureNumeric(children[1].constant)))) {
+		hdw_interpreter scratch = {0};
+		hdw_value value = binary->fold(&scratch, children[0].constant, children[1].constant);
+		
+		free(children);
+		hdw_closureSetConstant(closure, value);
+		return 0;
+	}
+	
+	closure->children = children;
+	
+	if (right) {
+		closure->constant = children[1].constant;
+		closure->children_count = 1;
+		closure->eval = (binary->integer && closure->constant.type == HDW_TYPE_INTEGER) ? binary->integer : binary->right;
+	}
+	else if (left) {
+		closure->constant = children[0].constant;
+		closure->children[0] = children[1];
+		closure->children_count = 1;
+		closure->eval = binary->left;
+	}
+	else {
+		closure->children_count = 2;
+		closure->eval = binary->generic;
+	}
+	
+	return 0;
+}
+
+int32_t hdw_closurecompile(const hdw_treenode * const restrict tree, hdw_closure * const restrict closure) {
+	/**
+	 * Convert a tree into a closure tree that can be run with
+	 * hdw_closureinterpret. The result must be freed with hdw_closurefree.
+	 */
+	
+	return hdw_closureBuild(tree, closure, true);
+}
+
+int32_t hdw_closurerun(hdw_interpreter * const restrict interpreter, hdw_closure * const restrict closure, hdw_value * const restrict result) {
+	/**
+	 * Evaluate a compiled closure tree with the given interpreter, which keeps
+	 * count of errors and of how the nodes rewrote themselves.
+	 */
+	
+	uint32_t errors = interpreter->errors;
+	
+	*result = closure->eval(interpreter, closure);
+	
+	if (interpreter->errors != errors) {
+		return HDW_ERR_INTERPRETER;
+	}
+	
+	return 0;
+}
+
+int32_t hdw_closureinterpret(hdw_closure * const restrict closure, hdw_value * const restrict result) {
+	/**
+	 * Evaluate a compiled closure tree, writing its value into the caller's
+	 * result slot.
+	 */
+	
+	hdw_interpreter interpreter = {0};
+	
+	return hdw_closurerun(&interpreter, closure, result);
+}
+
+void hdw_closurefree(hdw_closure * const restrict closure) {
+	/**
+	 * Free the children of a closure tree. The root itself belongs to the
+	 * caller.
+	 */
+	
+	for (uint32_t i = 0; i < closure->children_count; i++) {
+		hdw_closurefree(&closure->children[i]);
+	}
+	
+	if (closure->children) {
+		free(closure->children);
+	}
+	
+	closure->children = NULL;
+	closure->children_count = 0;
+}
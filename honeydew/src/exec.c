@@ -58,9 +58,15 @@ int32_t hdw_exec(hdw_script * restrict script, const char * const code) {
 	
 	hdw_treenodeprint(tree, 0);
 	
-	hdw_value *result;
+	hdw_value result;
+	hdw_closure closure;
 	
-	status = hdw_interpret(tree, &result);
+	status = hdw_closurecompile(tree, &closure);
+	
+	if (!status) {
+		status = hdw_closureinterpret(&closure, &result);
+		hdw_closurefree(&closure);
+	}
 	
 	if (status) {
 		if (script_temp) {
@@ -70,7 +76,7 @@ int32_t hdw_exec(hdw_script * restrict script, const char * const code) {
 		return status;
 	}
 	
-	hdw_printValue(result);
+	hdw_printValue(&result);
 	
 	hdw_treefree(tree);
 	
@@ -13,10 +13,22 @@
  * 
  *   - Utilities: various tools that help with tasks needed throughout the \
  *     language implementation.
+ *   - Strings: string objects and the table of interned literals.
  *   - Instance Management: mangement of scripts
  *   - Tokeniser: The lexical analysis part of the interpreter
  *   - Parser: The part of the interpreter that creates the tree structures
  *     (the IR).
+ *   - Interpreter: Walks the tree to evaluate it.
+ *   - Lists: Lists packed by element type, and the builtins that search and
+ *     reduce them.
+ *   - Typed Arrays: Arrays of sized numeric types and element-wise arithmetic
+ *     on them.
+ *   - Closure Compiler: Turns trees into closures that evaluate without
+ *     dispatching on the node type.
+ *   - Intermediate Representation: SSA form the compiler lowers trees to, and
+ *     the optimisation passes that run on it.
+ *   - Bytecode Compiler: Drives the passes and emits bytecode from the SSA.
+ *   - Benchmarks: timing of the interpreter on generated trees.
  *   - External Functions: functions that take care of running code strings and
  *     files.
  */
@@ -27,17 +39,24 @@
 #include <string.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <time.h>
 
 #include "hdw.h"
 
 //$combine-exclude
 
 #include "util.c"
+#include "strings.c"
 #include "instance.c"
 #include "tokeniser.c"
 #include "parser.c"
 #include "interpreter.c"
+#include "lists.c"
+#include "arrays.c"
+#include "closure.c"
+#include "ir.c"
 #include "bytecode.c"
+#include "bench.c"
 #include "error.c"
 #include "exec.c"
 #include "api.c"
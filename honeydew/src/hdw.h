@@ -14,6 +14,20 @@
 typedef size_t hdw_size_t; // Unused for now
 typedef int32_t hdw_int_t; // Unused for now
 
+// =============================================================================
+// Strings
+// =============================================================================
+
+#define HDW_STRING_SMALL 22  // Longest string stored inside the object
+
+typedef struct hdw_string {
+	char *data;                // The text, pointing at small if it fits
+	uint32_t length;
+	uint32_t hash;
+	struct hdw_string *next;   // Next string in the same intern table bucket
+	char small[HDW_STRING_SMALL + 1];
+} hdw_string;
+
 // =============================================================================
 // Tokeniser
 // =============================================================================
@@ -100,6 +114,7 @@ typedef uint32_t hdw_linecount;
 typedef struct hdw_token {
 	union {
 		const char *name;   // Text of the token
+		hdw_string *string; // Interned text of a string literal
 		double dec_value;
 		int64_t int_value;
 	};
@@ -144,6 +159,7 @@ typedef struct hdw_treenode {
 		double as_number;
 		int64_t as_integer;
 		char *as_string;
+		hdw_string *as_literal;  // Interned text of a string literal
 	};
 	uint32_t children_count;
 	uint32_t type;
@@ -160,7 +176,9 @@ typedef struct hdw_parser {
 // =============================================================================
 
 typedef struct hdw_interpreter {
-	
+	uint32_t errors;              // Number of errors while evaluating
+	uint32_t specialisations;     // Closures that specialised on operand types
+	uint32_t despecialisations;   // Closures whose type guard failed
 } hdw_interpreter;
 
 typedef struct hdw_value {
@@ -175,10 +193,204 @@ typedef struct hdw_value {
 		bool as_boolean;
 		double as_number;
 		int64_t as_integer;
-		char *as_string;
+		hdw_string *as_string;
 	};
 } hdw_value;
 
+// =============================================================================
+// Lists
+// =============================================================================
+
+#define HDW_LIST_BOXED 0xff  // Type of a list that holds hdw_values
+
+typedef struct hdw_list {
+	union {
+		int64_t *as_integers;
+		double *as_numbers;
+		hdw_value *as_values;
+	};
+	size_t count;
+	size_t alloc;
+	uint8_t type;            // HDW_TYPE_INTEGER or HDW_TYPE_NUMBER when packed
+} hdw_list;
+
+// =============================================================================
+// Typed Arrays
+// =============================================================================
+
+enum {
+	HDW_ARRAY_BYTE,
+	HDW_ARRAY_INT16,
+	HDW_ARRAY_INT32,
+	HDW_ARRAY_INT64,
+	HDW_ARRAY_INDEX,
+	HDW_ARRAY_FLOAT32,
+	HDW_ARRAY_NUMBER,
+	HDW_ARRAY_TYPE_COUNT,
+};
+
+typedef struct hdw_array {
+	union {
+		void *data;
+		uint8_t *as_bytes;
+		int16_t *as_int16;
+		int32_t *as_int32;
+		int64_t *as_int64;
+		size_t *as_index;
+		float *as_float32;
+		double *as_number;
+	};
+	size_t count;
+	uint8_t type;            // HDW_ARRAY_*
+} hdw_array;
+
+// =============================================================================
+// Closure Compiler
+// =============================================================================
+
+// A tree converted ahead of evaluation into nodes that each hold a pointer to
+// a function specialised for evaluating them. Nodes may swap that function
+// while running, based on the types they see.
+
+typedef struct hdw_closure hdw_closure;
+
+typedef hdw_value (*hdw_closurefn)(hdw_interpreter *interpreter, hdw_closure * const restrict self);
+
+struct hdw_closure {
+	hdw_closurefn eval;       // Evaluates this node
+	hdw_closure *children;    // The subtrees that are not constant
+	hdw_value constant;       // Folded value, or the constant operand
+	uint32_t children_count;
+};
+
+// =============================================================================
+// Bytecode Compiler
+// =============================================================================
+
+// Trees are lowered to an SSA form intermediate representation made of basic
+// blocks, which is optimised and then turned into register bytecode.
+
+enum {
+	HDW_IR_CONST,   // The constant
+	HDW_IR_COPY,    // args[0]
+	HDW_IR_PHI,     // One argument for each predecessor of the block, in order
+	HDW_IR_NEG,
+	HDW_IR_NOT,
+	HDW_IR_ADD,
+	HDW_IR_SUB,
+	HDW_IR_MUL,
+	HDW_IR_DIV,
+	HDW_IR_EQ,
+	HDW_IR_NOTEQ,
+	HDW_IR_LT,
+	HDW_IR_GT,
+	HDW_IR_LTEQ,
+	HDW_IR_GTEQ,
+	HDW_IR_JUMP,    // To succs[0]
+	HDW_IR_BRANCH,  // To succs[0] if args[0] is true, otherwise succs[1]
+	HDW_IR_RETURN,  // args[0]
+};
+
+#define HDW_IR_NONE UINT32_MAX  // No value or block
+#define HDW_IR_UNSET 0xfe       // Type not worked out yet
+#define HDW_IR_ANY 0xff         // Type could be anything
+
+typedef struct hdw_irinstr {
+	hdw_value constant;   // Value of a constant
+	uint32_t args[2];     // Values used, as indexes of the instructions
+	uint32_t *phi_args;   // Used instead of args by phis
+	uint32_t args_count;
+	uint32_t block;       // Block the instruction is in
+	uint16_t op;
+	uint8_t type;         // HDW_TYPE_* of the result, or HDW_IR_ANY
+	bool dead;            // Removed by an optimisation pass
+} hdw_irinstr;
+
+typedef struct hdw_irblock {
+	uint32_t *code;       // Instructions in order, the terminator last
+	uint32_t count;
+	uint32_t alloc;
+	uint32_t *preds;
+	uint32_t preds_count;
+	uint32_t succs[2];
+	uint32_t succs_count;
+	uint32_t idom;        // Immediate dominator, HDW_IR_NONE if unreachable
+	uint32_t order;       // Position in reverse postorder
+	
+	// Only used while building SSA form
+	uint32_t *defs;       // Value each variable has at the end of the block
+	uint32_t defs_count;
+	uint32_t *incomplete; // Variable and phi pairs to finish when sealed
+	uint32_t incomplete_count;
+	bool sealed;          // All predecessors are known
+} hdw_irblock;
+
+typedef struct hdw_irfunction {
+	hdw_irinstr *instrs;
+	uint32_t count;
+	uint32_t alloc;
+	hdw_irblock *blocks;
+	uint32_t block_count;
+	uint32_t block_alloc;
+	const char **variables;  // Variable names, indexed by variable number
+	uint32_t variable_count;
+	uint32_t *order;         // Reachable blocks in reverse postorder
+	uint32_t order_count;
+	const char *error;       // Why lowering or a pass failed
+} hdw_irfunction;
+
+enum {
+	HDW_OP_CONST,      // dst = constants[a]
+	HDW_OP_MOVE,       // dst = a
+	HDW_OP_NEG,        // dst = -a
+	HDW_OP_NOT,        // dst = !a
+	HDW_OP_ADD,        // dst = a + b, and so on
+	HDW_OP_SUB,
+	HDW_OP_MUL,
+	HDW_OP_DIV,
+	HDW_OP_EQ,
+	HDW_OP_NOTEQ,
+	HDW_OP_LT,
+	HDW_OP_GT,
+	HDW_OP_LTEQ,
+	HDW_OP_GTEQ,
+	HDW_OP_JUMP,       // Go to instruction a
+	HDW_OP_JUMPIFNOT,  // Go to instruction b if a is false
+	HDW_OP_RETURN,     // Return a
+};
+
+typedef struct hdw_instruction {
+	uint32_t dst;
+	uint32_t a;
+	uint32_t b;
+	uint16_t op;
+} hdw_instruction;
+
+typedef struct hdw_bytecode {
+	hdw_instruction *code;
+	size_t count;
+	hdw_value *constants;     // Strings are interned
+	size_t constant_count;
+	uint32_t registers;       // Registers needed to run the code
+} hdw_bytecode;
+
+typedef struct hdw_passtime {
+	const char *name;
+	double seconds;
+	size_t before;            // Instructions before the pass
+	size_t after;             // Instructions after the pass
+} hdw_passtime;
+
+#define HDW_PASS_MAX 16
+
+typedef struct hdw_compiler {
+	hdw_bytecode output;
+	bool optimise;            // Run the optimisation passes
+	bool dump;                // Print the IR after lowering and every pass
+	hdw_passtime passes[HDW_PASS_MAX];
+	size_t pass_count;
+} hdw_compiler;
+
 // =============================================================================
 // Errors
 // =============================================================================
@@ -190,7 +402,8 @@ enum hdw_retcode {
 	HDW_ERR_TOKENISER = -3,
 	HDW_ERR_PARSER = -4,
 	HDW_ERR_INTERPRETER = -5,
-	
+	HDW_ERR_COMPILER = -6,
+
 };
 
 typedef struct hdw_error {
@@ -216,11 +429,49 @@ typedef struct hdw_script {
 hdw_script *hdw_create(void);
 void hdw_destroy(hdw_script *c);
 
+// Strings
+// =============================================================================
+hdw_string *hdw_stringintern(const char * const src, size_t length);
+bool hdw_stringequal(const hdw_string * const a, const hdw_string * const b);
+void hdw_stringreset(void);
+
+// Lists
+// =============================================================================
+bool hdw_listpush(hdw_list * const restrict list, hdw_value value);
+hdw_value hdw_listget(const hdw_list * const restrict list, size_t index);
+void hdw_listfree(hdw_list * const restrict list);
+int64_t hdw_listindexof(const hdw_list * const restrict list, hdw_value what);
+bool hdw_listcontains(const hdw_list * const restrict list, hdw_value what);
+hdw_value hdw_listfind(const hdw_list * const restrict list, hdw_value what);
+size_t hdw_listcount(const hdw_list * const restrict list, hdw_value what);
+int32_t hdw_listsum(const hdw_list * const restrict list, hdw_value * const restrict result);
+int32_t hdw_listmin(const hdw_list * const restrict list, hdw_value * const restrict result);
+int32_t hdw_listmax(const hdw_list * const restrict list, hdw_value * const restrict result);
+
+// Typed Arrays
+// =============================================================================
+bool hdw_arraynew(hdw_array * const restrict array, uint8_t type, size_t count);
+void hdw_arrayfree(hdw_array * const restrict array);
+hdw_value hdw_arrayget(const hdw_array * const restrict array, size_t index);
+bool hdw_arrayset(hdw_array * const restrict array, size_t index, hdw_value value);
+int32_t hdw_arrayadd(hdw_array * const dst, const hdw_array * const a, const hdw_array * const b);
+int32_t hdw_arraysub(hdw_array * const dst, const hdw_array * const a, const hdw_array * const b);
+int32_t hdw_arraymul(hdw_array * const dst, const hdw_array * const a, const hdw_array * const b);
+int32_t hdw_arraydiv(hdw_array * const dst, const hdw_array * const a, const hdw_array * const b);
+
 // Low level
 // =============================================================================
 int32_t hdw_tokenise(hdw_script * const restrict script, hdw_tokenarray *tokens, const char * const code);
 int32_t hdw_parse(hdw_script * const restrict script, hdw_treenode ** const restrict tree, const hdw_tokenarray * const restrict tokens);
-int32_t hdw_interpret(const hdw_treenode * const restrict tree, hdw_value ** const restrict result);
+int32_t hdw_interpret(const hdw_treenode * const restrict tree, hdw_value * const restrict result);
+int32_t hdw_closurecompile(const hdw_treenode * const restrict tree, hdw_closure * const restrict closure);
+int32_t hdw_closureinterpret(hdw_closure * const restrict closure, hdw_value * const restrict result);
+int32_t hdw_closurerun(hdw_interpreter * const restrict interpreter, hdw_closure * const restrict closure, hdw_value * const restrict result);
+void hdw_closurefree(hdw_closure * const restrict closure);
+int32_t hdw_compile(hdw_compiler * const restrict compiler, hdw_treenode * const restrict tree);
+void hdw_printpasses(const hdw_compiler * const restrict compiler);
+void hdw_printbytecode(const hdw_bytecode * const restrict code);
+void hdw_freebytecode(hdw_bytecode * const restrict code);
 int32_t hdw_exec(hdw_script * restrict script, const char * const code);
 int32_t hdw_crexec(hdw_script ** restrict script, const char * const code);
 
@@ -235,3 +486,4 @@ int32_t hdw_haserror(hdw_script * const restrict script);
 // =============================================================================
 int hdw_dofile(const char * const path);
 void hdw_bulitin_prompt(void);
+void hdw_benchmark(void);
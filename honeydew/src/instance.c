@@ -1,6 +1,10 @@
 // =============================================================================
 // Script Instance Management
 // =============================================================================
+
+// Scripts share the table of interned strings, which is emptied when the last
+// of them is destroyed.
+static uint32_t hdw_scripts;
  
 hdw_script *hdw_create(void) {
 	/**
@@ -15,6 +19,8 @@ hdw_script *hdw_create(void) {
 	
 	memset(c, 0, sizeof(hdw_script));
 	
+	hdw_scripts++;
+	
 	return c;
 }
 
@@ -23,5 +29,9 @@ void hdw_destroy(hdw_script *c) {
 	 * Destroys a script state.
 	 */
 	
+	if (c && --hdw_scripts == 0) {
+		hdw_stringreset();
+	}
+	
 	free(c);
 } 
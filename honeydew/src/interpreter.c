@@ -2,311 +2,336 @@
 // Interpreter
 // =============================================================================
 
-static hdw_value *hdw_interpreterEvaluate(hdw_interpreter *interpreter, const hdw_treenode * const restrict tree);
+// Values are returned by value, so evaluating an expression does not touch the
+// heap. Strings are interned literals, owned by the intern table.
 
-static void hdw_interpreterError(const char * const message) {
+// Integer arithmetic is done on unsigned integers so that it wraps instead of
+// overflowing.
+#define HDW_INTEGER_ADD(X, Y) ((int64_t) ((uint64_t) (X) + (uint64_t) (Y)))
+#define HDW_INTEGER_SUB(X, Y) ((int64_t) ((uint64_t) (X) - (uint64_t) (Y)))
+#define HDW_INTEGER_MUL(X, Y) ((int64_t) ((uint64_t) (X) * (uint64_t) (Y)))
+
+static hdw_value hdw_interpreterEvaluate(hdw_interpreter *interpreter, const hdw_treenode * const restrict tree);
+
+static void hdw_interpreterError(hdw_interpreter *interpreter, const char * const message) {
 	printf("Interpreter error: %s.\n", message);
+	interpreter->errors++;
 }
 
-static hdw_value *hdw_nullValue(void) {
-	hdw_value *value = (hdw_value *) malloc(sizeof *value);
-	
-	if (!value) {
-		return NULL;
-	}
-	
-	value->type = HDW_TYPE_NULL;
-	
-	return value;
+static hdw_value hdw_nullValue(void) {
+	return (hdw_value) {.type = HDW_TYPE_NULL};
 }
 
-static hdw_value *hdw_newValue(uint32_t type, int64_t value) {
-	hdw_value *obj = (hdw_value *) malloc(sizeof *obj);
-	
-	if (!obj) {
-		return NULL;
-	}
-	
-	obj->type = type;
-	obj->as_integer = value;
-	
-	return obj;
+static hdw_value hdw_newValue(uint32_t type, int64_t value) {
+	return (hdw_value) {.type = type, .as_integer = value};
 }
 
-static hdw_value *hdw_newNumberValue(double value) {
-	hdw_value *obj = (hdw_value *) malloc(sizeof *obj);
-	
-	if (!obj) {
-		return NULL;
-	}
-	
-	obj->type = HDW_TYPE_NUMBER;
-	obj->as_number = value;
-	
-	return obj;
+static hdw_value hdw_newNumberValue(double value) {
+	return (hdw_value) {.type = HDW_TYPE_NUMBER, .as_number = value};
 }
 
-static hdw_value *hdw_isTrue(hdw_treenode *input) {
+static hdw_value hdw_isTrue(hdw_treenode *input) {
 	if (input->type == HDW_FALSE) return hdw_newValue(HDW_TYPE_BOOLEAN, 0);
 	if (input->type == HDW_NULL) return hdw_newValue(HDW_TYPE_BOOLEAN, 0);
-	if (input->type == HDW_STRING && input->as_string[0] == '\0') return hdw_newValue(HDW_TYPE_BOOLEAN, 0);
+	if (input->type == HDW_STRING && input->as_literal->length == 0) return hdw_newValue(HDW_TYPE_BOOLEAN, 0);
 	if (input->type == HDW_INTEGER && input->as_integer == 0) return hdw_newValue(HDW_TYPE_BOOLEAN, 0);
 	if (input->type == HDW_NUMBER && input->as_number == 0.0f) return hdw_newValue(HDW_TYPE_BOOLEAN, 0);
 	return hdw_newValue(HDW_TYPE_BOOLEAN, 1);
 }
 
-static hdw_value *hdw_isEqual(hdw_interpreter *interpreter, const hdw_treenode * const restrict tree) {
-	hdw_value *left = hdw_interpreterEvaluate(interpreter, &tree->children[0]);
-	hdw_value *right = hdw_interpreterEvaluate(interpreter, &tree->children[1]);
-	hdw_value *res;
+static hdw_value hdw_valueEqual(hdw_interpreter *interpreter, const hdw_value left, const hdw_value right) {
+	// Takes the interpreter like the other value operators, but can't fail
+	(void) interpreter;
 	
-	if (left->as_integer == right->as_integer) {
-		res = hdw_newValue(HDW_TYPE_BOOLEAN, 1);
+	bool equal;
+	
+	if (left.type == HDW_TYPE_INTEGER && right.type == HDW_TYPE_NUMBER) {
+		equal = (double) left.as_integer == right.as_number;
+	}
+	else if (left.type == HDW_TYPE_NUMBER && right.type == HDW_TYPE_INTEGER) {
+		equal = left.as_number == (double) right.as_integer;
 	}
-	else if (left->type == HDW_TYPE_STRING && left->type == HDW_TYPE_STRING && !strcmp(left->as_string, right->as_string)) {
-		res = hdw_newValue(HDW_TYPE_BOOLEAN, 1);
+	else if (left.type != right.type) {
+		equal = false;
 	}
 	else {
-		res = hdw_newValue(HDW_TYPE_BOOLEAN, 0);
+		switch (left.type) {
+			case HDW_TYPE_NULL: equal = true; break;
+			case HDW_TYPE_BOOLEAN: equal = !left.as_boolean == !right.as_boolean; break;
+			case HDW_TYPE_NUMBER: equal = left.as_number == right.as_number; break;
+			case HDW_TYPE_INTEGER: equal = left.as_integer == right.as_integer; break;
+			case HDW_TYPE_STRING: equal = hdw_stringequal(left.as_string, right.as_string); break;
+			default: equal = false; break;
+		}
 	}
 	
-	free(left);
-	free(right);
+	return hdw_newValue(HDW_TYPE_BOOLEAN, equal);
+}
+
+static hdw_value hdw_isEqual(hdw_interpreter *interpreter, const hdw_treenode * const restrict tree) {
+	hdw_value left = hdw_interpreterEvaluate(interpreter, &tree->children[0]);
+	hdw_value right = hdw_interpreterEvaluate(interpreter, &tree->children[1]);
 	
-	return res;
+	return hdw_valueEqual(interpreter, left, right);
 }
 
-static hdw_value *hdw_not(hdw_value *val) {
-	val->as_boolean = !val->as_boolean;
+static hdw_value hdw_not(hdw_value val) {
+	val.as_boolean = !val.as_boolean;
 	return val;
 }
 
-static hdw_value *hdw_opAdd(hdw_interpreter *interpreter, const hdw_treenode * const restrict tree) {
-	hdw_value *left = hdw_interpreterEvaluate(interpreter, &tree->children[0]);
-	hdw_value *right = hdw_interpreterEvaluate(interpreter, &tree->children[1]);
-	hdw_value *res;
+static hdw_value hdw_valueAdd(hdw_interpreter *interpreter, const hdw_value left, const hdw_value right) {
+	hdw_value res;
 	
-	if (left->type == HDW_TYPE_INTEGER && right->type == HDW_TYPE_INTEGER) {
-		res = hdw_newValue(HDW_TYPE_INTEGER, left->as_integer + right->as_integer);
+	if (left.type == HDW_TYPE_INTEGER && right.type == HDW_TYPE_INTEGER) {
+		res = hdw_newValue(HDW_TYPE_INTEGER, HDW_INTEGER_ADD(left.as_integer, right.as_integer));
 	}
-	else if (left->type == HDW_TYPE_INTEGER && right->type == HDW_TYPE_NUMBER) {
-		res = hdw_newNumberValue((double) left->as_integer + right->as_number);
+	else if (left.type == HDW_TYPE_INTEGER && right.type == HDW_TYPE_NUMBER) {
+		res = hdw_newNumberValue((double) left.as_integer + right.as_number);
 	}
-	else if (left->type == HDW_TYPE_NUMBER && right->type == HDW_TYPE_INTEGER) {
-		res = hdw_newNumberValue(left->as_number + (double) right->as_integer);
+	else if (left.type == HDW_TYPE_NUMBER && right.type == HDW_TYPE_INTEGER) {
+		res = hdw_newNumberValue(left.as_number + (double) right.as_integer);
 	}
-	else if (left->type == HDW_TYPE_NUMBER && right->type == HDW_TYPE_NUMBER) {
-		res = hdw_newNumberValue(left->as_number + right->as_number);
+	else if (left.type == HDW_TYPE_NUMBER && right.type == HDW_TYPE_NUMBER) {
+		res = hdw_newNumberValue(left.as_number + right.as_number);
 	}
 	else {
-		hdw_interpreterError("Failed to add values of types that cannot be added.");
+		hdw_interpreterError(interpreter, "Failed to add values of types that cannot be added.");
 		res = hdw_nullValue();
 	}
 	
-	free(left);
-	free(right);
-	
 	return res;
 }
 
-static hdw_value *hdw_opSub(hdw_interpreter *interpreter, const hdw_treenode * const restrict tree) {
-	hdw_value *left = hdw_interpreterEvaluate(interpreter, &tree->children[0]);
-	hdw_value *right = hdw_interpreterEvaluate(interpreter, &tree->children[1]);
-	hdw_value *res;
+static hdw_value hdw_opAdd(hdw_interpreter *interpreter, const hdw_treenode * const restrict tree) {
+	hdw_value left = hdw_interpreterEvaluate(interpreter, &tree->children[0]);
+	hdw_value right = hdw_interpreterEvaluate(interpreter, &tree->children[1]);
 	
-	if (left->type == HDW_TYPE_INTEGER && right->type == HDW_TYPE_INTEGER) {
-		res = hdw_newValue(HDW_TYPE_INTEGER, left->as_integer - right->as_integer);
+	return hdw_valueAdd(interpreter, left, right);
+}
+
+static hdw_value hdw_valueSub(hdw_interpreter *interpreter, const hdw_value left, const hdw_value right) {
+	hdw_value res;
+	
+	if (left.type == HDW_TYPE_INTEGER && right.type == HDW_TYPE_INTEGER) {
+		res = hdw_newValue(HDW_TYPE_INTEGER, HDW_INTEGER_SUB(left.as_integer, right.as_integer));
 	}
-	else if (left->type == HDW_TYPE_INTEGER && right->type == HDW_TYPE_NUMBER) {
-		res = hdw_newNumberValue((double) left->as_integer - right->as_number);
+	else if (left.type == HDW_TYPE_INTEGER && right.type == HDW_TYPE_NUMBER) {
+		res = hdw_newNumberValue((double) left.as_integer - right.as_number);
 	}
-	else if (left->type == HDW_TYPE_NUMBER && right->type == HDW_TYPE_INTEGER) {
-		res = hdw_newNumberValue(left->as_number - (double) right->as_integer);
+	else if (left.type == HDW_TYPE_NUMBER && right.type == HDW_TYPE_INTEGER) {
+		res = hdw_newNumberValue(left.as_number - (double) right.as_integer);
 	}
-	else if (left->type == HDW_TYPE_NUMBER && right->type == HDW_TYPE_NUMBER) {
-		res = hdw_newNumberValue(left->as_number - right->as_number);
+	else if (left.type == HDW_TYPE_NUMBER && right.type == HDW_TYPE_NUMBER) {
+		res = hdw_newNumberValue(left.as_number - right.as_number);
 	}
 	else {
-		hdw_interpreterError("Failed to subtract values of types that cannot be subtract.");
+		hdw_interpreterError(interpreter, "Failed to subtract values of types that cannot be subtract.");
 		res = hdw_nullValue();
 	}
 	
-	free(left);
-	free(right);
-	
 	return res;
 }
 
-static hdw_value *hdw_opMul(hdw_interpreter *interpreter, const hdw_treenode * const restrict tree) {
-	hdw_value *left = hdw_interpreterEvaluate(interpreter, &tree->children[0]);
-	hdw_value *right = hdw_interpreterEvaluate(interpreter, &tree->children[1]);
-	hdw_value *res;
+static hdw_value hdw_opSub(hdw_interpreter *interpreter, const hdw_treenode * const restrict tree) {
+	hdw_value left = hdw_interpreterEvaluate(interpreter, &tree->children[0]);
+	hdw_value right = hdw_interpreterEvaluate(interpreter, &tree->children[1]);
+	
+	return hdw_valueSub(interpreter, left, right);
+}
+
+static hdw_value hdw_valueMul(hdw_interpreter *interpreter, const hdw_value left, const hdw_value right) {
+	hdw_value res;
 	
-	if (left->type == HDW_TYPE_INTEGER && right->type == HDW_TYPE_INTEGER) {
-		res = hdw_newValue(HDW_TYPE_INTEGER, left->as_integer * right->as_integer);
+	if (left.type == HDW_TYPE_INTEGER && right.type == HDW_TYPE_INTEGER) {
+		res = hdw_newValue(HDW_TYPE_INTEGER, HDW_INTEGER_MUL(left.as_integer, right.as_integer));
 	}
-	else if (left->type == HDW_TYPE_INTEGER && right->type == HDW_TYPE_NUMBER) {
-		res = hdw_newNumberValue((double) left->as_integer * right->as_number);
+	else if (left.type == HDW_TYPE_INTEGER && right.type == HDW_TYPE_NUMBER) {
+		res = hdw_newNumberValue((double) left.as_integer * right.as_number);
 	}
-	else if (left->type == HDW_TYPE_NUMBER && right->type == HDW_TYPE_INTEGER) {
-		res = hdw_newNumberValue(left->as_number * (double) right->as_integer);
+	else if (left.type == HDW_TYPE_NUMBER && right.type == HDW_TYPE_INTEGER) {
+		res = hdw_newNumberValue(left.as_number * (double) right.as_integer);
 	}
-	else if (left->type == HDW_TYPE_NUMBER && right->type == HDW_TYPE_NUMBER) {
-		res = hdw_newNumberValue(left->as_number * right->as_number);
+	else if (left.type == HDW_TYPE_NUMBER && right.type == HDW_TYPE_NUMBER) {
+		res = hdw_newNumberValue(left.as_number * right.as_number);
 	}
 	else {
-		hdw_interpreterError("Failed to multiply values of types that cannot be multiply.");
+		hdw_interpreterError(interpreter, "Failed to multiply values of types that cannot be multiply.");
 		res = hdw_nullValue();
 	}
 	
-	free(left);
-	free(right);
-	
 	return res;
 }
 
-static hdw_value *hdw_opDiv(hdw_interpreter *interpreter, const hdw_treenode * const restrict tree) {
-	hdw_value *left = hdw_interpreterEvaluate(interpreter, &tree->children[0]);
-	hdw_value *right = hdw_interpreterEvaluate(interpreter, &tree->children[1]);
-	hdw_value *res;
+static hdw_value hdw_opMul(hdw_interpreter *interpreter, const hdw_treenode * const restrict tree) {
+	hdw_value left = hdw_interpreterEvaluate(interpreter, &tree->children[0]);
+	hdw_value right = hdw_interpreterEvaluate(interpreter, &tree->children[1]);
 	
-	if (left->type == HDW_TYPE_INTEGER && right->type == HDW_TYPE_INTEGER) {
-		res = hdw_newValue(HDW_TYPE_INTEGER, left->as_integer / right->as_integer);
+	return hdw_valueMul(interpreter, left, right);
+}
+
+static hdw_value hdw_valueDiv(hdw_interpreter *interpreter, const hdw_value left, const hdw_value right) {
+	hdw_value res;
+	
+	if (left.type == HDW_TYPE_INTEGER && right.type == HDW_TYPE_INTEGER) {
+		// Both of these would trap, and the smallest integer over -1 wraps
+		if (right.as_integer == 0) {
+			hdw_interpreterError(interpreter, "Failed to divide an integer by zero.");
+			res = hdw_nullValue();
+		}
+		else if (right.as_integer == -1) {
+			res = hdw_newValue(HDW_TYPE_INTEGER, (int64_t) -(uint64_t) left.as_integer);
+		}
+		else {
+			res = hdw_newValue(HDW_TYPE_INTEGER, left.as_integer / right.as_integer);
+		}
 	}
-	else if (left->type == HDW_TYPE_INTEGER && right->type == HDW_TYPE_NUMBER) {
-		res = hdw_newNumberValue((double) left->as_integer / right->as_number);
+	else if (left.type == HDW_TYPE_INTEGER && right.type == HDW_TYPE_NUMBER) {
+		res = hdw_newNumberValue((double) left.as_integer / right.as_number);
 	}
-	else if (left->type == HDW_TYPE_NUMBER && right->type == HDW_TYPE_INTEGER) {
-		res = hdw_newNumberValue(left->as_number / (double) right->as_integer);
+	else if (left.type == HDW_TYPE_NUMBER && right.type == HDW_TYPE_INTEGER) {
+		res = hdw_newNumberValue(left.as_number / (double) right.as_integer);
 	}
-	else if (left->type == HDW_TYPE_NUMBER && right->type == HDW_TYPE_NUMBER) {
-		res = hdw_newNumberValue(left->as_number / right->as_number);
+	else if (left.type == HDW_TYPE_NUMBER && right.type == HDW_TYPE_NUMBER) {
+		res = hdw_newNumberValue(left.as_number / right.as_number);
 	}
 	else {
-		hdw_interpreterError("Failed to divide values of types that cannot be divide.");
+		hdw_interpreterError(interpreter, "Failed to divide values of types that cannot be divide.");
 		res = hdw_nullValue();
 	}
 	
-	free(left);
-	free(right);
-	
 	return res;
 }
 
-static hdw_value *hdw_opGT(hdw_interpreter *interpreter, const hdw_treenode * const restrict tree) {
-	hdw_value *left = hdw_interpreterEvaluate(interpreter, &tree->children[0]);
-	hdw_value *right = hdw_interpreterEvaluate(interpreter, &tree->children[1]);
-	hdw_value *res;
+static hdw_value hdw_opDiv(hdw_interpreter *interpreter, const hdw_treenode * const restrict tree) {
+	hdw_value left = hdw_interpreterEvaluate(interpreter, &tree->children[0]);
+	hdw_value right = hdw_interpreterEvaluate(interpreter, &tree->children[1]);
+	
+	return hdw_valueDiv(interpreter, left, right);
+}
+
+static hdw_value hdw_valueGT(hdw_interpreter *interpreter, const hdw_value left, const hdw_value right) {
+	hdw_value res;
 	
-	if (left->type == HDW_TYPE_INTEGER && right->type == HDW_TYPE_INTEGER) {
-		res = hdw_newValue(HDW_TYPE_BOOLEAN, left->as_integer > right->as_integer);
+	if (left.type == HDW_TYPE_INTEGER && right.type == HDW_TYPE_INTEGER) {
+		res = hdw_newValue(HDW_TYPE_BOOLEAN, left.as_integer > right.as_integer);
 	}
-	else if (left->type == HDW_TYPE_INTEGER && right->type == HDW_TYPE_NUMBER) {
-		res = hdw_newValue(HDW_TYPE_BOOLEAN, (double) left->as_integer > right->as_number);
+	else if (left.type == HDW_TYPE_INTEGER && right.type == HDW_TYPE_NUMBER) {
+		res = hdw_newValue(HDW_TYPE_BOOLEAN, (double) left.as_integer > right.as_number);
 	}
-	else if (left->type == HDW_TYPE_NUMBER && right->type == HDW_TYPE_INTEGER) {
-		res = hdw_newValue(HDW_TYPE_BOOLEAN, left->as_number > (double) right->as_integer);
+	else if (left.type == HDW_TYPE_NUMBER && right.type == HDW_TYPE_INTEGER) {
+		res = hdw_newValue(HDW_TYPE_BOOLEAN, left.as_number > (double) right.as_integer);
 	}
-	else if (left->type == HDW_TYPE_NUMBER && right->type == HDW_TYPE_NUMBER) {
-		res = hdw_newValue(HDW_TYPE_BOOLEAN, left->as_number > right->as_number);
+	else if (left.type == HDW_TYPE_NUMBER && right.type == HDW_TYPE_NUMBER) {
+		res = hdw_newValue(HDW_TYPE_BOOLEAN, left.as_number > right.as_number);
 	}
 	else {
-		hdw_interpreterError("Failed to find greater values because the types can't be compared.");
+		hdw_interpreterError(interpreter, "Failed to find greater values because the types can't be compared.");
 		res = hdw_nullValue();
 	}
 	
-	free(left);
-	free(right);
-	
 	return res;
 }
 
-static hdw_value *hdw_opGTE(hdw_interpreter *interpreter, const hdw_treenode * const restrict tree) {
-	hdw_value *left = hdw_interpreterEvaluate(interpreter, &tree->children[0]);
-	hdw_value *right = hdw_interpreterEvaluate(interpreter, &tree->children[1]);
-	hdw_value *res;
+static hdw_value hdw_opGT(hdw_interpreter *interpreter, const hdw_treenode * const restrict tree) {
+	hdw_value left = hdw_interpreterEvaluate(interpreter, &tree->children[0]);
+	hdw_value right = hdw_interpreterEvaluate(interpreter, &tree->children[1]);
+	
+	return hdw_valueGT(interpreter, left, right);
+}
+
+static hdw_value hdw_valueGTE(hdw_interpreter *interpreter, const hdw_value left, const hdw_value right) {
+	hdw_value res;
 	
-	if (left->type == HDW_TYPE_INTEGER && right->type == HDW_TYPE_INTEGER) {
-		res = hdw_newValue(HDW_TYPE_BOOLEAN, left->as_integer >= right->as_integer);
+	if (left.type == HDW_TYPE_INTEGER && right.type == HDW_TYPE_INTEGER) {
+		res = hdw_newValue(HDW_TYPE_BOOLEAN, left.as_integer >= right.as_integer);
 	}
-	else if (left->type == HDW_TYPE_INTEGER && right->type == HDW_TYPE_NUMBER) {
-		res = hdw_newValue(HDW_TYPE_BOOLEAN, (double) left->as_integer >= right->as_number);
+	else if (left.type == HDW_TYPE_INTEGER && right.type == HDW_TYPE_NUMBER) {
+		res = hdw_newValue(HDW_TYPE_BOOLEAN, (double) left.as_integer >= right.as_number);
 	}
-	else if (left->type == HDW_TYPE_NUMBER && right->type == HDW_TYPE_INTEGER) {
-		res = hdw_newValue(HDW_TYPE_BOOLEAN, left->as_number >= (double) right->as_integer);
+	else if (left.type == HDW_TYPE_NUMBER && right.type == HDW_TYPE_INTEGER) {
+		res = hdw_newValue(HDW_TYPE_BOOLEAN, left.as_number >= (double) right.as_integer);
 	}
-	else if (left->type == HDW_TYPE_NUMBER && right->type == HDW_TYPE_NUMBER) {
-		res = hdw_newValue(HDW_TYPE_BOOLEAN, left->as_number >= right->as_number);
+	else if (left.type == HDW_TYPE_NUMBER && right.type == HDW_TYPE_NUMBER) {
+		res = hdw_newValue(HDW_TYPE_BOOLEAN, left.as_number >= right.as_number);
 	}
 	else {
-		hdw_interpreterError("Failed to find greater or equal values because the types can't be compared.");
+		hdw_interpreterError(interpreter, "Failed to find greater or equal values because the types can't be compared.");
 		res = hdw_nullValue();
 	}
 	
-	free(left);
-	free(right);
-	
 	return res;
 }
 
-static hdw_value *hdw_opLT(hdw_interpreter *interpreter, const hdw_treenode * const restrict tree) {
-	hdw_value *left = hdw_interpreterEvaluate(interpreter, &tree->children[0]);
-	hdw_value *right = hdw_interpreterEvaluate(interpreter, &tree->children[1]);
-	hdw_value *res;
+static hdw_value hdw_opGTE(hdw_interpreter *interpreter, const hdw_treenode * const restrict tree) {
+	hdw_value left = hdw_interpreterEvaluate(interpreter, &tree->children[0]);
+	hdw_value right = hdw_interpreterEvaluate(interpreter, &tree->children[1]);
 	
-	if (left->type == HDW_TYPE_INTEGER && right->type == HDW_TYPE_INTEGER) {
-		res = hdw_newValue(HDW_TYPE_BOOLEAN, left->as_integer < right->as_integer);
+	return hdw_valueGTE(interpreter, left, right);
+}
+
+static hdw_value hdw_valueLT(hdw_interpreter *interpreter, const hdw_value left, const hdw_value right) {
+	hdw_value res;
+	
+	if (left.type == HDW_TYPE_INTEGER && right.type == HDW_TYPE_INTEGER) {
+		res = hdw_newValue(HDW_TYPE_BOOLEAN, left.as_integer < right.as_integer);
 	}
-	else if (left->type == HDW_TYPE_INTEGER && right->type == HDW_TYPE_NUMBER) {
-		res = hdw_newValue(HDW_TYPE_BOOLEAN, (double) left->as_integer < right->as_number);
+	else if (left.type == HDW_TYPE_INTEGER && right.type == HDW_TYPE_NUMBER) {
+		res = hdw_newValue(HDW_TYPE_BOOLEAN, (double) left.as_integer < right.as_number);
 	}
-	else if (left->type == HDW_TYPE_NUMBER && right->type == HDW_TYPE_INTEGER) {
-		res = hdw_newValue(HDW_TYPE_BOOLEAN, left->as_number < (double) right->as_integer);
+	else if (left.type == HDW_TYPE_NUMBER && right.type == HDW_TYPE_INTEGER) {
+		res = hdw_newValue(HDW_TYPE_BOOLEAN, left.as_number < (double) right.as_integer);
 	}
-	else if (left->type == HDW_TYPE_NUMBER && right->type == HDW_TYPE_NUMBER) {
-		res = hdw_newValue(HDW_TYPE_BOOLEAN, left->as_number < right->as_number);
+	else if (left.type == HDW_TYPE_NUMBER && right.type == HDW_TYPE_NUMBER) {
+		res = hdw_newValue(HDW_TYPE_BOOLEAN, left.as_number < right.as_number);
 	}
 	else {
-		hdw_interpreterError("Failed to find lesser values because the types can't be compared.");
+		hdw_interpreterError(interpreter, "Failed to find lesser values because the types can't be compared.");
 		res = hdw_nullValue();
 	}
 	
-	free(left);
-	free(right);
-	
 	return res;
 }
 
-static hdw_value *hdw_opLTE(hdw_interpreter *interpreter, const hdw_treenode * const restrict tree) {
-	hdw_value *left = hdw_interpreterEvaluate(interpreter, &tree->children[0]);
-	hdw_value *right = hdw_interpreterEvaluate(interpreter, &tree->children[1]);
-	hdw_value *res;
+static hdw_value hdw_opLT(hdw_interpreter *interpreter, const hdw_treenode * const restrict tree) {
+	hdw_value left = hdw_interpreterEvaluate(interpreter, &tree->children[0]);
+	hdw_value right = hdw_interpreterEvaluate(interpreter, &tree->children[1]);
+	
+	return hdw_valueLT(interpreter, left, right);
+}
+
+static hdw_value hdw_valueLTE(hdw_interpreter *interpreter, const hdw_value left, const hdw_value right) {
+	hdw_value res;
 	
-	if (left->type == HDW_TYPE_INTEGER && right->type == HDW_TYPE_INTEGER) {
-		res = hdw_newValue(HDW_TYPE_BOOLEAN, left->as_integer <= right->as_integer);
+	if (left.type == HDW_TYPE_INTEGER && right.type == HDW_TYPE_INTEGER) {
+		res = hdw_newValue(HDW_TYPE_BOOLEAN, left.as_integer <= right.as_integer);
 	}
-	else if (left->type == HDW_TYPE_INTEGER && right->type == HDW_TYPE_NUMBER) {
-		res = hdw_newValue(HDW_TYPE_BOOLEAN, (double) left->as_integer <= right->as_number);
+	else if (left.type == HDW_TYPE_INTEGER && right.type == HDW_TYPE_NUMBER) {
+		res = hdw_newValue(HDW_TYPE_BOOLEAN, (double) left.as_integer <= right.as_number);
 	}
-	else if (left->type == HDW_TYPE_NUMBER && right->type == HDW_TYPE_INTEGER) {
-		res = hdw_newValue(HDW_TYPE_BOOLEAN, left->as_number <= (double) right->as_integer);
+	else if (left.type == HDW_TYPE_NUMBER && right.type == HDW_TYPE_INTEGER) {
+		res = hdw_newValue(HDW_TYPE_BOOLEAN, left.as_number <= (double) right.as_integer);
 	}
-	else if (left->type == HDW_TYPE_NUMBER && right->type == HDW_TYPE_NUMBER) {
-		res = hdw_newValue(HDW_TYPE_BOOLEAN, left->as_number <= right->as_number);
+	else if (left.type == HDW_TYPE_NUMBER && right.type == HDW_TYPE_NUMBER) {
+		res = hdw_newValue(HDW_TYPE_BOOLEAN, left.as_number <= right.as_number);
 	}
 	else {
-		hdw_interpreterError("Failed to find lesser or equal values because the types can't be compared.");
+		hdw_interpreterError(interpreter, "Failed to find lesser or equal values because the types can't be compared.");
 		res = hdw_nullValue();
 	}
 	
-	free(left);
-	free(right);
-	
 	return res;
 }
 
-static hdw_value *hdw_interpreterEvaluate(hdw_interpreter *interpreter, const hdw_treenode * const restrict tree) {
-	hdw_value *value;
+static hdw_value hdw_opLTE(hdw_interpreter *interpreter, const hdw_treenode * const restrict tree) {
+	hdw_value left = hdw_interpreterEvaluate(interpreter, &tree->children[0]);
+	hdw_value right = hdw_interpreterEvaluate(interpreter, &tree->children[1]);
+	
+	return hdw_valueLTE(interpreter, left, right);
+}
+
+static hdw_value hdw_interpreterEvaluate(hdw_interpreter *interpreter, const hdw_treenode * const restrict tree) {
+	hdw_value value;
 	
 	if (!tree) {
 		return hdw_nullValue();
@@ -358,11 +383,10 @@ static hdw_value *hdw_interpreterEvaluate(hdw_interpreter *interpreter, const hd
 			return hdw_newValue(HDW_TYPE_INTEGER, -tree->children[0].as_integer);
 		}
 		else if (tree->children[0].type == HDW_NUMBER) {
-			double a = (-tree->children[0].as_number);
-			return hdw_newValue(HDW_TYPE_NUMBER, *(int64_t*)&a);
+			return hdw_newNumberValue(-tree->children[0].as_number);
 		}
 		else {
-			hdw_interpreterError("Cannot negate something that isn't an integer or number.");
+			hdw_interpreterError(interpreter, "Cannot negate something that isn't an integer or number.");
 			return hdw_nullValue();
 		}
 	}
@@ -424,19 +448,23 @@ static hdw_value *hdw_interpreterEvaluate(hdw_interpreter *interpreter, const hd
 	
 	// Not supported or invalid, return null.
 	else {
-		hdw_interpreterError("Unknown kind of expression.");
+		hdw_interpreterError(interpreter, "Unknown kind of expression.");
 		return hdw_nullValue();
 	}
 	
 	return value;
 }
 
-int32_t hdw_interpret(const hdw_treenode * const restrict tree, hdw_value ** const restrict result) {
-	hdw_interpreter interpreter;
+int32_t hdw_interpret(const hdw_treenode * const restrict tree, hdw_value * const restrict result) {
+	/**
+	 * Evaluate a tree, writing its value into the caller's result slot.
+	 */
+	
+	hdw_interpreter interpreter = {0};
 	
 	*result = hdw_interpreterEvaluate(&interpreter, tree);
 	
-	if (!*result) {
+	if (interpreter.errors) {
 		return HDW_ERR_INTERPRETER;
 	}
 	
@@ -0,0 +1,1385 @@
+// =============================================================================
+// Intermediate Representation
+// =============================================================================
+
+static const char * const hdw_irNames[] = {
+	"const", "copy", "phi", "neg", "not", "add", "sub", "mul", "div", "eq",
+	"noteq", "lt", "gt", "lteq", "gteq", "jump", "branch", "return",
+};
+
+static void hdw_irInit(hdw_irfunction *fn) {
+	/**
+	 * Initialise an empty function.
+	 */
+	
+	memset(fn, 0, sizeof *fn);
+}
+
+static void hdw_irFree(hdw_irfunction *fn) {
+	/**
+	 * Free a function and everything in it.
+	 */
+	
+	for (uint32_t i = 0; i < fn->count; i++) {
+		free(fn->instrs[i].phi_args);
+	}
+	
+	for (uint32_t i = 0; i < fn->block_count; i++) {
+		free(fn->blocks[i].code);
+		free(fn->blocks[i].preds);
+		free(fn->blocks[i].defs);
+		free(fn->blocks[i].incomplete);
+	}
+	
+	free(fn->instrs);
+	free(fn->blocks);
+	free(fn->variables);
+	free(fn->order);
+	
+	memset(fn, 0, sizeof *fn);
+}
+
+static bool hdw_irAppend(hdw_irfunction *fn, uint32_t **array, uint32_t *count, uint32_t value) {
+	/**
+	 * Append to a short array that grows one item at a time.
+	 */
+	
+	uint32_t *p = hdw_realloc(*array, sizeof **array * (*count + 1));
+	
+	if (!p) {
+		fn->error = "Out of memory";
+		return false;
+	}
+	
+	*array = p;
+	(*array)[(*count)++] = value;
+	
+	return true;
+}
+
+static uint32_t *hdw_irArgs(hdw_irinstr *instr) {
+	return (instr->op == HDW_IR_PHI) ? instr->phi_args : instr->args;
+}
+
+static bool hdw_irIsTerminator(uint16_t op) {
+	return op == HDW_IR_JUMP || op == HDW_IR_BRANCH || op == HDW_IR_RETURN;
+}
+
+static uint32_t hdw_irNewBlock(hdw_irfunction *fn) {
+	/**
+	 * Add an empty, unsealed block and return its index.
+	 */
+	
+	if (fn->block_count >= fn->block_alloc) {
+		uint32_t alloc = fn->block_alloc ? fn->block_alloc * 2 : 8;
+		hdw_irblock *blocks = hdw_realloc(fn->blocks, sizeof *blocks * alloc);
+		
+		if (!blocks) {
+			fn->error = "Out of memory";
+			return HDW_IR_NONE;
+		}
+		
+		fn->blocks = blocks;
+		fn->block_alloc = alloc;
+	}
+	
+	hdw_irblock *block = &fn->blocks[fn->block_count];
+	
+	memset(block, 0, sizeof *block);
+	block->idom = HDW_IR_NONE;
+	block->order = HDW_IR_NONE;
+	
+	return fn->block_count++;
+}
+
+static void hdw_irLink(hdw_irfunction *fn, uint32_t from, uint32_t to) {
+	/**
+	 * Add an edge between two blocks.
+	 */
+	
+	fn->blocks[from].succs[fn->blocks[from].succs_count++] = to;
+	hdw_irAppend(fn, &fn->blocks[to].preds, &fn->blocks[to].preds_count, from);
+}
+
+static bool hdw_irInsert(hdw_irfunction *fn, uint32_t block, uint32_t where, uint32_t id) {
+	/**
+	 * Put an instruction into a block before position where.
+	 */
+	
+	hdw_irblock *b = &fn->blocks[block];
+	
+	if (b->count >= b->alloc) {
+		uint32_t alloc = b->alloc ? b->alloc * 2 : 8;
+		uint32_t *code = hdw_realloc(b->code, sizeof *code * alloc);
+		
+		if (!code) {
+			fn->error = "Out of memory";
+			return false;
+		}
+		
+		b->code = code;
+		b->alloc = alloc;
+	}
+	
+	memmove(&b->code[where + 1], &b->code[where], sizeof *b->code * (b->count - where));
+	b->code[where] = id;
+	b->count++;
+	
+	fn->instrs[id].block = block;
+	
+	return true;
+}
+
+static uint32_t hdw_irNew(hdw_irfunction *fn, uint32_t block, uint16_t op, uint32_t a, uint32_t b, uint32_t args_count) {
+	/**
+	 * Add an instruction to the end of a block and return its index, which is
+	 * also the name of the value it makes.
+	 */
+	
+	if (fn->error) {
+		return HDW_IR_NONE;
+	}
+	
+	if (fn->count >= fn->alloc) {
+		uint32_t alloc = fn->alloc ? fn->alloc * 2 : 32;
+		hdw_irinstr *instrs = hdw_realloc(fn->instrs, sizeof *instrs * alloc);
+		
+		if (!instrs) {
+			fn->error = "Out of memory";
+			return HDW_IR_NONE;
+		}
+		
+		fn->instrs = instrs;
+		fn->alloc = alloc;
+	}
+	
+	uint32_t id = fn->count++;
+	
+	fn->instrs[id] = (hdw_irinstr) {
+		.args = {a, b},
+		.args_count = args_count,
+		.op = op,
+		.type = HDW_IR_UNSET,
+	};
+	
+	uint32_t where = fn->blocks[block].count;
+	
+	// Phis go before everything else in the block
+	if (op == HDW_IR_PHI) {
+		where = 0;
+	}
+	
+	if (!hdw_irInsert(fn, block, where, id)) {
+		return HDW_IR_NONE;
+	}
+	
+	return id;
+}
+
+static uint32_t hdw_irConst(hdw_irfunction *fn, uint32_t block, hdw_value value) {
+	uint32_t id = hdw_irNew(fn, block, HDW_IR_CONST, 0, 0, 0);
+	
+	if (id != HDW_IR_NONE) {
+		fn->instrs[id].constant = value;
+	}
+	
+	return id;
+}
+
+static uint32_t hdw_irNull(hdw_irfunction *fn, uint32_t block) {
+	return hdw_irConst(fn, block, (hdw_value) {.type = HDW_TYPE_NULL});
+}
+
+// -----------------------------------------------------------------------------
+// SSA Construction
+// -----------------------------------------------------------------------------
+
+// Variables are put in SSA form while the tree is lowered, as described in
+// "Simple and Efficient Construction of Static Single Assignment Form" by Braun
+// et al. Each block remembers the value each variable was last given in it.
+// Reading a variable a block doesn't set looks through its predecessors and
+// makes a phi where they disagree. Blocks that may still get predecessors (a
+// loop header before the loop body is lowered) are not sealed, and phis made
+// in them are finished once they are.
+
+static uint32_t hdw_irRead(hdw_irfunction *fn, uint32_t block, uint32_t var);
+
+static uint32_t hdw_irVariable(hdw_irfunction *fn, const char *name) {
+	/**
+	 * Find the number of a variable, adding it if it is new.
+	 */
+	
+	for (uint32_t i = 0; i < fn->variable_count; i++) {
+		if (!strcmp(fn->variables[i], name)) {
+			return i;
+		}
+	}
+	
+	const char **variables = hdw_realloc(fn->variables, sizeof *variables * (fn->variable_count + 1));
+	
+	if (!variables) {
+		fn->error = "Out of memory";
+		return HDW_IR_NONE;
+	}
+	
+	fn->variables = variables;
+	fn->variables[fn->variable_count] = name;
+	
+	return fn->variable_count++;
+}
+
+static void hdw_irWrite(hdw_irfunction *fn, uint32_t block, uint32_t var, uint32_t value) {
+	hdw_irblock *b = &fn->blocks[block];
+	
+	while (b->defs_count <= var) {
+		if (!hdw_irAppend(fn, &b->defs, &b->defs_count, HDW_IR_NONE)) {
+			return;
+		}
+	}
+	
+	b->defs[var] = value;
+}
+
+static uint32_t hdw_irRemoveTrivialPhi(hdw_irfunction *fn, uint32_t phi) {
+	/**
+	 * A phi whose arguments are all the same value, or the phi itself, is just
+	 * that value. It is turned into a copy for copy propagation to clean up, or
+	 * into null if it has no arguments at all, which only happens in a block
+	 * nothing can reach.
+	 */
+	
+	hdw_irinstr *instr = &fn->instrs[phi];
+	uint32_t same = HDW_IR_NONE;
+	
+	for (uint32_t i = 0; i < instr->args_count; i++) {
+		uint32_t arg = instr->phi_args[i];
+		
+		if (arg == same || arg == phi) {
+			continue;
+		}
+		
+		if (same != HDW_IR_NONE) {
+			return phi;
+		}
+		
+		same = arg;
+	}
+	
+	free(instr->phi_args);
+	instr->phi_args = NULL;
+	
+	if (same == HDW_IR_NONE) {
+		instr->op = HDW_IR_CONST;
+		instr->args_count = 0;
+		instr->constant = (hdw_value) {.type = HDW_TYPE_NULL};
+	}
+	else {
+		instr->op = HDW_IR_COPY;
+		instr->args[0] = same;
+		instr->args_count = 1;
+	}
+	
+	return phi;
+}
+
+static uint32_t hdw_irAddPhiOperands(hdw_irfunction *fn, uint32_t var, uint32_t phi) {
+	uint32_t block = fn->instrs[phi].block;
+	
+	for (uint32_t i = 0; i < fn->blocks[block].preds_count; i++) {
+		uint32_t value = hdw_irRead(fn, fn->blocks[block].preds[i], var);
+		
+		if (fn->error) {
+			return HDW_IR_NONE;
+		}
+		
+		hdw_irAppend(fn, &fn->instrs[phi].phi_args, &fn->instrs[phi].args_count, value);
+	}
+	
+	return hdw_irRemoveTrivialPhi(fn, phi);
+}
+
+static uint32_t hdw_irRead(hdw_irfunction *fn, uint32_t block, uint32_t var) {
+	/**
+	 * Get the value a variable has at the end of a block. Getting back to the
+	 * entry block without finding where it was set means some path reads it
+	 * before it has a value, which is an error rather than null.
+	 */
+	
+	hdw_irblock *b = &fn->blocks[block];
+	uint32_t value;
+	
+	if (var < b->defs_count && b->defs[var] != HDW_IR_NONE) {
+		return b->defs[var];
+	}
+	
+	if (block == 0) {
+		fn->error = "Undefined variable";
+		return HDW_IR_NONE;
+	}
+	
+	if (!b->sealed) {
+		value = hdw_irNew(fn, block, HDW_IR_PHI, 0, 0, 0);
+		
+		if (value == HDW_IR_NONE) {
+			return HDW_IR_NONE;
+		}
+		
+		hdw_irAppend(fn, &b->incomplete, &b->incomplete_count, var);
+		hdw_irAppend(fn, &b->incomplete, &b->incomplete_count, value);
+	}
+	else if (b->preds_count == 1) {
+		value = hdw_irRead(fn, b->preds[0], var);
+		
+		if (fn->error) {
+			return HDW_IR_NONE;
+		}
+	}
+	else {
+		// Written first to stop loops going round forever
+		value = hdw_irNew(fn, block, HDW_IR_PHI, 0, 0, 0);
+		
+		if (value == HDW_IR_NONE) {
+			return HDW_IR_NONE;
+		}
+		
+		hdw_irWrite(fn, block, var, value);
+		value = hdw_irAddPhiOperands(fn, var, value);
+	}
+	
+	hdw_irWrite(fn, block, var, value);
+	
+	return value;
+}
+
+static void hdw_irSeal(hdw_irfunction *fn, uint32_t block) {
+	/**
+	 * Mark that a block has all of its predecessors, and finish the phis that
+	 * were made in it before then.
+	 */
+	
+	for (uint32_t i = 0; i + 1 < fn->blocks[block].incomplete_count; i += 2) {
+		hdw_irAddPhiOperands(fn, fn->blocks[block].incomplete[i], fn->blocks[block].incomplete[i + 1]);
+	}
+	
+	free(fn->blocks[block].incomplete);
+	fn->blocks[block].incomplete = NULL;
+	fn->blocks[block].incomplete_count = 0;
+	fn->blocks[block].sealed = true;
+}
+
+// -----------------------------------------------------------------------------
+// Lowering
+// -----------------------------------------------------------------------------
+
+static uint32_t hdw_irLower(hdw_irfunction *fn, uint32_t *block, const hdw_treenode * const restrict tree);
+
+static uint32_t hdw_irLowerBinary(hdw_irfunction *fn, uint32_t *block, const hdw_treenode * const restrict tree, uint16_t op) {
+	uint32_t a = hdw_irLower(fn, block, &tree->children[0]);
+	uint32_t b = hdw_irLower(fn, block, &tree->children[1]);
+	
+	return hdw_irNew(fn, *block, op, a, b, 2);
+}
+
+static uint32_t hdw_irLowerTernary(hdw_irfunction *fn, uint32_t *block, const hdw_treenode * const restrict tree) {
+	/**
+	 * Lower a ? b : c to a diamond, with a phi picking the result.
+	 */
+	
+	uint32_t cond = hdw_irLower(fn, block, &tree->children[0]);
+	uint32_t then_block = hdw_irNewBlock(fn);
+	uint32_t else_block = hdw_irNewBlock(fn);
+	uint32_t join = hdw_irNewBlock(fn);
+	
+	if (fn->error) {
+		return HDW_IR_NONE;
+	}
+	
+	hdw_irNew(fn, *block, HDW_IR_BRANCH, cond, 0, 1);
+	hdw_irLink(fn, *block, then_block);
+	hdw_irLink(fn, *block, else_block);
+	hdw_irSeal(fn, then_block);
+	hdw_irSeal(fn, else_block);
+	
+	uint32_t a = hdw_irLower(fn, &then_block, &tree->children[1]);
+	hdw_irNew(fn, then_block, HDW_IR_JUMP, 0, 0, 0);
+	hdw_irLink(fn, then_block, join);
+	
+	uint32_t b = hdw_irLower(fn, &else_block, &tree->children[2]);
+	hdw_irNew(fn, else_block, HDW_IR_JUMP, 0, 0, 0);
+	hdw_irLink(fn, else_block, join);
+	
+	hdw_irSeal(fn, join);
+	*block = join;
+	
+	uint32_t phi = hdw_irNew(fn, join, HDW_IR_PHI, 0, 0, 0);
+	
+	if (fn->error) {
+		return HDW_IR_NONE;
+	}
+	
+	hdw_irAppend(fn, &fn->instrs[phi].phi_args, &fn->instrs[phi].args_count, a);
+	hdw_irAppend(fn, &fn->instrs[phi].phi_args, &fn->instrs[phi].args_count, b);
+	
+	return hdw_irRemoveTrivialPhi(fn, phi);
+}
+
+static uint32_t hdw_irLowerWhile(hdw_irfunction *fn, uint32_t *block, const hdw_treenode * const restrict tree) {
+	/**
+	 * Lower a while loop. The block before the loop only jumps to the header,
+	 * which is where loop invariant code gets hoisted to.
+	 */
+	
+	uint32_t header = hdw_irNewBlock(fn);
+	uint32_t body = hdw_irNewBlock(fn);
+	uint32_t exit = hdw_irNewBlock(fn);
+	
+	if (fn->error) {
+		return HDW_IR_NONE;
+	}
+	
+	hdw_irNew(fn, *block, HDW_IR_JUMP, 0, 0, 0);
+	hdw_irLink(fn, *block, header);
+	
+	uint32_t cond_block = header;
+	uint32_t cond = hdw_irLower(fn, &cond_block, &tree->children[0]);
+	
+	hdw_irNew(fn, cond_block, HDW_IR_BRANCH, cond, 0, 1);
+	hdw_irLink(fn, cond_block, body);
+	hdw_irLink(fn, cond_block, exit);
+	hdw_irSeal(fn, body);
+	
+	hdw_irLower(fn, &body, &tree->children[1]);
+	hdw_irNew(fn, body, HDW_IR_JUMP, 0, 0, 0);
+	hdw_irLink(fn, body, header);
+	
+	hdw_irSeal(fn, header);
+	hdw_irSeal(fn, exit);
+	*block = exit;
+	
+	return hdw_irNull(fn, exit);
+}
+
+static uint32_t hdw_irLower(hdw_irfunction *fn, uint32_t *block, const hdw_treenode * const restrict tree) {
+	/**
+	 * Lower a tree to instructions at the end of *block, returning the value
+	 * it evaluates to. Control flow moves *block on to the block that code
+	 * after it should go in.
+	 */
+	
+	if (fn->error) {
+		return HDW_IR_NONE;
+	}
+	
+	switch (tree->type) {
+		// The program and other statement lists have the value of the last
+		// statement
+		case HDW_DEFAULT: {
+			uint32_t value = HDW_IR_NONE;
+			
+			for (size_t i = 0; i < tree->children_count; i++) {
+				value = hdw_irLower(fn, block, &tree->children[i]);
+			}
+			
+			return (value == HDW_IR_NONE) ? hdw_irNull(fn, *block) : value;
+		}
+		case HDW_SYMBOL: {
+			uint32_t var = hdw_irVariable(fn, tree->as_string);
+			
+			return (var == HDW_IR_NONE) ? HDW_IR_NONE : hdw_irRead(fn, *block, var);
+		}
+		case HDW_SET: {
+			uint32_t var = hdw_irVariable(fn, tree->children[0].as_string);
+			uint32_t value = hdw_irLower(fn, block, &tree->children[1]);
+			
+			if (!fn->error) {
+				hdw_irWrite(fn, *block, var, value);
+			}
+			
+			return value;
+		}
+		case HDW_NULL: {
+			return hdw_irNull(fn, *block);
+		}
+		case HDW_TRUE:
+		case HDW_FALSE: {
+			return hdw_irConst(fn, *block, (hdw_value) {.type = HDW_TYPE_BOOLEAN, .as_boolean = (tree->type == HDW_TRUE)});
+		}
+		case HDW_STRING: {
+			return hdw_irConst(fn, *block, (hdw_value) {.type = HDW_TYPE_STRING, .as_string = tree->as_literal});
+		}
+		case HDW_NUMBER: {
+			return hdw_irConst(fn, *block, (hdw_value) {.type = HDW_TYPE_NUMBER, .as_number = tree->as_number});
+		}
+		case HDW_INTEGER: {
+			return hdw_irConst(fn, *block, (hdw_value) {.type = HDW_TYPE_INTEGER, .as_integer = tree->as_integer});
+		}
+		case HDW_EXPR: {
+			return hdw_irLower(fn, block, &tree->children[0]);
+		}
+		case HDW_EXPRGRP: {
+			hdw_irLower(fn, block, &tree->children[0]);
+			return hdw_irLower(fn, block, &tree->children[1]);
+		}
+		case HDW_MINUS: {
+			if (tree->children_count == 1) {
+				return hdw_irNew(fn, *block, HDW_IR_NEG, hdw_irLower(fn, block, &tree->children[0]), 0, 1);
+			}
+			
+			return hdw_irLowerBinary(fn, block, tree, HDW_IR_SUB);
+		}
+		case HDW_NOT: {
+			return hdw_irNew(fn, *block, HDW_IR_NOT, hdw_irLower(fn, block, &tree->children[0]), 0, 1);
+		}
+		case HDW_PLUS: return hdw_irLowerBinary(fn, block, tree, HDW_IR_ADD);
+		case HDW_ASTRESK: return hdw_irLowerBinary(fn, block, tree, HDW_IR_MUL);
+		case HDW_BACK: return hdw_irLowerBinary(fn, block, tree, HDW_IR_DIV);
+		case HDW_EQ: return hdw_irLowerBinary(fn, block, tree, HDW_IR_EQ);
+		case HDW_NOTEQ: return hdw_irLowerBinary(fn, block, tree, HDW_IR_NOTEQ);
+		case HDW_LT: return hdw_irLowerBinary(fn, block, tree, HDW_IR_LT);
+		case HDW_GT: return hdw_irLowerBinary(fn, block, tree, HDW_IR_GT);
+		case HDW_LTEQ: return hdw_irLowerBinary(fn, block, tree, HDW_IR_LTEQ);
+		case HDW_GTEQ: return hdw_irLowerBinary(fn, block, tree, HDW_IR_GTEQ);
+		case HDW_TERNARY: {
+			return hdw_irLowerTernary(fn, block, tree);
+		}
+		case HDW_WHILE: {
+			return hdw_irLowerWhile(fn, block, tree);
+		}
+		default: {
+			fn->error = "Unknown kind of expression";
+			return HDW_IR_NONE;
+		}
+	}
+}
+
+static int32_t hdw_irBuild(hdw_irfunction *fn, const hdw_treenode * const restrict tree) {
+	/**
+	 * Lower a whole tree into a function that returns its value.
+	 */
+	
+	uint32_t block = hdw_irNewBlock(fn);
+	
+	if (block == HDW_IR_NONE) {
+		return HDW_ERR_COMPILER;
+	}
+	
+	hdw_irSeal(fn, block);
+	
+	uint32_t value = hdw_irLower(fn, &block, tree);
+	
+	hdw_irNew(fn, block, HDW_IR_RETURN, value, 0, 1);
+	
+	return fn->error ? HDW_ERR_COMPILER : HDW_ERR_OKAY;
+}
+
+// -----------------------------------------------------------------------------
+// Analysis
+// -----------------------------------------------------------------------------
+
+static size_t hdw_irSize(const hdw_irfunction *fn) {
+	/**
+	 * Number of instructions left in the function.
+	 */
+	
+	size_t size = 0;
+	
+	for (uint32_t i = 0; i < fn->block_count; i++) {
+		size += fn->blocks[i].count;
+	}
+	
+	return size;
+}
+
+static void hdw_irRemoveDead(hdw_irfunction *fn) {
+	/**
+	 * Take instructions marked as dead out of their blocks.
+	 */
+	
+	for (uint32_t i = 0; i < fn->block_count; i++) {
+		hdw_irblock *b = &fn->blocks[i];
+		uint32_t kept = 0;
+		
+		for (uint32_t j = 0; j < b->count; j++) {
+			if (!fn->instrs[b->code[j]].dead) {
+				b->code[kept++] = b->code[j];
+			}
+		}
+		
+		b->count = kept;
+	}
+}
+
+static bool hdw_irComputeOrder(hdw_irfunction *fn) {
+	/**
+	 * Number the reachable blocks in reverse postorder, so every block comes
+	 * before the blocks it dominates. Successors are visited last first, so
+	 * that the first successor of a branch comes straight after it.
+	 */
+	
+	uint32_t *order = hdw_realloc(fn->order, sizeof *order * fn->block_count);
+	
+	if (!order) {
+		fn->error = "Out of memory";
+		return false;
+	}
+	
+	fn->order = order;
+	
+	uint32_t *stack = hdw_malloc(sizeof *stack * fn->block_count);
+	uint32_t *next = hdw_calloc(fn->block_count, sizeof *next);
+	bool *seen = hdw_calloc(fn->block_count, sizeof *seen);
+	
+	if (!stack || !next || !seen) {
+		free(stack);
+		free(next);
+		free(seen);
+		fn->error = "Out of memory";
+		return false;
+	}
+	
+	// Postorder with an explicit stack, then reversed
+	uint32_t depth = 0, count = 0;
+	
+	stack[depth++] = 0;
+	seen[0] = true;
+	
+	while (depth) {
+		uint32_t block = stack[depth - 1];
+		
+		if (next[block] < fn->blocks[block].succs_count) {
+			uint32_t succ = fn->blocks[block].succs[fn->blocks[block].succs_count - ++next[block]];
+			
+			if (!seen[succ]) {
+				seen[succ] = true;
+				stack[depth++] = succ;
+			}
+		}
+		else {
+			order[count++] = block;
+			depth--;
+		}
+	}
+	
+	for (uint32_t i = 0; i < count / 2; i++) {
+		uint32_t t = order[i];
+		order[i] = order[count - 1 - i];
+		order[count - 1 - i] = t;
+	}
+	
+	for (uint32_t i = 0; i < fn->block_count; i++) {
+		fn->blocks[i].order = HDW_IR_NONE;
+	}
+	
+	for (uint32_t i = 0; i < count; i++) {
+		fn->blocks[order[i]].order = i;
+	}
+	
+	fn->order_count = count;
+	
+	free(stack);
+	free(next);
+	free(seen);
+	
+	return true;
+}
+
+static bool hdw_irComputeDominators(hdw_irfunction *fn) {
+	/**
+	 * Find the immediate dominator of every reachable block, using "A Simple,
+	 * Fast Dominance Algorithm" by Cooper, Harvey and Kennedy.
+	 */
+	
+	if (!hdw_irComputeOrder(fn)) {
+		return false;
+	}
+	
+	for (uint32_t i = 0; i < fn->block_count; i++) {
+		fn->blocks[i].idom = HDW_IR_NONE;
+	}
+	
+	fn->blocks[0].idom = 0;
+	
+	bool changed = true;
+	
+	while (changed) {
+		changed = false;
+		
+		for (uint32_t i = 1; i < fn->order_count; i++) {
+			uint32_t block = fn->order[i];
+			uint32_t idom = HDW_IR_NONE;
+			
+			for (uint32_t j = 0; j < fn->blocks[block].preds_count; j++) {
+				uint32_t pred = fn->blocks[block].preds[j];
+				
+				if (fn->blocks[pred].idom == HDW_IR_NONE) {
+					continue;
+				}
+				
+				if (idom == HDW_IR_NONE) {
+					idom = pred;
+					continue;
+				}
+				
+				uint32_t a = pred, b = idom;
+				
+				while (a != b) {
+					while (fn->blocks[a].order > fn->blocks[b].order) {
+						a = fn->blocks[a].idom;
+					}
+					
+					while (fn->blocks[b].order > fn->blocks[a].order) {
+						b = fn->blocks[b].idom;
+					}
+				}
+				
+				idom = a;
+			}
+			
+			if (fn->blocks[block].idom != idom) {
+				fn->blocks[block].idom = idom;
+				changed = true;
+			}
+		}
+	}
+	
+	return true;
+}
+
+static bool hdw_irDominates(const hdw_irfunction *fn, uint32_t a, uint32_t b) {
+	/**
+	 * Check if block a dominates block b.
+	 */
+	
+	while (b != a && b != 0) {
+		b = fn->blocks[b].idom;
+	}
+	
+	return b == a;
+}
+
+static bool hdw_irNumeric(uint8_t type) {
+	return type == HDW_TYPE_INTEGER || type == HDW_TYPE_NUMBER;
+}
+
+static uint8_t hdw_irResultType(const hdw_irfunction *fn, const hdw_irinstr *instr) {
+	/**
+	 * Work out the type of an instruction's result from what is known about
+	 * its arguments. Arithmetic on anything but numbers gives an error and
+	 * null, so it is only known to give a number when given numbers.
+	 */
+	
+	uint8_t a = (instr->args_count > 0 && instr->op != HDW_IR_PHI) ? fn->instrs[instr->args[0]].type : HDW_IR_ANY;
+	uint8_t b = (instr->args_count > 1 && instr->op != HDW_IR_PHI) ? fn->instrs[instr->args[1]].type : HDW_IR_ANY;
+	
+	switch (instr->op) {
+		case HDW_IR_CONST: {
+			return instr->constant.type;
+		}
+		case HDW_IR_COPY: {
+			return a;
+		}
+		case HDW_IR_PHI: {
+			uint8_t type = HDW_IR_UNSET;
+			
+			for (uint32_t i = 0; i < instr->args_count; i++) {
+				uint8_t arg = fn->instrs[instr->phi_args[i]].type;
+				
+				if (arg == HDW_IR_UNSET || arg == type) {
+					continue;
+				}
+				
+				type = (type == HDW_IR_UNSET) ? arg : HDW_IR_ANY;
+			}
+			
+			return type;
+		}
+		case HDW_IR_NEG: {
+			return hdw_irNumeric(a) ? a : HDW_IR_ANY;
+		}
+		case HDW_IR_NOT:
+		case HDW_IR_EQ:
+		case HDW_IR_NOTEQ: {
+			return HDW_TYPE_BOOLEAN;
+		}
+		case HDW_IR_ADD:
+		case HDW_IR_SUB:
+		case HDW_IR_MUL:
+		case HDW_IR_DIV: {
+			if (a == HDW_TYPE_INTEGER && b == HDW_TYPE_INTEGER) {
+				return HDW_TYPE_INTEGER;
+			}
+			
+			return (hdw_irNumeric(a) && hdw_irNumeric(b)) ? HDW_TYPE_NUMBER : HDW_IR_ANY;
+		}
+		case HDW_IR_LT:
+		case HDW_IR_GT:
+		case HDW_IR_LTEQ:
+		case HDW_IR_GTEQ: {
+			return (hdw_irNumeric(a) && hdw_irNumeric(b)) ? HDW_TYPE_BOOLEAN : HDW_IR_ANY;
+		}
+		default: {
+			return HDW_IR_ANY;
+		}
+	}
+}
+
+static bool hdw_irInferTypes(hdw_irfunction *fn) {
+	/**
+	 * Find the types of values where they can be known. Types start unset and
+	 * only move towards HDW_IR_ANY, so going over the blocks until nothing
+	 * changes is bounded.
+	 */
+	
+	if (!hdw_irComputeOrder(fn)) {
+		return false;
+	}
+	
+	for (uint32_t i = 0; i < fn->count; i++) {
+		fn->instrs[i].type = HDW_IR_UNSET;
+	}
+	
+	bool changed = true;
+	
+	while (changed) {
+		changed = false;
+		
+		for (uint32_t i = 0; i < fn->order_count; i++) {
+			hdw_irblock *b = &fn->blocks[fn->order[i]];
+			
+			for (uint32_t j = 0; j < b->count; j++) {
+				hdw_irinstr *instr = &fn->instrs[b->code[j]];
+				uint8_t type = hdw_irResultType(fn, instr);
+				
+				if (type != instr->type) {
+					instr->type = type;
+					changed = true;
+				}
+			}
+		}
+	}
+	
+	return true;
+}
+
+static bool hdw_irPure(const hdw_irfunction *fn, const hdw_irinstr *instr) {
+	/**
+	 * Check if an instruction can be removed, merged or moved without anyone
+	 * noticing. Anything that might print an error or crash is not, which
+	 * needs the types from hdw_irInferTypes.
+	 */
+	
+	uint8_t a = (instr->args_count > 0 && instr->op != HDW_IR_PHI) ? fn->instrs[instr->args[0]].type : HDW_IR_ANY;
+	uint8_t b = (instr->args_count > 1 && instr->op != HDW_IR_PHI) ? fn->instrs[instr->args[1]].type : HDW_IR_ANY;
+	
+	switch (instr->op) {
+		case HDW_IR_CONST:
+		case HDW_IR_COPY:
+		case HDW_IR_PHI:
+		case HDW_IR_NOT:
+		case HDW_IR_EQ:
+		case HDW_IR_NOTEQ: {
+			return true;
+		}
+		case HDW_IR_NEG: {
+			return hdw_irNumeric(a);
+		}
+		case HDW_IR_ADD:
+		case HDW_IR_SUB:
+		case HDW_IR_MUL:
+		case HDW_IR_LT:
+		case HDW_IR_GT:
+		case HDW_IR_LTEQ:
+		case HDW_IR_GTEQ: {
+			return hdw_irNumeric(a) && hdw_irNumeric(b);
+		}
+		case HDW_IR_DIV: {
+			// Integer division by zero or -1 can trap
+			if (a == HDW_TYPE_INTEGER && b == HDW_TYPE_INTEGER) {
+				const hdw_irinstr *divisor = &fn->instrs[instr->args[1]];
+				
+				return divisor->op == HDW_IR_CONST && divisor->constant.as_integer != 0 && divisor->constant.as_integer != -1;
+			}
+			
+			return hdw_irNumeric(a) && hdw_irNumeric(b);
+		}
+		default: {
+			return false;
+		}
+	}
+}
+
+// -----------------------------------------------------------------------------
+// Optimisation Passes
+// -----------------------------------------------------------------------------
+
+static uint32_t hdw_irResolve(const hdw_irfunction *fn, uint32_t value) {
+	/**
+	 * Follow a chain of copies to the value at the end of it.
+	 */
+	
+	while (fn->instrs[value].op == HDW_IR_COPY) {
+		value = fn->instrs[value].args[0];
+	}
+	
+	return value;
+}
+
+static void hdw_irCopyPropagation(hdw_irfunction *fn) {
+	/**
+	 * Make everything that uses a copy use the copied value instead, and
+	 * remove the copies. Phis that become trivial once their arguments are
+	 * resolved become copies themselves, so this runs until nothing changes.
+	 */
+	
+	bool changed = true;
+	
+	while (changed) {
+		changed = false;
+		
+		for (uint32_t i = 0; i < fn->block_count; i++) {
+			hdw_irblock *b = &fn->blocks[i];
+			
+			for (uint32_t j = 0; j < b->count; j++) {
+				uint32_t id = b->code[j];
+				hdw_irinstr *instr = &fn->instrs[id];
+				uint32_t *args = hdw_irArgs(instr);
+				
+				if (instr->op == HDW_IR_COPY) {
+					continue;
+				}
+				
+				for (uint32_t k = 0; k < instr->args_count; k++) {
+					args[k] = hdw_irResolve(fn, args[k]);
+				}
+				
+				if (instr->op == HDW_IR_PHI) {
+					hdw_irRemoveTrivialPhi(fn, id);
+					changed = changed || (instr->op != HDW_IR_PHI);
+				}
+			}
+		}
+	}
+	
+	for (uint32_t i = 0; i < fn->block_count; i++) {
+		hdw_irblock *b = &fn->blocks[i];
+		
+		for (uint32_t j = 0; j < b->count; j++) {
+			if (fn->instrs[b->code[j]].op == HDW_IR_COPY) {
+				fn->instrs[b->code[j]].dead = true;
+			}
+		}
+	}
+	
+	hdw_irRemoveDead(fn);
+}
+
+static uint64_t hdw_irHash(const hdw_irinstr *instr) {
+	uint64_t hash = 0xcbf29ce484222325 ^ instr->op;
+	const uint32_t *args = (instr->op == HDW_IR_PHI) ? instr->phi_args : instr->args;
+	
+	for (uint32_t i = 0; i < instr->args_count; i++) {
+		hash = (hash ^ args[i]) * 0x100000001b3;
+	}
+	
+	if (instr->op == HDW_IR_PHI) {
+		hash = (hash ^ instr->block) * 0x100000001b3;
+	}
+	
+	if (instr->op == HDW_IR_CONST) {
+		hash = (hash ^ instr->constant.type) * 0x100000001b3;
+		
+		if (instr->constant.type == HDW_TYPE_STRING) {
+			hash = (hash ^ instr->constant.as_string->hash) * 0x100000001b3;
+		}
+		else if (instr->constant.type == HDW_TYPE_BOOLEAN) {
+			hash = (hash ^ instr->constant.as_boolean) * 0x100000001b3;
+		}
+		else if (instr->constant.type != HDW_TYPE_NULL) {
+			hash = (hash ^ (uint64_t) instr->constant.as_integer) * 0x100000001b3;
+		}
+	}
+	
+	return hash;
+}
+
+static bool hdw_irSame(const hdw_irinstr *a, const hdw_irinstr *b) {
+	/**
+	 * Check if two instructions always compute the same value.
+	 */
+	
+	if (a->op != b->op || a->args_count != b->args_count) {
+		return false;
+	}
+	
+	if (a->op == HDW_IR_PHI) {
+		return a->block == b->block && !memcmp(a->phi_args, b->phi_args, sizeof *a->phi_args * a->args_count);
+	}
+	
+	for (uint32_t i = 0; i < a->args_count; i++) {
+		if (a->args[i] != b->args[i]) {
+			return false;
+		}
+	}
+	
+	if (a->op != HDW_IR_CONST) {
+		return true;
+	}
+	
+	if (a->constant.type != b->constant.type) {
+		return false;
+	}
+	
+	switch (a->constant.type) {
+		case HDW_TYPE_NULL: return true;
+		case HDW_TYPE_BOOLEAN: return a->constant.as_boolean == b->constant.as_boolean;
+		case HDW_TYPE_STRING: return hdw_stringequal(a->constant.as_string, b->constant.as_string);
+		default: return a->constant.as_integer == b->constant.as_integer;
+	}
+}
+
+static void hdw_irValueNumbering(hdw_irfunction *fn) {
+	/**
+	 * Global value numbering: an instruction that computes the same thing as
+	 * one in a dominating block (or earlier in the same block) is replaced by
+	 * a copy of it. Blocks are visited in reverse postorder, so the dominating
+	 * instruction has always been seen first. Arguments of commutative
+	 * instructions are put in a fixed order first so that a + b and b + a
+	 * match.
+	 */
+	
+	if (!hdw_irComputeDominators(fn) || !hdw_irInferTypes(fn)) {
+		return;
+	}
+	
+	size_t size = 16;
+	
+	while (size < (size_t) fn->count * 2) {
+		size *= 2;
+	}
+	
+	uint32_t *table = hdw_malloc(sizeof *table * size);
+	
+	if (!table) {
+		fn->error = "Out of memory";
+		return;
+	}
+	
+	for (size_t i = 0; i < size; i++) {
+		table[i] = HDW_IR_NONE;
+	}
+	
+	for (uint32_t i = 0; i < fn->order_count; i++) {
+		hdw_irblock *b = &fn->blocks[fn->order[i]];
+		
+		for (uint32_t j = 0; j < b->count; j++) {
+			uint32_t id = b->code[j];
+			hdw_irinstr *instr = &fn->instrs[id];
+			
+			if (!hdw_irPure(fn, instr) || instr->op == HDW_IR_COPY) {
+				continue;
+			}
+			
+			uint32_t *args = hdw_irArgs(instr);
+			
+			for (uint32_t k = 0; k < instr->args_count; k++) {
+				args[k] = hdw_irResolve(fn, args[k]);
+			}
+			
+			bool commutative = instr->op == HDW_IR_ADD || instr->op == HDW_IR_MUL || instr->op == HDW_IR_EQ || instr->op == HDW_IR_NOTEQ;
+			
+			if (commutative && instr->args[0] > instr->args[1]) {
+				uint32_t t = instr->args[0];
+				instr->args[0] = instr->args[1];
+				instr->args[1] = t;
+			}
+			
+			size_t slot = hdw_irHash(instr) & (size_t) (size - 1);
+			bool replaced = false;
+			
+			// The table keeps every instruction, since one that doesn't
+			// dominate this block might dominate a later one
+			while (table[slot] != HDW_IR_NONE) {
+				hdw_irinstr *other = &fn->instrs[table[slot]];
+				
+				if (hdw_irSame(instr, other) && hdw_irDominates(fn, other->block, instr->block)) {
+					free(instr->phi_args);
+					instr->phi_args = NULL;
+					instr->op = HDW_IR_COPY;
+					instr->args[0] = table[slot];
+					instr->args_count = 1;
+					replaced = true;
+					break;
+				}
+				
+				slot = (slot + 1) & (size - 1);
+			}
+			
+			if (!replaced) {
+				table[slot] = id;
+			}
+		}
+	}
+	
+	free(table);
+}
+
+static void hdw_irLoopInvariantCodeMotion(hdw_irfunction *fn) {
+	/**
+	 * Move instructions whose arguments don't change in a loop out to the
+	 * block before it. Loops are found from their back edges, which are the
+	 * edges to a block that dominates where they come from. Only pure
+	 * instructions move, since they would otherwise run even when the loop
+	 * runs zero times, and only when the loop is entered from a single block
+	 * that does nothing but jump to it. Inner loops are done first, so that
+	 * what they hoist can be hoisted again by the loop around them.
+	 */
+	
+	if (!hdw_irComputeDominators(fn) || !hdw_irInferTypes(fn)) {
+		return;
+	}
+	
+	bool *in_loop = hdw_malloc(sizeof *in_loop * fn->block_count);
+	uint32_t *stack = hdw_malloc(sizeof *stack * fn->block_count);
+	
+	if (!in_loop || !stack) {
+		free(in_loop);
+		free(stack);
+		fn->error = "Out of memory";
+		return;
+	}
+	
+	// Later headers in reverse postorder are nested deeper or come after,
+	// so going backwards sees inner loops first
+	for (uint32_t h = fn->order_count; h-- > 0;) {
+		uint32_t header = fn->order[h];
+		uint32_t depth = 0;
+		
+		memset(in_loop, 0, sizeof *in_loop * fn->block_count);
+		in_loop[header] = true;
+		
+		for (uint32_t i = 0; i < fn->blocks[header].preds_count; i++) {
+			uint32_t pred = fn->blocks[header].preds[i];
+			
+			if (fn->blocks[pred].idom != HDW_IR_NONE && hdw_irDominates(fn, header, pred) && !in_loop[pred]) {
+				in_loop[pred] = true;
+				stack[depth++] = pred;
+			}
+		}
+		
+		if (!depth) {
+			continue;
+		}
+		
+		// Everything that reaches a back edge without going through the
+		// header is in the loop
+		while (depth) {
+			uint32_t block = stack[--depth];
+			
+			for (uint32_t i = 0; i < fn->blocks[block].preds_count; i++) {
+				uint32_t pred = fn->blocks[block].preds[i];
+				
+				if (!in_loop[pred] && fn->blocks[pred].idom != HDW_IR_NONE) {
+					in_loop[pred] = true;
+					stack[depth++] = pred;
+				}
+			}
+		}
+		
+		uint32_t preheader = HDW_IR_NONE;
+		
+		for (uint32_t i = 0; i < fn->blocks[header].preds_count; i++) {
+			uint32_t pred = fn->blocks[header].preds[i];
+			
+			if (!in_loop[pred]) {
+				preheader = (preheader == HDW_IR_NONE) ? pred : HDW_IR_NONE - 1;
+			}
+		}
+		
+		if (preheader >= HDW_IR_NONE - 1 || fn->blocks[preheader].succs_count != 1) {
+			continue;
+		}
+		
+		bool changed = true;
+		
+		while (changed) {
+			changed = false;
+			
+			for (uint32_t i = 0; i < fn->order_count; i++) {
+				uint32_t block = fn->order[i];
+				
+				if (!in_loop[block]) {
+					continue;
+				}
+				
+				for (uint32_t j = 0; j < fn->blocks[block].count; j++) {
+					uint32_t id = fn->blocks[block].code[j];
+					hdw_irinstr *instr = &fn->instrs[id];
+					
+					if (instr->op == HDW_IR_PHI || instr->op == HDW_IR_COPY || !hdw_irPure(fn, instr)) {
+						continue;
+					}
+					
+					bool invariant = true;
+					
+					for (uint32_t k = 0; k < instr->args_count; k++) {
+						invariant = invariant && !in_loop[fn->instrs[instr->args[k]].block];
+					}
+					
+					if (!invariant) {
+						continue;
+					}
+					
+					// Take it out of the loop and put it before the jump
+					// into it
+					hdw_irblock *b = &fn->blocks[block];
+					
+					memmove(&b->code[j], &b->code[j + 1], sizeof *b->code * (b->count - j - 1));
+					b->count--;
+					j--;
+					
+					if (!hdw_irInsert(fn, preheader, fn->blocks[preheader].count - 1, id)) {
+						free(in_loop);
+						free(stack);
+						return;
+					}
+					
+					changed = true;
+				}
+			}
+		}
+	}
+	
+	free(in_loop);
+	free(stack);
+}
+
+static void hdw_irDeadCodeElimination(hdw_irfunction *fn) {
+	/**
+	 * Remove instructions whose results are never used. Everything that isn't
+	 * pure is kept, and so is everything it uses, and so on.
+	 */
+	
+	if (!hdw_irInferTypes(fn)) {
+		return;
+	}
+	
+	bool *live = hdw_calloc(fn->count, sizeof *live);
+	uint32_t *work = hdw_malloc(sizeof *work * (fn->count + 1));
+	uint32_t count = 0;
+	
+	if (!live || !work) {
+		free(live);
+		free(work);
+		fn->error = "Out of memory";
+		return;
+	}
+	
+	for (uint32_t i = 0; i < fn->block_count; i++) {
+		hdw_irblock *b = &fn->blocks[i];
+		
+		for (uint32_t j = 0; j < b->count; j++) {
+			if (!hdw_irPure(fn, &fn->instrs[b->code[j]])) {
+				live[b->code[j]] = true;
+				work[count++] = b->code[j];
+			}
+		}
+	}
+	
+	while (count) {
+		hdw_irinstr *instr = &fn->instrs[work[--count]];
+		uint32_t *args = hdw_irArgs(instr);
+		
+		for (uint32_t k = 0; k < instr->args_count; k++) {
+			if (!live[args[k]]) {
+				live[args[k]] = true;
+				work[count++] = args[k];
+			}
+		}
+	}
+	
+	for (uint32_t i = 0; i < fn->block_count; i++) {
+		hdw_irblock *b = &fn->blocks[i];
+		
+		for (uint32_t j = 0; j < b->count; j++) {
+			fn->instrs[b->code[j]].dead = !live[b->code[j]];
+		}
+	}
+	
+	hdw_irRemoveDead(fn);
+	
+	free(live);
+	free(work);
+}
+
+// -----------------------------------------------------------------------------
+// Printing
+// -----------------------------------------------------------------------------
+
+static void hdw_irPrintConstant(hdw_value value) {
+	switch (value.type) {
+		case HDW_TYPE_NULL: printf("null"); break;
+		case HDW_TYPE_BOOLEAN: printf(value.as_boolean ? "true" : "false"); break;
+		case HDW_TYPE_NUMBER: printf("%g", value.as_number); break;
+		case HDW_TYPE_INTEGER: printf("%" PRId64, value.as_integer); break;
+		case HDW_TYPE_STRING: printf("'%s'", value.as_string->data); break;
+	}
+}
+
+static void hdw_irPrint(const hdw_irfunction *fn, const char * const title) {
+	/**
+	 * Print the blocks of a function and the instructions in them.
+	 */
+	
+	printf("== %s (%zu instructions) ==\n", title, hdw_irSize(fn));
+	
+	for (uint32_t i = 0; i < fn->block_count; i++) {
+		const hdw_irblock *b = &fn->blocks[i];
+		
+		if (!b->count) {
+			continue;
+		}
+		
+		printf("b%u:", i);
+		
+		if (b->preds_count) {
+			printf(" ; from");
+			
+			for (uint32_t j = 0; j < b->preds_count; j++) {
+				printf(" b%u", b->preds[j]);
+			}
+		}
+		
+		printf("\n");
+		
+		for (uint32_t j = 0; j < b->count; j++) {
+			uint32_t id = b->code[j];
+			const hdw_irinstr *instr = &fn->instrs[id];
+			const uint32_t *args = (instr->op == HDW_IR_PHI) ? instr->phi_args : instr->args;
+			
+			printf("\t");
+			
+			if (!hdw_irIsTerminator(instr->op)) {
+				printf("v%u = ", id);
+			}
+			
+			printf("%s", hdw_irNames[instr->op]);
+			
+			if (instr->op == HDW_IR_CONST) {
+				printf(" ");
+				hdw_irPrintConstant(instr->constant);
+			}
+			
+			for (uint32_t k = 0; k < instr->args_count; k++) {
+				printf(" v%u", args[k]);
+			}
+			
+			if (instr->op == HDW_IR_JUMP || instr->op == HDW_IR_BRANCH) {
+				for (uint32_t k = 0; k < b->succs_count; k++) {
+					printf(" b%u", b->succs[k]);
+				}
+			}
+			
+			printf("\n");
+		}
+	}
+}
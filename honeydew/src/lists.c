@@ -0,0 +1,563 @@
+// =============================================================================
+// Lists
+// =============================================================================
+
+// A list of only integers or only numbers keeps them packed in a plain array,
+// and the builtins run over that with AVX2 when the processor has it. Adding
+// anything else boxes the list, after which the builtins go through the same
+// value functions as the interpreter.
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HDW_LIST_AVX2
+#define HDW_AVX2 __attribute__((target("avx2")))
+#endif
+
+#define HDW_LIST_MIN_ALLOC 16
+
+static bool hdw_listBox(hdw_list *list) {
+	/**
+	 * Turn a packed list into an array of values. Values are twice the size of
+	 * what they are made from, so this works from the end backwards.
+	 */
+	
+	size_t alloc = list->alloc ? list->alloc : HDW_LIST_MIN_ALLOC;
+	hdw_value *values = hdw_realloc(list->as_values, sizeof *values * alloc);
+	
+	if (!values) {
+		return false;
+	}
+	
+	for (size_t i = list->count; i-- > 0;) {
+		if (list->type == HDW_TYPE_INTEGER) {
+			int64_t integer = ((int64_t *) values)[i];
+			values[i] = hdw_newValue(HDW_TYPE_INTEGER, integer);
+		}
+		else {
+			double number = ((double *) values)[i];
+			values[i] = hdw_newNumberValue(number);
+		}
+	}
+	
+	list->as_values = values;
+	list->alloc = alloc;
+	list->type = HDW_LIST_BOXED;
+	
+	return true;
+}
+
+bool hdw_listpush(hdw_list * const restrict list, hdw_value value) {
+	/**
+	 * Add a value to the end of a list, boxing the list first if the value is
+	 * not what it is packed with.
+	 */
+	
+	if (list->count == 0 && list->type != HDW_LIST_BOXED) {
+		list->type = (value.type == HDW_TYPE_INTEGER || value.type == HDW_TYPE_NUMBER) ? value.type : HDW_LIST_BOXED;
+	}
+	else if (list->type != HDW_LIST_BOXED && value.type != list->type && !hdw_listBox(list)) {
+		return false;
+	}
+	
+	if (list->count == list->alloc) {
+		size_t alloc = list->alloc ? list->alloc * 2 : HDW_LIST_MIN_ALLOC;
+		size_t size = (list->type == HDW_LIST_BOXED) ? sizeof (hdw_value) : sizeof (int64_t);
+		void *data = hdw_realloc(list->as_values, size * alloc);
+		
+		if (!data) {
+			return false;
+		}
+		
+		list->as_values = data;
+		list->alloc = alloc;
+	}
+	
+	switch (list->type) {
+		case HDW_TYPE_INTEGER: list->as_integers[list->count++] = value.as_integer; break;
+		case HDW_TYPE_NUMBER: list->as_numbers[list->count++] = value.as_number; break;
+		default: list->as_values[list->count++] = value; break;
+	}
+	
+	return true;
+}
+
+hdw_value hdw_listget(const hdw_list * const restrict list, size_t index) {
+	if (index >= list->count) {
+		return hdw_nullValue();
+	}
+	
+	switch (list->type) {
+		case HDW_TYPE_INTEGER: return hdw_newValue(HDW_TYPE_INTEGER, list->as_integers[index]);
+		case HDW_TYPE_NUMBER: return hdw_newNumberValue(list->as_numbers[index]);
+		default: return list->as_values[index];
+	}
+}
+
+void hdw_listfree(hdw_list * const restrict list) {
+	free(list->as_values);
+	
+	*list = (hdw_list) {0};
+}
+
+#ifdef HDW_LIST_AVX2
+
+// Each kernel takes eight elements at a time in two vectors, then finishes the
+// last few one by one.
+
+HDW_AVX2 static size_t hdw_listFindIntegerAvx2(const int64_t *data, size_t count, int64_t what) {
+	__m256i needle = _mm256_set1_epi64x(what);
+	size_t i = 0;
+	
+	for (; i + 8 <= count; i += 8) {
+		__m256i a = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *) (data + i)), needle);
+		__m256i b = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *) (data + i + 4)), needle);
+		int mask = _mm256_movemask_pd(_mm256_castsi256_pd(a)) | _mm256_movemask_pd(_mm256_castsi256_pd(b)) << 4;
+		
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	
+	for (; i < count && data[i] != what; i++);
+	
+	return i;
+}
+
+HDW_AVX2 static size_t hdw_listFindNumberAvx2(const double *data, size_t count, double what) {
+	__m256d needle = _mm256_set1_pd(what);
+	size_t i = 0;
+	
+	for (; i + 8 <= count; i += 8) {
+		__m256d a = _mm256_cmp_pd(_mm256_loadu_pd(data + i), needle, _CMP_EQ_OQ);
+		__m256d b = _mm256_cmp_pd(_mm256_loadu_pd(data + i + 4), needle, _CMP_EQ_OQ);
+		int mask = _mm256_movemask_pd(a) | _mm256_movemask_pd(b) << 4;
+		
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	
+	for (; i < count && data[i] != what; i++);
+	
+	return i;
+}
+
+HDW_AVX2 static size_t hdw_listCountIntegerAvx2(const int64_t *data, size_t count, int64_t what) {
+	/**
+	 * Matches compare to all ones, which is -1, so subtracting them counts.
+	 */
+	
+	__m256i needle = _mm256_set1_epi64x(what);
+	__m256i a = _mm256_setzero_si256();
+	__m256i b = _mm256_setzero_si256();
+	size_t i = 0;
+	
+	for (; i + 8 <= count; i += 8) {
+		a = _mm256_sub_epi64(a, _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *) (data + i)), needle));
+		b = _mm256_sub_epi64(b, _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *) (data + i + 4)), needle));
+	}
+	
+	int64_t lanes[4];
+	_mm256_storeu_si256((__m256i *) lanes, _mm256_add_epi64(a, b));
+	size_t found = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	
+	for (; i < count; i++) {
+		found += data[i] == what;
+	}
+	
+	return found;
+}
+
+HDW_AVX2 static size_t hdw_listCountNumberAvx2(const double *data, size_t count, double what) {
+	__m256d needle = _mm256_set1_pd(what);
+	__m256i a = _mm256_setzero_si256();
+	__m256i b = _mm256_setzero_si256();
+	size_t i = 0;
+	
+	for (; i + 8 <= count; i += 8) {
+		a = _mm256_sub_epi64(a, _mm256_castpd_si256(_mm256_cmp_pd(_mm256_loadu_pd(data + i), needle, _CMP_EQ_OQ)));
+		b = _mm256_sub_epi64(b, _mm256_castpd_si256(_mm256_cmp_pd(_mm256_loadu_pd(data + i + 4), needle, _CMP_EQ_OQ)));
+	}
+	
+	int64_t lanes[4];
+	_mm256_storeu_si256((__m256i *) lanes, _mm256_add_epi64(a, b));
+	size_t found = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	
+	for (; i < count; i++) {
+		found += data[i] == what;
+	}
+	
+	return found;
+}
+
+HDW_AVX2 static int64_t hdw_listSumIntegerAvx2(const int64_t *data, size_t count) {
+	__m256i a = _mm256_setzero_si256();
+	__m256i b = _mm256_setzero_si256();
+	size_t i = 0;
+	
+	for (; i + 8 <= count; i += 8) {
+		a = _mm256_add_epi64(a, _mm256_loadu_si256((const __m256i *) (data + i)));
+		b = _mm256_add_epi64(b, _mm256_loadu_si256((const __m256i *) (data + i + 4)));
+	}
+	
+	uint64_t lanes[4];
+	_mm256_storeu_si256((__m256i *) lanes, _mm256_add_epi64(a, b));
+	uint64_t sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	
+	for (; i < count; i++) {
+		sum += (uint64_t) data[i];
+	}
+	
+	return (int64_t) sum;
+}
+
+HDW_AVX2 static double hdw_listSumNumberAvx2(const double *data, size_t count) {
+	__m256d a = _mm256_setzero_pd();
+	__m256d b = _mm256_setzero_pd();
+	size_t i = 0;
+	
+	for (; i + 8 <= count; i += 8) {
+		a = _mm256_add_pd(a, _mm256_loadu_pd(data + i));
+		b = _mm256_add_pd(b, _mm256_loadu_pd(data + i + 4));
+	}
+	
+	double lanes[4];
+	_mm256_storeu_pd(lanes, _mm256_add_pd(a, b));
+	double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	
+	for (; i < count; i++) {
+		sum += data[i];
+	}
+	
+	return sum;
+}
+
+HDW_AVX2 static int64_t hdw_listLeastIntegerAvx2(const int64_t *data, size_t count, bool most) {
+	/**
+	 * The smallest integer in a list, or the largest if most is set. AVX2 has
+	 * no 64-bit min or max, so this compares and blends instead.
+	 */
+	
+	__m256i best = _mm256_set1_epi64x(data[0]);
+	size_t i = 0;
+	
+	for (; i + 4 <= count; i += 4) {
+		__m256i next = _mm256_loadu_si256((const __m256i *) (data + i));
+		__m256i take = most ? _mm256_cmpgt_epi64(next, best) : _mm256_cmpgt_epi64(best, next);
+		best = _mm256_blendv_epi8(best, next, take);
+	}
+	
+	int64_t lanes[4];
+	_mm256_storeu_si256((__m256i *) lanes, best);
+	int64_t result = lanes[0];
+	
+	for (size_t j = 1; j < 4; j++) {
+		result = (most ? lanes[j] > result : lanes[j] < result) ? lanes[j] : result;
+	}
+	
+	for (; i < count; i++) {
+		result = (most ? data[i] > result : data[i] < result) ? data[i] : result;
+	}
+	
+	return result;
+}
+
+HDW_AVX2 static double hdw_listLeastNumberAvx2(const double *data, size_t count, bool most) {
+	__m256d best = _mm256_set1_pd(data[0]);
+	size_t i = 0;
+	
+	for (; i + 4 <= count; i += 4) {
+		__m256d next = _mm256_loadu_pd(data + i);
+		best = most ? _mm256_max_pd(next, best) : _mm256_min_pd(next, best);
+	}
+	
+	double lanes[4];
+	_mm256_storeu_pd(lanes, best);
+	double result = lanes[0];
+	
+	for (size_t j = 1; j < 4; j++) {
+		result = (most ? lanes[j] > result : lanes[j] < result) ? lanes[j] : result;
+	}
+	
+	for (; i < count; i++) {
+		result = (most ? data[i] > result : data[i] < result) ? data[i] : result;
+	}
+	
+	return result;
+}
+
+#endif
+
+static bool hdw_listUseAvx2(void) {
+#ifdef HDW_LIST_AVX2
+	return __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
+}
+
+static size_t hdw_listFindInteger(const int64_t *data, size_t count, int64_t what) {
+#ifdef HDW_LIST_AVX2
+	if (hdw_listUseAvx2()) {
+		return hdw_listFindIntegerAvx2(data, count, what);
+	}
+#endif
+
+	size_t i = 0;
+	
+	for (; i < count && data[i] != what; i++);
+	
+	return i;
+}
+
+static size_t hdw_listFindNumber(const double *data, size_t count, double what) {
+#ifdef HDW_LIST_AVX2
+	if (hdw_listUseAvx2()) {
+		return hdw_listFindNumberAvx2(data, count, what);
+	}
+#endif
+
+	size_t i = 0;
+	
+	for (; i < count && data[i] != what; i++);
+	
+	return i;
+}
+
+static size_t hdw_listCountInteger(const int64_t *data, size_t count, int64_t what) {
+#ifdef HDW_LIST_AVX2
+	if (hdw_listUseAvx2()) {
+		return hdw_listCountIntegerAvx2(data, count, what);
+	}
+#endif
+
+	size_t found = 0;
+	
+	for (size_t i = 0; i < count; i++) {
+		found += data[i] == what;
+	}
+	
+	return found;
+}
+
+static size_t hdw_listCountNumber(const double *data, size_t count, double what) {
+#ifdef HDW_LIST_AVX2
+	if (hdw_listUseAvx2()) {
+		return hdw_listCountNumberAvx2(data, count, what);
+	}
+#endif
+
+	size_t found = 0;
+	
+	for (size_t i = 0; i < count; i++) {
+		found += data[i] == what;
+	}
+	
+	return found;
+}
+
+static int64_t hdw_listSumInteger(const int64_t *data, size_t count) {
+#ifdef HDW_LIST_AVX2
+	if (hdw_listUseAvx2()) {
+		return hdw_listSumIntegerAvx2(data, count);
+	}
+#endif
+
+	uint64_t sum = 0;
+	
+	for (size_t i = 0; i < count; i++) {
+		sum += (uint64_t) data[i];
+	}
+	
+	return (int64_t) sum;
+}
+
+static double hdw_listSumNumber(const double *data, size_t count) {
+#ifdef HDW_LIST_AVX2
+	if (hdw_listUseAvx2()) {
+		return hdw_listSumNumberAvx2(data, count);
+	}
+#endif
+
+	double sum = 0.0;
+	
+	for (size_t i = 0; i < count; i++) {
+		sum += data[i];
+	}
+	
+	return sum;
+}
+
+static int64_t hdw_listLeastInteger(const int64_t *data, size_t count, bool most) {
+#ifdef HDW_LIST_AVX2
+	if (hdw_listUseAvx2()) {
+		return hdw_listLeastIntegerAvx2(data, count, most);
+	}
+#endif
+
+	int64_t best = data[0];
+	
+	for (size_t i = 1; i < count; i++) {
+		best = (most ? data[i] > best : data[i] < best) ? data[i] : best;
+	}
+	
+	return best;
+}
+
+static double hdw_listLeastNumber(const double *data, size_t count, bool most) {
+#ifdef HDW_LIST_AVX2
+	if (hdw_listUseAvx2()) {
+		return hdw_listLeastNumberAvx2(data, count, most);
+	}
+#endif
+
+	double best = data[0];
+	
+	for (size_t i = 1; i < count; i++) {
+		best = (most ? data[i] > best : data[i] < best) ? data[i] : best;
+	}
+	
+	return best;
+}
+
+int64_t hdw_listindexof(const hdw_list * const restrict list, hdw_value what) {
+	/**
+	 * Find the index of the first element equal to what, or -1 if there is
+	 * none. Integers and numbers are equal when their values are, like ==.
+	 */
+	
+	size_t i = list->count;
+	
+	if (list->type == HDW_TYPE_INTEGER && what.type == HDW_TYPE_INTEGER) {
+		i = hdw_listFindInteger(list->as_integers, list->count, what.as_integer);
+	}
+	else if (list->type == HDW_TYPE_INTEGER && what.type == HDW_TYPE_NUMBER) {
+		for (i = 0; i < list->count && (double) list->as_integers[i] != what.as_number; i++);
+	}
+	else if (list->type == HDW_TYPE_NUMBER && (what.type == HDW_TYPE_NUMBER || what.type == HDW_TYPE_INTEGER)) {
+		i = hdw_listFindNumber(list->as_numbers, list->count, (what.type == HDW_TYPE_NUMBER) ? what.as_number : (double) what.as_integer);
+	}
+	else if (list->type == HDW_LIST_BOXED) {
+		hdw_interpreter interpreter = {0};
+		
+		for (i = 0; i < list->count && !hdw_valueEqual(&interpreter, list->as_values[i], what).as_boolean; i++);
+	}
+	
+	return (i < list->count) ? (int64_t) i : -1;
+}
+
+bool hdw_listcontains(const hdw_list * const restrict list, hdw_value what) {
+	return hdw_listindexof(list, what) >= 0;
+}
+
+hdw_value hdw_listfind(const hdw_list * const restrict list, hdw_value what) {
+	/**
+	 * Get the first element equal to what, or null if there is none.
+	 */
+	
+	int64_t index = hdw_listindexof(list, what);
+	
+	return (index >= 0) ? hdw_listget(list, index) : hdw_nullValue();
+}
+
+size_t hdw_listcount(const hdw_list * const restrict list, hdw_value what) {
+	/**
+	 * Count the elements equal to what.
+	 */
+	
+	size_t found = 0;
+	
+	if (list->type == HDW_TYPE_INTEGER && what.type == HDW_TYPE_INTEGER) {
+		found = hdw_listCountInteger(list->as_integers, list->count, what.as_integer);
+	}
+	else if (list->type == HDW_TYPE_INTEGER && what.type == HDW_TYPE_NUMBER) {
+		for (size_t i = 0; i < list->count; i++) {
+			found += (double) list->as_integers[i] == what.as_number;
+		}
+	}
+	else if (list->type == HDW_TYPE_NUMBER && (what.type == HDW_TYPE_NUMBER || what.type == HDW_TYPE_INTEGER)) {
+		found = hdw_listCountNumber(list->as_numbers, list->count, (what.type == HDW_TYPE_NUMBER) ? what.as_number : (double) what.as_integer);
+	}
+	else if (list->type == HDW_LIST_BOXED) {
+		hdw_interpreter interpreter = {0};
+		
+		for (size_t i = 0; i < list->count; i++) {
+			found += hdw_valueEqual(&interpreter, list->as_values[i], what).as_boolean;
+		}
+	}
+	
+	return found;
+}
+
+int32_t hdw_listsum(const hdw_list * const restrict list, hdw_value * const restrict result) {
+	/**
+	 * Add up the elements of a list, which is the integer 0 when it is empty.
+	 * Packed numbers are added in several lanes at once, so the rounding of
+	 * the total can differ slightly from adding them in order.
+	 */
+	
+	if (list->type == HDW_TYPE_INTEGER) {
+		*result = hdw_newValue(HDW_TYPE_INTEGER, hdw_listSumInteger(list->as_integers, list->count));
+		return 0;
+	}
+	
+	if (list->type == HDW_TYPE_NUMBER) {
+		*result = hdw_newNumberValue(hdw_listSumNumber(list->as_numbers, list->count));
+		return 0;
+	}
+	
+	hdw_interpreter interpreter = {0};
+	
+	*result = hdw_newValue(HDW_TYPE_INTEGER, 0);
+	
+	for (size_t i = 0; i < list->count && !interpreter.errors; i++) {
+		*result = hdw_valueAdd(&interpreter, *result, list->as_values[i]);
+	}
+	
+	return interpreter.errors ? HDW_ERR_INTERPRETER : 0;
+}
+
+static int32_t hdw_listLeast(const hdw_list * const restrict list, hdw_value * const restrict result, bool most) {
+	/**
+	 * Find the smallest element of a list, or the largest if most is set. An
+	 * empty list gives null.
+	 */
+	
+	if (list->count == 0) {
+		*result = hdw_nullValue();
+		return 0;
+	}
+	
+	if (list->type == HDW_TYPE_INTEGER) {
+		*result = hdw_newValue(HDW_TYPE_INTEGER, hdw_listLeastInteger(list->as_integers, list->count, most));
+		return 0;
+	}
+	
+	if (list->type == HDW_TYPE_NUMBER) {
+		*result = hdw_newNumberValue(hdw_listLeastNumber(list->as_numbers, list->count, most));
+		return 0;
+	}
+	
+	hdw_interpreter interpreter = {0};
+	
+	*result = list->as_values[0];
+	
+	for (size_t i = 1; i < list->count && !interpreter.errors; i++) {
+		hdw_value next = list->as_values[i];
+		hdw_value better = most ? hdw_valueGT(&interpreter, next, *result) : hdw_valueLT(&interpreter, next, *result);
+		
+		if (better.as_boolean) {
+			*result = next;
+		}
+	}
+	
+	return interpreter.errors ? HDW_ERR_INTERPRETER : 0;
+}
+
+int32_t hdw_listmin(const hdw_list * const restrict list, hdw_value * const restrict result) {
+	return hdw_listLeast(list, result, false);
+}
+
+int32_t hdw_listmax(const hdw_list * const restrict list, hdw_value * const restrict result) {
+	return hdw_listLeast(list, result, true);
+}
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 
 #include "hdw.h"
 
@@ -7,6 +8,9 @@ int main(int argc, char *argv[]) {
 		printf("Usage: %s [input file]\n", argv[0]);
 		return 1;
 	}
+	else if (argc == 2 && !strcmp(argv[1], "--bench")) {
+		hdw_benchmark();
+	}
 	else if (argc == 2) {
 		int status = hdw_dofile(argv[1]);
 		return status;
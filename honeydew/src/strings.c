@@ -0,0 +1,181 @@
+// =============================================================================
+// Strings
+// =============================================================================
+
+// Strings carry their length and hash, and short ones are stored inside the
+// string object so they only take one allocation. String literals are
+// interned, so equal literals are the same object and compare by pointer.
+
+#define HDW_STRING_MIN_BUCKETS 64
+
+static struct {
+	hdw_string **buckets;
+	uint32_t capacity;
+	uint32_t count;
+} hdw_strings;
+
+static uint32_t hdw_stringHash(const char * const src, size_t length) {
+	/**
+	 * 32-bit FNV-1a hash of the bytes of a string.
+	 */
+	
+	uint32_t hash = 0x811c9dc5;
+	
+	for (size_t i = 0; i < length; i++) {
+		hash = (hash ^ (uint8_t) src[i]) * 0x01000193;
+	}
+	
+	return hash;
+}
+
+static hdw_string *hdw_stringNew(const char * const src, size_t length, uint32_t hash) {
+	/**
+	 * Make a string object holding a copy of length bytes of src.
+	 */
+	
+	hdw_string *string = hdw_malloc(sizeof *string);
+	
+	if (!string) {
+		return NULL;
+	}
+	
+	string->data = string->small;
+	string->length = length;
+	string->hash = hash;
+	string->next = NULL;
+	
+	if (length > HDW_STRING_SMALL) {
+		string->data = hdw_malloc(length + 1);
+		
+		if (!string->data) {
+			free(string);
+			return NULL;
+		}
+	}
+	
+	memcpy(string->data, src, length);
+	string->data[length] = '\0';
+	
+	return string;
+}
+
+static void hdw_stringFree(hdw_string *string) {
+	if (string->data != string->small) {
+		free(string->data);
+	}
+	
+	free(string);
+}
+
+static bool hdw_stringGrow(void) {
+	/**
+	 * Double the number of buckets in the intern table and rehash the strings
+	 * already in it.
+	 */
+	
+	uint32_t capacity = hdw_strings.capacity ? hdw_strings.capacity * 2 : HDW_STRING_MIN_BUCKETS;
+	hdw_string **buckets = hdw_calloc(capacity, sizeof *buckets);
+	
+	if (!buckets) {
+		return false;
+	}
+	
+	for (uint32_t i = 0; i < hdw_strings.capacity; i++) {
+		hdw_string *string = hdw_strings.buckets[i];
+		
+		while (string) {
+			hdw_string *next = string->next;
+			string->next = buckets[string->hash & (capacity - 1)];
+			buckets[string->hash & (capacity - 1)] = string;
+			string = next;
+		}
+	}
+	
+	free(hdw_strings.buckets);
+	
+	hdw_strings.buckets = buckets;
+	hdw_strings.capacity = capacity;
+	
+	return true;
+}
+
+hdw_string *hdw_stringintern(const char * const src, size_t length) {
+	/**
+	 * Get the one string object for the given text, making it if it does not
+	 * exist yet. Interned strings live until hdw_stringreset is called.
+	 * Returns NULL when out of memory, or when the text is too long for the
+	 * 32-bit length of a string.
+	 */
+	
+	if (length > UINT32_MAX) {
+		return NULL;
+	}
+	
+	uint32_t hash = hdw_stringHash(src, length);
+	
+	if (hdw_strings.capacity) {
+		hdw_string *string = hdw_strings.buckets[hash & (hdw_strings.capacity - 1)];
+		
+		for (; string; string = string->next) {
+			if (string->hash == hash && string->length == length && !memcmp(string->data, src, length)) {
+				return string;
+			}
+		}
+	}
+	
+	if (hdw_strings.count >= hdw_strings.capacity / 4 * 3 && !hdw_stringGrow()) {
+		return NULL;
+	}
+	
+	hdw_string *string = hdw_stringNew(src, length, hash);
+	
+	if (!string) {
+		return NULL;
+	}
+	
+	string->next = hdw_strings.buckets[hash & (hdw_strings.capacity - 1)];
+	hdw_strings.buckets[hash & (hdw_strings.capacity - 1)] = string;
+	hdw_strings.count++;
+	
+	return string;
+}
+
+bool hdw_stringequal(const hdw_string * const a, const hdw_string * const b) {
+	/**
+	 * Compare two strings, only looking at the bytes when the length and hash
+	 * are the same.
+	 */
+	
+	if (a == b) {
+		return true;
+	}
+	
+	if (a->length != b->length || a->hash != b->hash) {
+		return false;
+	}
+	
+	return !memcmp(a->data, b->data, a->length);
+}
+
+void hdw_stringreset(void) {
+	/**
+	 * Free every interned string. Anything still pointing at one must not be
+	 * used afterwards.
+	 */
+	
+	for (uint32_t i = 0; i < hdw_strings.capacity; i++) {
+		hdw_string *string = hdw_strings.buckets[i];
+		
+		while (string) {
+			hdw_string *next = string->next;
+			hdw_stringFree(string);
+			string = next;
+		}
+	}
+	
+	free(hdw_strings.buckets);
+	
+	hdw_strings.buckets = NULL;
+	hdw_strings.capacity = 0;
+	hdw_strings.count = 0;
+}
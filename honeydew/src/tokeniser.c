@@ -136,7 +136,7 @@ static bool hdw_matchtoken(hdw_tokeniser * const tokeniser, char what) {
 static bool hdw_stringtoken(hdw_tokeniser *tokeniser) {
 	/**
 	 * This function handles a string token, returns true if the string is not
-	 * properly terminated.
+	 * properly terminated (or there is no memory to intern it).
 	 */
 	
 	size_t start = (tokeniser->head);
@@ -153,7 +153,14 @@ static bool hdw_stringtoken(hdw_tokeniser *tokeniser) {
 	
 	size_t end = (tokeniser->head) - 1;
 	
-	hdw_addtoken(tokeniser, HDW_STRING, hdw_strndup(&tokeniser->code[start], end - start));
+	hdw_string *string = hdw_stringintern(&tokeniser->code[start], end - start);
+	
+	if (!string) {
+		return true;
+	}
+	
+	hdw_addtoken(tokeniser, HDW_STRING, NULL);
+	tokeniser->tokens->tokens[tokeniser->tokens->count - 1].string = string;
 	
 	return false;
 }
@@ -2,6 +2,25 @@
 // Utilites
 // =============================================================================
 
+// The runtime allocates through these so the benchmarks can report how many
+// times it went to the allocator as well as how long things took.
+static uint64_t hdw_allocations;
+
+static void *hdw_malloc(size_t size) {
+	hdw_allocations++;
+	return malloc(size);
+}
+
+static void *hdw_calloc(size_t count, size_t size) {
+	hdw_allocations++;
+	return calloc(count, size);
+}
+
+static void *hdw_realloc(void *block, size_t size) {
+	hdw_allocations++;
+	return realloc(block, size);
+}
+
 static char *hdw_strndup(const char * const src, size_t max) {
 	/**
 	 * Self-made implementation of the C23/POSIX function by a similar name, strndup.
@@ -13,7 +32,7 @@ static char *hdw_strndup(const char * const src, size_t max) {
 		++len;
 	}
 	
-	char *string = malloc((len + 1) * sizeof(char));
+	char *string = hdw_malloc((len + 1) * sizeof(char));
 	
 	if (!string) {
 		return NULL;
@@ -69,7 +88,7 @@ static void hdw_printValue(hdw_value *value) {
 		printf("null\n");
 	}
 	else if (value->type == HDW_TYPE_STRING) {
-		printf("'%s'\n", value->as_string);
+		printf("'%s'\n", value->as_string->data);
 	}
 	else if (value->type == HDW_TYPE_NUMBER) {
 		printf("%f\n", value->as_number);
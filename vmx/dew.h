@@ -3,6 +3,44 @@
  * ===================
  * 
  * Yet another attempt at writing a Dew VM.
+ * 
+ * Chunks can be run in two ways. An unverified chunk runs on the checked
+ * dispatch loop, which bounds-checks constant indices, jump targets, local
+ * slots and the stack on every instruction. A chunk that has passed
+ * dew_chunk_verify has had all of that proven at load time, so it runs on the
+ * unchecked loop where those checks are compiled out.
+ * 
+ * Globals are looked up by name, but each instruction that touches one has an
+ * inline cache holding the slot it found and the version of the global table
+ * at the time. As long as no global has been added since, a lookup is one
+ * compare and one load.
+ * 
+ * Generic arithmetic and comparison instructions rewrite themselves in place
+ * into type-specialised forms (add_int_int, less_num_num, ...) after seeing
+ * what they are given. The specialised forms check their operand types and
+ * rewrite themselves back to the generic form when the guess stops holding.
+ * 
+ * On x86-64 Linux a verified chunk can also be compiled to machine code by a
+ * copy-and-patch JIT. The machine code for each instruction (a stencil) is
+ * generated from C when the VM is built, see stencils.c and stencilgen.c, so
+ * compiling a chunk is just copying stencils into executable memory and
+ * filling in their operands and jump targets. Instructions without a stencil
+ * are run one at a time on the interpreter from inside the compiled code.
+ * 
+ * Without the JIT, loops can be traced instead. The interpreter counts how
+ * often each loop goes round, and once one is hot it records the path taken
+ * through one iteration as a linear trace with the types it saw. The trace is
+ * optimised and then run on a trace interpreter that keeps values unboxed in
+ * registers, until a guard fails and it exits back to the bytecode. A trace
+ * that keeps failing before it gets round the loop once is thrown away, and
+ * the loop stays on the interpreter.
+ * 
+ * To find out where a chunk spends its time, turn on profiling with
+ * dew_chunk_profile. Profiled chunks run on their own instance of the
+ * dispatch loop that counts how often each instruction runs, and optionally
+ * the cycles spent in it, and dew_chunk_dissassemble then prints those next
+ * to each instruction. Chunks that aren't being profiled never run that loop,
+ * so it costs nothing when it's off.
  */
 
 /**
@@ -18,23 +56,107 @@
 #include <inttypes.h>
 #include <stdlib.h>
 
+#ifndef DEW_STACK_MAX
+#define DEW_STACK_MAX 256
+#endif
+
 typedef double dew_Number;
 typedef int64_t dew_Integer;
 typedef bool dew_Boolean;
 typedef const char * dew_String;
 
+// Integer arithmetic wraps around like the machine instructions do, instead of
+// overflowing. Dividing by zero still has to be checked for first.
+#define DEW_INTEGER_ADD(A, B) ((dew_Integer) ((uint64_t) (A) + (uint64_t) (B)))
+#define DEW_INTEGER_SUB(A, B) ((dew_Integer) ((uint64_t) (A) - (uint64_t) (B)))
+#define DEW_INTEGER_MUL(A, B) ((dew_Integer) ((uint64_t) (A) * (uint64_t) (B)))
+#define DEW_INTEGER_DIV(A, B) ((B) == -1 ? DEW_INTEGER_NEGATE(A) : (A) / (B))
+#define DEW_INTEGER_NEGATE(A) ((dew_Integer) -(uint64_t) (A))
+
 typedef enum {
 	DEW_OP_NOP = 0,
 	DEW_OP_RET,
-	DEW_OP_CONST,
+	DEW_OP_CONST,          // const <index>
+	DEW_OP_POP,
+	DEW_OP_GET_LOCAL,      // get_local <slot>
+	DEW_OP_SET_LOCAL,      // set_local <slot>
+	DEW_OP_ADD,
+	DEW_OP_SUB,
+	DEW_OP_MUL,
+	DEW_OP_DIV,
+	DEW_OP_NEGATE,
+	DEW_OP_NOT,
+	DEW_OP_EQUAL,
+	DEW_OP_LESS,
+	DEW_OP_GREATER,
+	DEW_OP_JUMP,           // jump <offset:16>, forwards
+	DEW_OP_JUMP_IF_FALSE,  // jump_if_false <offset:16>, forwards, pops
+	DEW_OP_LOOP,           // loop <offset:16>, backwards
+	DEW_OP_DEFINE_GLOBAL,  // define_global <name>, pops
+	DEW_OP_GET_GLOBAL,     // get_global <name> <cache>
+	DEW_OP_SET_GLOBAL,     // set_global <name> <cache>
+	DEW_OP_CALL_GLOBAL,    // call_global <name> <cache> <argc>
+	
+	// Quickened forms of the generic instructions, only written by the VM
+	DEW_OP_ADD_INT_INT,
+	DEW_OP_ADD_NUM_NUM,
+	DEW_OP_SUB_INT_INT,
+	DEW_OP_SUB_NUM_NUM,
+	DEW_OP_MUL_INT_INT,
+	DEW_OP_MUL_NUM_NUM,
+	DEW_OP_DIV_NUM_NUM,
+	DEW_OP_LESS_INT_INT,
+	DEW_OP_LESS_NUM_NUM,
+	DEW_OP_GREATER_INT_INT,
+	DEW_OP_GREATER_NUM_NUM,
+	
+	DEW_OP_COUNT,
 } dew_OpCode;
 
-typedef union {
-	dew_Number asNumber;
-	dew_Integer asInteger;
-	dew_Boolean asBoolean;
-	dew_String asString;
-} dew_Value;
+typedef enum {
+	DEW_TYPE_NULL = 0,
+	DEW_TYPE_BOOLEAN,
+	DEW_TYPE_INTEGER,
+	DEW_TYPE_NUMBER,
+	DEW_TYPE_STRING,
+	DEW_TYPE_NATIVE,
+} dew_Type;
+
+typedef enum {
+	DEW_STATUS_OKAY = 0,
+	DEW_STATUS_RUNTIME = -1,
+	DEW_STATUS_VERIFY = -2,
+	DEW_STATUS_UNSUPPORTED = -3,
+} dew_Status;
+
+typedef enum {
+	DEW_PROFILE_OFF = 0,
+	DEW_PROFILE_COUNTS,    // Count how often each instruction is run
+	DEW_PROFILE_CYCLES,    // And the cycles spent in each one, on x86 only
+} dew_Profile;
+
+typedef struct dew_VM dew_VM;
+typedef struct dew_Value dew_Value;
+typedef struct dew_Loop dew_Loop;
+
+// Native functions set vm->error and return DEW_STATUS_RUNTIME on failure
+typedef dew_Status (*dew_Native)(dew_VM *vm, dew_Value *args, size_t argc, dew_Value *result);
+
+struct dew_Value {
+	dew_Type type;
+	union {
+		dew_Number asNumber;
+		dew_Integer asInteger;
+		dew_Boolean asBoolean;
+		dew_String asString;
+		dew_Native asNative;
+	};
+};
+
+typedef struct {
+	size_t offset;
+	const char *message;
+} dew_Error;
 
 typedef struct {
 	dew_Value *data;
@@ -42,18 +164,103 @@ typedef struct {
 	size_t alloc;
 } dew_Soup;
 
+typedef struct {
+	dew_Value *slot;    // Slot in the global table, valid while version matches
+	dew_String name;    // Global the slot belongs to
+	uint32_t version;   // Global table version the slot was found at
+	uint64_t hits;
+	uint64_t misses;
+} dew_Cache;
+
 typedef struct {
 	uint8_t *data;
 	size_t count;
 	size_t alloc;
 	
 	dew_Soup soup;
+	
+	dew_Cache *caches;
+	size_t cache_count;
+	
+	// Set by dew_chunk_verify, cleared by any write to the chunk
+	bool verified;
+	size_t max_stack;
+	
+	// Instructions rewritten to a specialised form, and back again
+	uint64_t quickened;
+	uint64_t deoptimised;
+	
+	// Machine code from dew_jit_compile, dropped by any write to the chunk,
+	// and whether the JIT turned the chunk down
+	void *jit_code;
+	size_t jit_size;
+	bool jit_declined;
+	
+	// Hotness counters and traces for loop headers, one entry per byte of
+	// code, allocated the first time the chunk is traced
+	dew_Loop *loops;
+	uint64_t traces_recorded;
+	uint64_t traces_aborted;
+	uint64_t traces_blacklisted;
+	uint64_t trace_exits;
+	
+	// Profiling counters, one entry per byte of code, allocated when a
+	// profiled chunk is run and reset by any write to the chunk
+	dew_Profile profile;
+	uint64_t *hits;
+	uint64_t *cycles;
 } dew_Chunk;
 
+typedef struct {
+	dew_String *names;
+	dew_Value *values;
+	size_t count;
+	size_t alloc;
+	
+	// Changes whenever slots might have moved, which invalidates caches
+	uint32_t version;
+} dew_Globals;
+
+struct dew_VM {
+	dew_Value stack[DEW_STACK_MAX];
+	dew_Value *top;
+	
+	dew_Globals globals;
+	
+	// Allow generic instructions to specialise themselves
+	bool quicken;
+	
+	// Compile verified chunks to machine code the first time they are run
+	bool jit;
+	
+	// Record and run traces for hot loops in verified chunks
+	bool trace;
+	
+	dew_Error error;
+};
+
+dew_Value dew_value_null(void);
+dew_Value dew_value_boolean(dew_Boolean value);
+dew_Value dew_value_integer(dew_Integer value);
+dew_Value dew_value_number(dew_Number value);
+dew_Value dew_value_string(dew_String value);
+dew_Value dew_value_native(dew_Native value);
+void dew_value_print(dew_Value value);
+
 void dew_chunk_init(dew_Chunk *chunk);
 void dew_chunk_write(dew_Chunk *chunk, uint8_t byte);
+size_t dew_chunk_write_jump(dew_Chunk *chunk, uint8_t opcode);
+void dew_chunk_patch_jump(dew_Chunk *chunk, size_t where);
+void dew_chunk_write_loop(dew_Chunk *chunk, size_t start);
+void dew_chunk_write_global(dew_Chunk *chunk, uint8_t opcode, dew_String name);
 void dew_chunk_dissassemble(dew_Chunk *chunk, const char * const title);
+void dew_chunk_dissassemble_traces(dew_Chunk *chunk);
+void dew_chunk_profile(dew_Chunk *chunk, dew_Profile profile);
 size_t dew_chunk_add_constant(dew_Chunk *chunk, dew_Value value);
+size_t dew_chunk_add_cache(dew_Chunk *chunk);
+void dew_chunk_cache_stats(dew_Chunk *chunk, uint64_t *hits, uint64_t *misses);
+dew_Status dew_chunk_verify(dew_Chunk *chunk, dew_Error *error);
+void dew_chunk_invalidate(dew_Chunk *chunk);
 void dew_chunk_free(dew_Chunk *chunk);
 
 void dew_soup_init(dew_Soup *soup);
@@ -61,6 +268,15 @@ size_t dew_soup_write(dew_Soup *soup, dew_Value value);
 int64_t dew_soup_get_int(dew_Soup *soup, size_t index);
 void dew_soup_free(dew_Soup *soup);
 
+void dew_vm_init(dew_VM *vm);
+dew_Status dew_vm_run(dew_VM *vm, dew_Chunk *chunk, dew_Value *result);
+void dew_vm_free(dew_VM *vm);
+void dew_vm_define(dew_VM *vm, dew_String name, dew_Value value);
+bool dew_vm_get(dew_VM *vm, dew_String name, dew_Value *value);
+
+dew_Status dew_jit_compile(dew_Chunk *chunk);
+void dew_jit_release(dew_Chunk *chunk);
+
 #endif
 
 /**
@@ -71,10 +287,121 @@ void dew_soup_free(dew_Soup *soup);
 #ifdef DEW_VMX_IMPLEMENTATION
 #undef DEW_VMX_IMPLEMENTATION
 
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define DEW_CYCLES() __rdtsc()
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define DEW_CYCLES() __rdtsc()
+#else
+#define DEW_CYCLES() 0
+#endif
+
+// Used on the dispatch loop so that the checked/unchecked flag is folded away
+#if defined(__GNUC__) || defined(__clang__)
+#define DEW_ALWAYS_INLINE static inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define DEW_ALWAYS_INLINE static __forceinline
+#else
+#define DEW_ALWAYS_INLINE static inline
+#endif
+
+/**
+ * Values
+ */
+
+dew_Value dew_value_null(void) {
+	return (dew_Value) {.type = DEW_TYPE_NULL, .asInteger = 0};
+}
+
+dew_Value dew_value_boolean(dew_Boolean value) {
+	return (dew_Value) {.type = DEW_TYPE_BOOLEAN, .asBoolean = value};
+}
+
+dew_Value dew_value_integer(dew_Integer value) {
+	return (dew_Value) {.type = DEW_TYPE_INTEGER, .asInteger = value};
+}
+
+dew_Value dew_value_number(dew_Number value) {
+	return (dew_Value) {.type = DEW_TYPE_NUMBER, .asNumber = value};
+}
+
+dew_Value dew_value_string(dew_String value) {
+	return (dew_Value) {.type = DEW_TYPE_STRING, .asString = value};
+}
+
+dew_Value dew_value_native(dew_Native value) {
+	return (dew_Value) {.type = DEW_TYPE_NATIVE, .asNative = value};
+}
+
+void dew_value_print(dew_Value value) {
+	/**
+	 * Print a value in a human-readable form.
+	 */
+	
+	switch (value.type) {
+		case DEW_TYPE_NULL: printf("null"); break;
+		case DEW_TYPE_BOOLEAN: printf(value.asBoolean ? "true" : "false"); break;
+		case DEW_TYPE_INTEGER: printf("%" PRId64, value.asInteger); break;
+		case DEW_TYPE_NUMBER: printf("%g", value.asNumber); break;
+		case DEW_TYPE_STRING: printf("\"%s\"", value.asString); break;
+		case DEW_TYPE_NATIVE: printf("<native>"); break;
+		default: printf("<value %d>", value.type); break;
+	}
+}
+
+static bool dew_value_truthy(dew_Value value) {
+	/**
+	 * Return if a value counts as true in a condition.
+	 */
+	
+	switch (value.type) {
+		case DEW_TYPE_NULL: return false;
+		case DEW_TYPE_BOOLEAN: return value.asBoolean;
+		case DEW_TYPE_INTEGER: return value.asInteger != 0;
+		case DEW_TYPE_NUMBER: return value.asNumber != 0.0;
+		case DEW_TYPE_STRING: return value.asString[0] != '\0';
+		default: return true;
+	}
+}
+
+static bool dew_value_equal(dew_Value a, dew_Value b) {
+	/**
+	 * Compare two values for equality. Integers and numbers compare by value.
+	 */
+	
+	if (a.type == DEW_TYPE_INTEGER && b.type == DEW_TYPE_NUMBER) {
+		return (dew_Number) a.asInteger == b.asNumber;
+	}
+	
+	if (a.type == DEW_TYPE_NUMBER && b.type == DEW_TYPE_INTEGER) {
+		return a.asNumber == (dew_Number) b.asInteger;
+	}
+	
+	if (a.type != b.type) {
+		return false;
+	}
+	
+	switch (a.type) {
+		case DEW_TYPE_NULL: return true;
+		case DEW_TYPE_BOOLEAN: return a.asBoolean == b.asBoolean;
+		case DEW_TYPE_INTEGER: return a.asInteger == b.asInteger;
+		case DEW_TYPE_NUMBER: return a.asNumber == b.asNumber;
+		case DEW_TYPE_STRING: return !strcmp(a.asString, b.asString);
+		case DEW_TYPE_NATIVE: return a.asNative == b.asNative;
+		default: return false;
+	}
+}
+
 /**
  * Chunks
  */
 
+static void dew_trace_release(dew_Chunk *chunk);
+
 static void *dew_memory(void *block, const size_t size) {
 	/**
 	 * Allocate memory, with similar rules to realloc.
@@ -99,6 +426,29 @@ void dew_chunk_init(dew_Chunk *chunk) {
 	chunk->data = dew_memory(NULL, chunk->alloc);
 	chunk->count = 0;
 	
+	chunk->verified = false;
+	chunk->max_stack = 0;
+	
+	chunk->quickened = 0;
+	chunk->deoptimised = 0;
+	
+	chunk->jit_code = NULL;
+	chunk->jit_size = 0;
+	chunk->jit_declined = false;
+	
+	chunk->loops = NULL;
+	chunk->traces_recorded = 0;
+	chunk->traces_aborted = 0;
+	chunk->traces_blacklisted = 0;
+	chunk->trace_exits = 0;
+	
+	chunk->profile = DEW_PROFILE_OFF;
+	chunk->hits = NULL;
+	chunk->cycles = NULL;
+	
+	chunk->caches = NULL;
+	chunk->cache_count = 0;
+	
 	dew_soup_init(&chunk->soup);
 }
 
@@ -114,6 +464,193 @@ void dew_chunk_write(dew_Chunk *chunk, uint8_t byte) {
 	
 	chunk->data[chunk->count] = byte;
 	chunk->count++;
+	
+	dew_chunk_invalidate(chunk);
+}
+
+size_t dew_chunk_write_jump(dew_Chunk *chunk, uint8_t opcode) {
+	/**
+	 * Write a forward jump with a placeholder offset, returning where the
+	 * offset is so it can be patched later.
+	 */
+	
+	dew_chunk_write(chunk, opcode);
+	dew_chunk_write(chunk, 0xff);
+	dew_chunk_write(chunk, 0xff);
+	
+	return chunk->count - 2;
+}
+
+void dew_chunk_patch_jump(dew_Chunk *chunk, size_t where) {
+	/**
+	 * Patch a forward jump so that it lands on the next byte to be written.
+	 */
+	
+	size_t offset = chunk->count - (where + 2);
+	
+	if (offset > UINT16_MAX) {
+		printf("dew_chunk_patch_jump: jump is too far, abort.\n");
+		abort();
+	}
+	
+	chunk->data[where] = (offset >> 8) & 0xff;
+	chunk->data[where + 1] = offset & 0xff;
+	
+	dew_chunk_invalidate(chunk);
+}
+
+void dew_chunk_write_loop(dew_Chunk *chunk, size_t start) {
+	/**
+	 * Write a backwards jump to the instruction at start.
+	 */
+	
+	dew_chunk_write(chunk, DEW_OP_LOOP);
+	
+	size_t offset = chunk->count + 2 - start;
+	
+	if (offset > UINT16_MAX) {
+		printf("dew_chunk_write_loop: loop is too large, abort.\n");
+		abort();
+	}
+	
+	dew_chunk_write(chunk, (offset >> 8) & 0xff);
+	dew_chunk_write(chunk, offset & 0xff);
+}
+
+void dew_chunk_write_global(dew_Chunk *chunk, uint8_t opcode, dew_String name) {
+	/**
+	 * Write an instruction that names a global, adding an inline cache for it.
+	 * Each name is only added to the constants once per chunk, so every cache
+	 * for a global compares against the same pointer. The argument count of a
+	 * call still has to be written after this.
+	 */
+	
+	size_t constant = 0;
+	
+	while (constant < chunk->soup.count) {
+		dew_Value value = chunk->soup.data[constant];
+		
+		if (value.type == DEW_TYPE_STRING && (value.asString == name || !strcmp(value.asString, name))) {
+			break;
+		}
+		
+		constant++;
+	}
+	
+	if (constant == chunk->soup.count) {
+		constant = dew_chunk_add_constant(chunk, dew_value_string(name));
+	}
+	
+	if (constant > UINT8_MAX) {
+		printf("dew_chunk_write_global: too many constants, abort.\n");
+		abort();
+	}
+	
+	dew_chunk_write(chunk, opcode);
+	dew_chunk_write(chunk, constant);
+	
+	if (opcode != DEW_OP_DEFINE_GLOBAL) {
+		size_t cache = dew_chunk_add_cache(chunk);
+		
+		if (cache > UINT8_MAX) {
+			printf("dew_chunk_write_global: too many inline caches, abort.\n");
+			abort();
+		}
+		
+		dew_chunk_write(chunk, cache);
+	}
+}
+
+static const char *dew_opcode_names[DEW_OP_COUNT] = {
+	[DEW_OP_NOP] = "nop",
+	[DEW_OP_RET] = "ret",
+	[DEW_OP_CONST] = "const",
+	[DEW_OP_POP] = "pop",
+	[DEW_OP_GET_LOCAL] = "get_local",
+	[DEW_OP_SET_LOCAL] = "set_local",
+	[DEW_OP_ADD] = "add",
+	[DEW_OP_SUB] = "sub",
+	[DEW_OP_MUL] = "mul",
+	[DEW_OP_DIV] = "div",
+	[DEW_OP_NEGATE] = "negate",
+	[DEW_OP_NOT] = "not",
+	[DEW_OP_EQUAL] = "equal",
+	[DEW_OP_LESS] = "less",
+	[DEW_OP_GREATER] = "greater",
+	[DEW_OP_JUMP] = "jump",
+	[DEW_OP_JUMP_IF_FALSE] = "jump_if_false",
+	[DEW_OP_LOOP] = "loop",
+	[DEW_OP_DEFINE_GLOBAL] = "define_global",
+	[DEW_OP_GET_GLOBAL] = "get_global",
+	[DEW_OP_SET_GLOBAL] = "set_global",
+	[DEW_OP_CALL_GLOBAL] = "call_global",
+	[DEW_OP_ADD_INT_INT] = "add_int_int",
+	[DEW_OP_ADD_NUM_NUM] = "add_num_num",
+	[DEW_OP_SUB_INT_INT] = "sub_int_int",
+	[DEW_OP_SUB_NUM_NUM] = "sub_num_num",
+	[DEW_OP_MUL_INT_INT] = "mul_int_int",
+	[DEW_OP_MUL_NUM_NUM] = "mul_num_num",
+	[DEW_OP_DIV_NUM_NUM] = "div_num_num",
+	[DEW_OP_LESS_INT_INT] = "less_int_int",
+	[DEW_OP_LESS_NUM_NUM] = "less_num_num",
+	[DEW_OP_GREATER_INT_INT] = "greater_int_int",
+	[DEW_OP_GREATER_NUM_NUM] = "greater_num_num",
+};
+
+static size_t dew_opcode_length(uint8_t opcode) {
+	/**
+	 * Return the length of an instruction in bytes, including its operands,
+	 * or zero if the opcode is not known.
+	 */
+	
+	switch (opcode) {
+		case DEW_OP_CONST:
+		case DEW_OP_GET_LOCAL:
+		case DEW_OP_SET_LOCAL:
+		case DEW_OP_DEFINE_GLOBAL:
+			return 2;
+		case DEW_OP_JUMP:
+		case DEW_OP_JUMP_IF_FALSE:
+		case DEW_OP_LOOP:
+		case DEW_OP_GET_GLOBAL:
+		case DEW_OP_SET_GLOBAL:
+			return 3;
+		case DEW_OP_CALL_GLOBAL:
+			return 4;
+		default:
+			return (opcode < DEW_OP_COUNT) ? 1 : 0;
+	}
+}
+
+static void dew_chunk_diss_profile(dew_Chunk *chunk, size_t where) {
+	/**
+	 * Print the profile columns for an instruction: its share of the time
+	 * spent in the chunk, by cycles if they were counted and by instructions
+	 * run otherwise, then the raw counts.
+	 */
+	
+	uint64_t total_hits = 0, total_cycles = 0;
+	
+	for (size_t i = 0; i < chunk->count; i++) {
+		total_hits += chunk->hits[i];
+		total_cycles += chunk->cycles ? chunk->cycles[i] : 0;
+	}
+	
+	uint64_t share = total_cycles ? chunk->cycles[where] : chunk->hits[where];
+	uint64_t total = total_cycles ? total_cycles : total_hits;
+	
+	if (!chunk->hits[where]) {
+		printf("%8s %12s ", "", "");
+	}
+	else {
+		printf("%7.2f%% %12" PRIu64 " ", total ? 100.0 * share / total : 0.0, chunk->hits[where]);
+	}
+	
+	if (chunk->cycles) {
+		printf("%14" PRIu64 " ", chunk->cycles[where]);
+	}
+	
+	printf(" ");
 }
 
 static size_t dew_chunk_diss_instr(dew_Chunk *chunk, size_t where) {
@@ -122,97 +659,2310 @@ static size_t dew_chunk_diss_instr(dew_Chunk *chunk, size_t where) {
 	 */
 	
 	uint8_t opcode = chunk->data[where];
+	size_t length = dew_opcode_length(opcode);
+	
+	if (chunk->hits) {
+		dew_chunk_diss_profile(chunk, where);
+	}
+	
+	printf("%.4zX  ", where);
+	
+	if (!length) {
+		printf("??? %.2X\n", opcode);
+		return 1;
+	}
+	
+	if (where + length > chunk->count) {
+		printf("%s (truncated)\n", dew_opcode_names[opcode]);
+		return chunk->count - where;
+	}
 	
 	switch (opcode) {
-		case DEW_OP_NOP: {
-			printf("nop\n");
-			return 1;
+		case DEW_OP_CONST: {
+			uint8_t index = chunk->data[where + 1];
+			
+			printf("const %.2X   (= ", index);
+			
+			if (index < chunk->soup.count) {
+				dew_value_print(chunk->soup.data[index]);
+			}
+			else {
+				printf("out of range");
+			}
+			
+			printf(")\n");
+			
+			break;
 		}
-		case DEW_OP_RET: {
-			printf("ret\n");
-			return 1;
+		case DEW_OP_GET_LOCAL:
+		case DEW_OP_SET_LOCAL: {
+			printf("%s %.2X\n", dew_opcode_names[opcode], chunk->data[where + 1]);
+			break;
 		}
-		case DEW_OP_CONST: {
-			printf("const %.2X   (= %.16X)\n", chunk->data[where + 1], dew_soup_get_int(&chunk->soup, chunk->data[where + 1]));
-			return 2;
+		case DEW_OP_JUMP:
+		case DEW_OP_JUMP_IF_FALSE:
+		case DEW_OP_LOOP: {
+			uint16_t offset = (chunk->data[where + 1] << 8) | chunk->data[where + 2];
+			size_t target = (opcode == DEW_OP_LOOP) ? (where + 3 - offset) : (where + 3 + offset);
+			
+			printf("%s %.4zX\n", dew_opcode_names[opcode], target);
+			
+			break;
+		}
+		case DEW_OP_DEFINE_GLOBAL:
+		case DEW_OP_GET_GLOBAL:
+		case DEW_OP_SET_GLOBAL:
+		case DEW_OP_CALL_GLOBAL: {
+			uint8_t name = chunk->data[where + 1];
+			
+			printf("%s %.2X", dew_opcode_names[opcode], name);
+			
+			if (name < chunk->soup.count && chunk->soup.data[name].type == DEW_TYPE_STRING) {
+				printf(" '%s'", chunk->soup.data[name].asString);
+			}
+			
+			if (opcode != DEW_OP_DEFINE_GLOBAL) {
+				uint8_t cache = chunk->data[where + 2];
+				
+				printf(" [cache %.2X", cache);
+				
+				if (cache < chunk->cache_count) {
+					printf(": %" PRIu64 " hits, %" PRIu64 " misses", chunk->caches[cache].hits, chunk->caches[cache].misses);
+				}
+				
+				printf("]");
+			}
+			
+			if (opcode == DEW_OP_CALL_GLOBAL) {
+				printf(" (%d args)", chunk->data[where + 3]);
+			}
+			
+			printf("\n");
+			
+			break;
 		}
 		default: {
-			printf("??? %.2X\n", opcode);
-			return 1;
+			printf("%s\n", dew_opcode_names[opcode]);
+			break;
 		}
 	}
+	
+	return length;
 }
 
 void dew_chunk_dissassemble(dew_Chunk *chunk, const char * const title) {
 	/**
-	 * Dissassemble a chunk.
+	 * Dissassemble a chunk, with the profile alongside if it has one.
 	 */
 	
 	printf("## %s ##\n", title);
 	
+	if (chunk->hits) {
+		printf("%8s %12s %s %s\n", "share", "runs", chunk->cycles ? "        cycles " : "", "code");
+	}
+	
 	for (size_t i = 0; i < chunk->count;) {
 		i += dew_chunk_diss_instr(chunk, i);
 	}
 }
 
 size_t dew_chunk_add_constant(dew_Chunk *chunk, dew_Value value) {
+	dew_chunk_invalidate(chunk);
+	
 	return dew_soup_write(&chunk->soup, value);
 }
 
+size_t dew_chunk_add_cache(dew_Chunk *chunk) {
+	/**
+	 * Add an empty inline cache to the chunk and return its index.
+	 */
+	
+	dew_chunk_invalidate(chunk);
+	
+	chunk->caches = dew_memory(chunk->caches, sizeof *chunk->caches * (chunk->cache_count + 1));
+	chunk->caches[chunk->cache_count] = (dew_Cache) {NULL, NULL, 0, 0, 0};
+	
+	return chunk->cache_count++;
+}
+
+void dew_chunk_cache_stats(dew_Chunk *chunk, uint64_t *hits, uint64_t *misses) {
+	/**
+	 * Total up the hit and miss counters of all the inline caches.
+	 */
+	
+	*hits = 0;
+	*misses = 0;
+	
+	for (size_t i = 0; i < chunk->cache_count; i++) {
+		*hits += chunk->caches[i].hits;
+		*misses += chunk->caches[i].misses;
+	}
+}
+
+void dew_chunk_invalidate(dew_Chunk *chunk) {
+	/**
+	 * Forget everything that was worked out about the chunk's code, which has
+	 * to be done after changing its code or constants directly.
+	 */
+	
+	chunk->verified = false;
+	chunk->jit_declined = false;
+	
+	if (chunk->jit_code) {
+		dew_jit_release(chunk);
+	}
+	
+	if (chunk->loops) {
+		dew_trace_release(chunk);
+	}
+	
+	if (chunk->hits) {
+		free(chunk->hits);
+		free(chunk->cycles);
+		chunk->hits = NULL;
+		chunk->cycles = NULL;
+	}
+}
+
+void dew_chunk_profile(dew_Chunk *chunk, dew_Profile profile) {
+	/**
+	 * Start or stop profiling a chunk. Starting again, or switching between
+	 * counting runs and cycles, throws away the counts so far. Profiled
+	 * chunks are never compiled or traced, so the counts are for the
+	 * interpreter.
+	 */
+	
+	free(chunk->hits);
+	free(chunk->cycles);
+	chunk->hits = NULL;
+	chunk->cycles = NULL;
+	chunk->profile = profile;
+}
+
 void dew_chunk_free(dew_Chunk *chunk) {
 	/**
 	 * Free a chunk.
 	 */
 	
+	dew_jit_release(chunk);
+	dew_trace_release(chunk);
+	dew_chunk_profile(chunk, DEW_PROFILE_OFF);
 	dew_soup_free(&chunk->soup);
 	
+	chunk->caches = dew_memory(chunk->caches, 0);
+	chunk->cache_count = 0;
+	
 	chunk->data = dew_memory(chunk->data, 0);
+	chunk->count = 0;
+	chunk->verified = false;
 }
 
 /**
- * Constant pools (soups)
+ * Verifier
  */
 
-void dew_soup_init(dew_Soup *soup) {
+static int dew_opcode_pops(const uint8_t *instr) {
 	/**
-	 * Initialise a soup.
+	 * Number of values an instruction takes off the stack.
 	 */
 	
-	soup->alloc = 8;
-	soup->data = dew_memory(NULL, sizeof *soup->data * soup->alloc);
-	soup->count = 0;
+	switch (instr[0]) {
+		case DEW_OP_CALL_GLOBAL:
+			return instr[3];
+		case DEW_OP_SET_GLOBAL:
+		case DEW_OP_DEFINE_GLOBAL:
+		case DEW_OP_POP:
+		case DEW_OP_NEGATE:
+		case DEW_OP_NOT:
+		case DEW_OP_JUMP_IF_FALSE:
+			return 1;
+		case DEW_OP_ADD:
+		case DEW_OP_SUB:
+		case DEW_OP_MUL:
+		case DEW_OP_DIV:
+		case DEW_OP_EQUAL:
+		case DEW_OP_LESS:
+		case DEW_OP_GREATER:
+		case DEW_OP_ADD_INT_INT:
+		case DEW_OP_ADD_NUM_NUM:
+		case DEW_OP_SUB_INT_INT:
+		case DEW_OP_SUB_NUM_NUM:
+		case DEW_OP_MUL_INT_INT:
+		case DEW_OP_MUL_NUM_NUM:
+		case DEW_OP_DIV_NUM_NUM:
+		case DEW_OP_LESS_INT_INT:
+		case DEW_OP_LESS_NUM_NUM:
+		case DEW_OP_GREATER_INT_INT:
+		case DEW_OP_GREATER_NUM_NUM:
+			return 2;
+		default:
+			return 0;
+	}
 }
 
-size_t dew_soup_write(dew_Soup *soup, dew_Value value) {
+static int dew_opcode_pushes(const uint8_t *instr) {
 	/**
-	 * Write a value to the soup of values.
+	 * Number of values an instruction puts on the stack.
 	 */
 	
-	if (soup->count >= soup->alloc) {
-		soup->alloc *= 2;
-		soup->data = dew_memory(soup->data, sizeof *soup->data * soup->alloc);
+	switch (instr[0]) {
+		case DEW_OP_SET_GLOBAL:
+		case DEW_OP_GET_GLOBAL:
+		case DEW_OP_CALL_GLOBAL:
+		case DEW_OP_CONST:
+		case DEW_OP_GET_LOCAL:
+		case DEW_OP_ADD:
+		case DEW_OP_SUB:
+		case DEW_OP_MUL:
+		case DEW_OP_DIV:
+		case DEW_OP_NEGATE:
+		case DEW_OP_NOT:
+		case DEW_OP_EQUAL:
+		case DEW_OP_LESS:
+		case DEW_OP_GREATER:
+		case DEW_OP_ADD_INT_INT:
+		case DEW_OP_ADD_NUM_NUM:
+		case DEW_OP_SUB_INT_INT:
+		case DEW_OP_SUB_NUM_NUM:
+		case DEW_OP_MUL_INT_INT:
+		case DEW_OP_MUL_NUM_NUM:
+		case DEW_OP_DIV_NUM_NUM:
+		case DEW_OP_LESS_INT_INT:
+		case DEW_OP_LESS_NUM_NUM:
+		case DEW_OP_GREATER_INT_INT:
+		case DEW_OP_GREATER_NUM_NUM:
+			return 1;
+		default:
+			return 0;
 	}
-	
-	soup->data[soup->count] = value;
-	soup->count++;
-	
-	return soup->count - 1;
 }
 
-int64_t dew_soup_get_int(dew_Soup *soup, size_t index) {
+static size_t dew_jump_target(dew_Chunk *chunk, size_t where) {
 	/**
-	 * Read an integer value from the table.
+	 * Find where the jump instruction at where would land.
 	 */
 	
-	return soup->data[index].asInteger;
+	uint16_t offset = (chunk->data[where + 1] << 8) | chunk->data[where + 2];
+	
+	if (chunk->data[where] == DEW_OP_LOOP) {
+		return (offset > where + 3) ? SIZE_MAX : (where + 3 - offset);
+	}
+	
+	return where + 3 + offset;
 }
 
-void dew_soup_free(dew_Soup *soup) {
+dew_Status dew_chunk_verify(dew_Chunk *chunk, dew_Error *error) {
 	/**
-	 * Free a value soup.
+	 * Prove that the chunk is safe to run without per-instruction checks:
+	 * 
+	 *   - every opcode is known and its operands are inside the chunk,
+	 *   - constant indices are inside the soup, global names are strings and
+	 *     inline cache indices are inside the chunk's cache table,
+	 *   - jumps land on the start of an instruction,
+	 *   - the stack never underflows, local slots always exist, and every path
+	 *     reaching an instruction agrees on the stack depth there, so the
+	 *     maximum depth is bounded and fits in the VM stack,
+	 *   - control never runs off the end of the chunk.
+	 * 
+	 * On success the chunk is marked as verified and its maximum stack depth
+	 * is recorded.
 	 */
 	
-	soup->data = dew_memory(soup->data, 0);
+	dew_Error fail = {0, NULL};
+	
+	chunk->verified = false;
+	chunk->max_stack = 0;
+	
+	if (chunk->count == 0) {
+		fail = (dew_Error) {0, "empty chunk"};
+		goto done;
+	}
+	
+	// One entry per byte: true where an instruction starts, and the known
+	// stack depth at that instruction (-1 for not reached yet)
+	bool *start = dew_memory(NULL, sizeof *start * chunk->count);
+	int32_t *depth = dew_memory(NULL, sizeof *depth * chunk->count);
+	size_t *work = dew_memory(NULL, sizeof *work * chunk->count);
+	size_t work_count = 0;
+	
+	memset(start, 0, sizeof *start * chunk->count);
+	
+	for (size_t i = 0; i < chunk->count; i++) {
+		depth[i] = -1;
+	}
+	
+	// Pass 1: decode linearly and find instruction boundaries
+	for (size_t i = 0; i < chunk->count;) {
+		uint8_t opcode = chunk->data[i];
+		size_t length = dew_opcode_length(opcode);
+		
+		if (!length) {
+			fail = (dew_Error) {i, "unknown opcode"};
+			goto cleanup;
+		}
+		
+		if (i + length > chunk->count) {
+			fail = (dew_Error) {i, "operands run past the end of the chunk"};
+			goto cleanup;
+		}
+		
+		if (opcode == DEW_OP_CONST && chunk->data[i + 1] >= chunk->soup.count) {
+			fail = (dew_Error) {i, "constant index out of range"};
+			goto cleanup;
+		}
+		
+		if (opcode == DEW_OP_DEFINE_GLOBAL || opcode == DEW_OP_GET_GLOBAL || opcode == DEW_OP_SET_GLOBAL || opcode == DEW_OP_CALL_GLOBAL) {
+			uint8_t name = chunk->data[i + 1];
+			
+			if (name >= chunk->soup.count || chunk->soup.data[name].type != DEW_TYPE_STRING) {
+				fail = (dew_Error) {i, "global name is not a string constant"};
+				goto cleanup;
+			}
+			
+			if (opcode != DEW_OP_DEFINE_GLOBAL && chunk->data[i + 2] >= chunk->cache_count) {
+				fail = (dew_Error) {i, "inline cache index out of range"};
+				goto cleanup;
+			}
+		}
+		
+		start[i] = true;
+		i += length;
+	}
+	
+	// Pass 2: walk every path, tracking stack depth
+	depth[0] = 0;
+	work[work_count++] = 0;
+	
+	while (work_count) {
+		size_t i = work[--work_count];
+		uint8_t opcode = chunk->data[i];
+		int32_t in = depth[i];
+		int32_t out = in - dew_opcode_pops(&chunk->data[i]);
+		
+		if (out < 0) {
+			fail = (dew_Error) {i, "stack underflow"};
+			goto cleanup;
+		}
+		
+		if ((opcode == DEW_OP_GET_LOCAL || opcode == DEW_OP_SET_LOCAL) && chunk->data[i + 1] >= in) {
+			fail = (dew_Error) {i, "local slot out of range"};
+			goto cleanup;
+		}
+		
+		out += dew_opcode_pushes(&chunk->data[i]);
+		
+		if (out > DEW_STACK_MAX) {
+			fail = (dew_Error) {i, "stack overflow"};
+			goto cleanup;
+		}
+		
+		if ((size_t) out > chunk->max_stack) {
+			chunk->max_stack = out;
+		}
+		
+		// Successors
+		size_t next[2];
+		size_t next_count = 0;
+		
+		if (opcode == DEW_OP_JUMP || opcode == DEW_OP_JUMP_IF_FALSE || opcode == DEW_OP_LOOP) {
+			size_t target = dew_jump_target(chunk, i);
+			
+			if (target >= chunk->count || !start[target]) {
+				fail = (dew_Error) {i, "jump does not land on an instruction"};
+				goto cleanup;
+			}
+			
+			next[next_count++] = target;
+		}
+		
+		if (opcode != DEW_OP_RET && opcode != DEW_OP_JUMP && opcode != DEW_OP_LOOP) {
+			size_t fall = i + dew_opcode_length(opcode);
+			
+			if (fall >= chunk->count) {
+				fail = (dew_Error) {i, "control runs off the end of the chunk"};
+				goto cleanup;
+			}
+			
+			next[next_count++] = fall;
+		}
+		
+		for (size_t j = 0; j < next_count; j++) {
+			if (depth[next[j]] == -1) {
+				depth[next[j]] = out;
+				work[work_count++] = next[j];
+			}
+			else if (depth[next[j]] != out) {
+				fail = (dew_Error) {next[j], "inconsistent stack depth where paths meet"};
+				goto cleanup;
+			}
+		}
+	}
+	
+	chunk->verified = true;
+
+cleanup:
+	dew_memory(start, 0);
+	dew_memory(depth, 0);
+	dew_memory(work, 0);
+
+done:
+	if (!chunk->verified) {
+		chunk->max_stack = 0;
+		
+		if (error) {
+			*error = fail;
+		}
+		
+		return DEW_STATUS_VERIFY;
+	}
+	
+	return DEW_STATUS_OKAY;
+}
+
+/**
+ * Constant pools (soups)
+ */
+
+void dew_soup_init(dew_Soup *soup) {
+	/**
+	 * Initialise a soup.
+	 */
+	
+	soup->alloc = 8;
+	soup->data = dew_memory(NULL, sizeof *soup->data * soup->alloc);
+	soup->count = 0;
+}
+
+size_t dew_soup_write(dew_Soup *soup, dew_Value value) {
+	/**
+	 * Write a value to the soup of values.
+	 */
+	
+	if (soup->count >= soup->alloc) {
+		soup->alloc *= 2;
+		soup->data = dew_memory(soup->data, sizeof *soup->data * soup->alloc);
+	}
+	
+	soup->data[soup->count] = value;
+	soup->count++;
+	
+	return soup->count - 1;
+}
+
+int64_t dew_soup_get_int(dew_Soup *soup, size_t index) {
+	/**
+	 * Read an integer value from the table.
+	 */
+	
+	return soup->data[index].asInteger;
+}
+
+void dew_soup_free(dew_Soup *soup) {
+	/**
+	 * Free a value soup.
+	 */
+	
+	soup->data = dew_memory(soup->data, 0);
+}
+
+/**
+ * Globals
+ */
+
+// Shared by every VM, so a cache filled against one VM's table can never look
+// valid against another's
+static uint32_t dew_globals_epoch = 0;
+
+static dew_Value *dew_globals_find(dew_Globals *globals, dew_String name) {
+	/**
+	 * Find the slot for a global by name, or NULL if it is not defined. This
+	 * is the slow path that inline caches avoid.
+	 */
+	
+	for (size_t i = 0; i < globals->count; i++) {
+		if (globals->names[i] == name || !strcmp(globals->names[i], name)) {
+			return &globals->values[i];
+		}
+	}
+	
+	return NULL;
+}
+
+static void dew_globals_define(dew_Globals *globals, dew_String name, dew_Value value) {
+	/**
+	 * Define a global, or overwrite it if it already exists. Adding a new
+	 * global can move every slot, so it gives the table a new version.
+	 */
+	
+	dew_Value *slot = dew_globals_find(globals, name);
+	
+	if (slot) {
+		*slot = value;
+		return;
+	}
+	
+	if (globals->count >= globals->alloc) {
+		globals->alloc = globals->alloc ? globals->alloc * 2 : 8;
+		globals->names = dew_memory(globals->names, sizeof *globals->names * globals->alloc);
+		globals->values = dew_memory(globals->values, sizeof *globals->values * globals->alloc);
+	}
+	
+	globals->names[globals->count] = name;
+	globals->values[globals->count] = value;
+	globals->count++;
+	
+	globals->version = ++dew_globals_epoch;
+}
+
+static bool dew_cache_fill(dew_Globals *globals, dew_Cache *cache, dew_String name) {
+	/**
+	 * Refill an inline cache after a miss. Returns false if the global does
+	 * not exist.
+	 */
+	
+	cache->misses++;
+	cache->slot = dew_globals_find(globals, name);
+	
+	if (!cache->slot) {
+		cache->version = 0;
+		return false;
+	}
+	
+	cache->name = name;
+	cache->version = globals->version;
+	
+	return true;
+}
+
+static dew_Status dew_builtin_print(dew_VM *vm, dew_Value *args, size_t argc, dew_Value *result) {
+	/**
+	 * print(...): print all arguments with no separator.
+	 */
+	
+	(void) vm;
+	
+	for (size_t i = 0; i < argc; i++) {
+		if (args[i].type == DEW_TYPE_STRING) {
+			printf("%s", args[i].asString);
+		}
+		else {
+			dew_value_print(args[i]);
+		}
+	}
+	
+	*result = dew_value_null();
+	
+	return DEW_STATUS_OKAY;
+}
+
+/**
+ * Virtual machine
+ */
+
+void dew_vm_init(dew_VM *vm) {
+	/**
+	 * Initialise a virtual machine.
+	 */
+	
+	vm->top = vm->stack;
+	vm->error = (dew_Error) {0, NULL};
+	
+	vm->globals = (dew_Globals) {NULL, NULL, 0, 0, ++dew_globals_epoch};
+	
+	vm->quicken = true;
+	vm->jit = false;
+	vm->trace = false;
+	
+	dew_vm_define(vm, "print", dew_value_native(dew_builtin_print));
+}
+
+void dew_vm_free(dew_VM *vm) {
+	/**
+	 * Free a virtual machine.
+	 */
+	
+	vm->top = vm->stack;
+	
+	vm->globals.names = dew_memory(vm->globals.names, 0);
+	vm->globals.values = dew_memory(vm->globals.values, 0);
+	vm->globals.count = 0;
+	vm->globals.alloc = 0;
+	vm->globals.version = ++dew_globals_epoch;
+}
+
+void dew_vm_define(dew_VM *vm, dew_String name, dew_Value value) {
+	/**
+	 * Define a global from the embedding program. The name is not copied, so
+	 * it must outlive the VM.
+	 */
+	
+	dew_globals_define(&vm->globals, name, value);
+}
+
+bool dew_vm_get(dew_VM *vm, dew_String name, dew_Value *value) {
+	/**
+	 * Read a global from the embedding program.
+	 */
+	
+	dew_Value *slot = dew_globals_find(&vm->globals, name);
+	
+	if (!slot) {
+		return false;
+	}
+	
+	*value = *slot;
+	
+	return true;
+}
+
+static dew_Status dew_trace_loop(dew_VM *vm, dew_Chunk *chunk, size_t *pc, dew_Value *base);
+
+DEW_ALWAYS_INLINE dew_Status dew_vm_loop(dew_VM *vm, dew_Chunk *chunk, dew_Value *result, const bool checked, const bool step, const bool profile, size_t *pc, dew_Value *base) {
+	/**
+	 * The dispatch loop. When checked is false the caller promises that the
+	 * chunk was verified, and all checks for things the verifier proves are
+	 * left out.
+	 * 
+	 * Execution starts at *pc with the frame at base and the stack top at
+	 * vm->top. When step is true only one instruction is run, which must not
+	 * be a return, and the new stack top is left in vm->top and the offset of
+	 * the next instruction in *pc.
+	 * 
+	 * When profile is true the chunk's profiling counters are updated as it
+	 * goes. The cycles for an instruction are the time from its start to the
+	 * start of the next one, so those for the last instruction run are lost.
+	 */
+	
+	const uint8_t *code = chunk->data;
+	const uint8_t *ip = code + *pc;
+	const uint8_t *end = code + chunk->count;
+	const dew_Value *soup = chunk->soup.data;
+	const uint8_t *at = ip;
+	dew_Cache *caches = chunk->caches;
+	dew_Globals *globals = &vm->globals;
+	dew_Value *top = vm->top;
+	uint64_t *hits = chunk->hits;
+	uint64_t *cycles = chunk->cycles;
+	uint64_t last_cycles = 0;
+	size_t last_at = 0;
+	
+	// Set when a deoptimised instruction goes round again as the generic one,
+	// which the profile counts as the same dispatch
+	bool rerun = false;
+
+#define DEW_FAIL(MESSAGE) do { vm->error = (dew_Error) {(size_t) (at - code), MESSAGE}; vm->top = base; return DEW_STATUS_RUNTIME; } while (0)
+#define DEW_CHECK(COND, MESSAGE) do { if (checked && !(COND)) { DEW_FAIL(MESSAGE); } } while (0)
+#define DEW_NEED(COUNT) DEW_CHECK(top - base >= (COUNT), "stack underflow")
+#define DEW_ROOM() DEW_CHECK(top < vm->stack + DEW_STACK_MAX, "stack overflow")
+#define DEW_OPERANDS(COUNT) DEW_CHECK(ip + (COUNT) <= end, "operands run past the end of the chunk")
+#define DEW_READ_SHORT() (ip += 2, (uint16_t) ((ip[-2] << 8) | ip[-1]))
+#define DEW_GLOBAL_OPERANDS() \
+	do { \
+		DEW_OPERANDS(2); \
+		DEW_CHECK(ip[0] < chunk->soup.count && soup[ip[0]].type == DEW_TYPE_STRING, "global name is not a string constant"); \
+		DEW_CHECK(ip[1] < chunk->cache_count, "inline cache index out of range"); \
+	} while (0)
+#define DEW_CACHED_SLOT(CACHE) \
+	do { \
+		if ((CACHE)->version == globals->version && (CACHE)->name == soup[ip[0]].asString) { \
+			(CACHE)->hits++; \
+		} \
+		else if (!dew_cache_fill(globals, (CACHE), soup[ip[0]].asString)) { \
+			DEW_FAIL("undefined global"); \
+		} \
+	} while (0)
+#define DEW_QUICKEN(OPCODE) \
+	do { \
+		if (vm->quicken && (OPCODE) != opcode) { \
+			chunk->data[at - code] = (OPCODE); \
+			chunk->quickened++; \
+		} \
+	} while (0)
+#define DEW_ARITH(OP, INTEGER, NAME, INT_INT, NUM_NUM) \
+	do { \
+		DEW_NEED(2); \
+		dew_Value b = *--top; \
+		dew_Value a = top[-1]; \
+		if (a.type == DEW_TYPE_INTEGER && b.type == DEW_TYPE_INTEGER) { \
+			top[-1] = dew_value_integer(INTEGER(a.asInteger, b.asInteger)); \
+			DEW_QUICKEN(INT_INT); \
+		} \
+		else if (a.type == DEW_TYPE_INTEGER && b.type == DEW_TYPE_NUMBER) { \
+			top[-1] = dew_value_number((dew_Number) a.asInteger OP b.asNumber); \
+		} \
+		else if (a.type == DEW_TYPE_NUMBER && b.type == DEW_TYPE_INTEGER) { \
+			top[-1] = dew_value_number(a.asNumber OP (dew_Number) b.asInteger); \
+		} \
+		else if (a.type == DEW_TYPE_NUMBER && b.type == DEW_TYPE_NUMBER) { \
+			top[-1] = dew_value_number(a.asNumber OP b.asNumber); \
+			DEW_QUICKEN(NUM_NUM); \
+		} \
+		else { \
+			DEW_FAIL("cannot " NAME " values of these types"); \
+		} \
+	} while (0)
+#define DEW_COMPARE(OP, INT_INT, NUM_NUM) \
+	do { \
+		DEW_NEED(2); \
+		dew_Value b = *--top; \
+		dew_Value a = top[-1]; \
+		if (a.type == DEW_TYPE_INTEGER && b.type == DEW_TYPE_INTEGER) { \
+			top[-1] = dew_value_boolean(a.asInteger OP b.asInteger); \
+			DEW_QUICKEN(INT_INT); \
+		} \
+		else if (a.type == DEW_TYPE_INTEGER && b.type == DEW_TYPE_NUMBER) { \
+			top[-1] = dew_value_boolean((dew_Number) a.asInteger OP b.asNumber); \
+		} \
+		else if (a.type == DEW_TYPE_NUMBER && b.type == DEW_TYPE_INTEGER) { \
+			top[-1] = dew_value_boolean(a.asNumber OP (dew_Number) b.asInteger); \
+		} \
+		else if (a.type == DEW_TYPE_NUMBER && b.type == DEW_TYPE_NUMBER) { \
+			top[-1] = dew_value_boolean(a.asNumber OP b.asNumber); \
+			DEW_QUICKEN(NUM_NUM); \
+		} \
+		else { \
+			DEW_FAIL("cannot compare values of these types"); \
+		} \
+	} while (0)
+#define DEW_SPECIALISED(GENERIC, TYPE, MAKE, VALUE) \
+	do { \
+		DEW_NEED(2); \
+		if (top[-2].type == (TYPE) && top[-1].type == (TYPE)) { \
+			dew_Value a = top[-2]; \
+			dew_Value b = top[-1]; \
+			top[-2] = MAKE(VALUE); \
+			top--; \
+		} \
+		else { \
+			/* Guard failed: go back to the generic form and run that */ \
+			chunk->data[at - code] = (GENERIC); \
+			chunk->deoptimised++; \
+			rerun = true; \
+			ip = at; \
+		} \
+	} while (0)
+	
+	while (true) {
+		DEW_CHECK(ip < end, "control ran off the end of the chunk");
+		
+		at = ip;
+		
+		if (profile && rerun) {
+			rerun = false;
+		}
+		else if (profile) {
+			hits[at - code]++;
+			
+			if (cycles) {
+				uint64_t now = DEW_CYCLES();
+				
+				if (last_cycles) {
+					cycles[last_at] += now - last_cycles;
+				}
+				
+				last_cycles = now;
+				last_at = at - code;
+			}
+		}
+		
+		uint8_t opcode = *ip++;
+		
+		switch (opcode) {
+			case DEW_OP_NOP: {
+				break;
+			}
+			case DEW_OP_RET: {
+				if (result) {
+					*result = (top > base) ? top[-1] : dew_value_null();
+				}
+				
+				vm->top = base;
+				
+				return DEW_STATUS_OKAY;
+			}
+			case DEW_OP_CONST: {
+				DEW_OPERANDS(1);
+				DEW_CHECK(*ip < chunk->soup.count, "constant index out of range");
+				DEW_ROOM();
+				*top++ = soup[*ip++];
+				break;
+			}
+			case DEW_OP_POP: {
+				DEW_NEED(1);
+				top--;
+				break;
+			}
+			case DEW_OP_GET_LOCAL: {
+				DEW_OPERANDS(1);
+				DEW_CHECK(*ip < top - base, "local slot out of range");
+				DEW_ROOM();
+				*top = base[*ip++];
+				top++;
+				break;
+			}
+			case DEW_OP_SET_LOCAL: {
+				DEW_OPERANDS(1);
+				DEW_CHECK(*ip < top - base, "local slot out of range");
+				base[*ip++] = top[-1];
+				break;
+			}
+			case DEW_OP_ADD: {
+				DEW_ARITH(+, DEW_INTEGER_ADD, "add", DEW_OP_ADD_INT_INT, DEW_OP_ADD_NUM_NUM);
+				break;
+			}
+			case DEW_OP_SUB: {
+				DEW_ARITH(-, DEW_INTEGER_SUB, "subtract", DEW_OP_SUB_INT_INT, DEW_OP_SUB_NUM_NUM);
+				break;
+			}
+			case DEW_OP_MUL: {
+				DEW_ARITH(*, DEW_INTEGER_MUL, "multiply", DEW_OP_MUL_INT_INT, DEW_OP_MUL_NUM_NUM);
+				break;
+			}
+			case DEW_OP_DIV: {
+				DEW_NEED(2);
+				
+				if (top[-1].type == DEW_TYPE_INTEGER && top[-1].asInteger == 0 && top[-2].type == DEW_TYPE_INTEGER) {
+					DEW_FAIL("integer division by zero");
+				}
+				
+				DEW_ARITH(/, DEW_INTEGER_DIV, "divide", DEW_OP_DIV, DEW_OP_DIV_NUM_NUM);
+				break;
+			}
+			case DEW_OP_NEGATE: {
+				DEW_NEED(1);
+				
+				if (top[-1].type == DEW_TYPE_INTEGER) {
+					top[-1].asInteger = DEW_INTEGER_NEGATE(top[-1].asInteger);
+				}
+				else if (top[-1].type == DEW_TYPE_NUMBER) {
+					top[-1].asNumber = -top[-1].asNumber;
+				}
+				else {
+					DEW_FAIL("cannot negate something that isn't an integer or number");
+				}
+				
+				break;
+			}
+			case DEW_OP_NOT: {
+				DEW_NEED(1);
+				top[-1] = dew_value_boolean(!dew_value_truthy(top[-1]));
+				break;
+			}
+			case DEW_OP_EQUAL: {
+				DEW_NEED(2);
+				top--;
+				top[-1] = dew_value_boolean(dew_value_equal(top[-1], top[0]));
+				break;
+			}
+			case DEW_OP_LESS: {
+				DEW_COMPARE(<, DEW_OP_LESS_INT_INT, DEW_OP_LESS_NUM_NUM);
+				break;
+			}
+			case DEW_OP_GREATER: {
+				DEW_COMPARE(>, DEW_OP_GREATER_INT_INT, DEW_OP_GREATER_NUM_NUM);
+				break;
+			}
+			case DEW_OP_JUMP: {
+				DEW_OPERANDS(2);
+				uint16_t offset = DEW_READ_SHORT();
+				DEW_CHECK(offset < end - ip, "jump target out of range");
+				ip += offset;
+				break;
+			}
+			case DEW_OP_JUMP_IF_FALSE: {
+				DEW_OPERANDS(2);
+				DEW_NEED(1);
+				uint16_t offset = DEW_READ_SHORT();
+				DEW_CHECK(offset < end - ip, "jump target out of range");
+				
+				if (!dew_value_truthy(*--top)) {
+					ip += offset;
+				}
+				
+				break;
+			}
+			case DEW_OP_LOOP: {
+				DEW_OPERANDS(2);
+				uint16_t offset = DEW_READ_SHORT();
+				DEW_CHECK(offset <= ip - code, "loop target out of range");
+				ip -= offset;
+				
+				// Only verified chunks are traced, so this is never checked
+				if (!checked && !step && !profile && vm->trace) {
+					size_t header = ip - code;
+					
+					vm->top = top;
+					
+					if (dew_trace_loop(vm, chunk, &header, base)) {
+						return DEW_STATUS_RUNTIME;
+					}
+					
+					top = vm->top;
+					ip = code + header;
+				}
+				
+				break;
+			}
+			case DEW_OP_DEFINE_GLOBAL: {
+				DEW_OPERANDS(1);
+				DEW_CHECK(*ip < chunk->soup.count && soup[*ip].type == DEW_TYPE_STRING, "global name is not a string constant");
+				DEW_NEED(1);
+				dew_globals_define(globals, soup[*ip++].asString, *--top);
+				break;
+			}
+			case DEW_OP_GET_GLOBAL: {
+				DEW_GLOBAL_OPERANDS();
+				DEW_ROOM();
+				dew_Cache *cache = &caches[ip[1]];
+				DEW_CACHED_SLOT(cache);
+				*top++ = *cache->slot;
+				ip += 2;
+				break;
+			}
+			case DEW_OP_SET_GLOBAL: {
+				DEW_GLOBAL_OPERANDS();
+				DEW_NEED(1);
+				dew_Cache *cache = &caches[ip[1]];
+				DEW_CACHED_SLOT(cache);
+				*cache->slot = top[-1];
+				ip += 2;
+				break;
+			}
+			case DEW_OP_CALL_GLOBAL: {
+				DEW_GLOBAL_OPERANDS();
+				DEW_OPERANDS(3);
+				uint8_t argc = ip[2];
+				DEW_NEED(argc);
+				DEW_CHECK(argc || top < vm->stack + DEW_STACK_MAX, "stack overflow");
+				dew_Cache *cache = &caches[ip[1]];
+				DEW_CACHED_SLOT(cache);
+				
+				if (cache->slot->type != DEW_TYPE_NATIVE) {
+					DEW_FAIL("cannot call something that isn't a function");
+				}
+				
+				dew_Value ret;
+				
+				vm->top = top;
+				
+				if (cache->slot->asNative(vm, top - argc, argc, &ret)) {
+					vm->top = base;
+					return DEW_STATUS_RUNTIME;
+				}
+				
+				top -= argc;
+				*top++ = ret;
+				ip += 3;
+				break;
+			}
+			case DEW_OP_ADD_INT_INT: {
+				DEW_SPECIALISED(DEW_OP_ADD, DEW_TYPE_INTEGER, dew_value_integer, DEW_INTEGER_ADD(a.asInteger, b.asInteger));
+				break;
+			}
+			case DEW_OP_ADD_NUM_NUM: {
+				DEW_SPECIALISED(DEW_OP_ADD, DEW_TYPE_NUMBER, dew_value_number, a.asNumber + b.asNumber);
+				break;
+			}
+			case DEW_OP_SUB_INT_INT: {
+				DEW_SPECIALISED(DEW_OP_SUB, DEW_TYPE_INTEGER, dew_value_integer, DEW_INTEGER_SUB(a.asInteger, b.asInteger));
+				break;
+			}
+			case DEW_OP_SUB_NUM_NUM: {
+				DEW_SPECIALISED(DEW_OP_SUB, DEW_TYPE_NUMBER, dew_value_number, a.asNumber - b.asNumber);
+				break;
+			}
+			case DEW_OP_MUL_INT_INT: {
+				DEW_SPECIALISED(DEW_OP_MUL, DEW_TYPE_INTEGER, dew_value_integer, DEW_INTEGER_MUL(a.asInteger, b.asInteger));
+				break;
+			}
+			case DEW_OP_MUL_NUM_NUM: {
+				DEW_SPECIALISED(DEW_OP_MUL, DEW_TYPE_NUMBER, dew_value_number, a.asNumber * b.asNumber);
+				break;
+			}
+			case DEW_OP_DIV_NUM_NUM: {
+				DEW_SPECIALISED(DEW_OP_DIV, DEW_TYPE_NUMBER, dew_value_number, a.asNumber / b.asNumber);
+				break;
+			}
+			case DEW_OP_LESS_INT_INT: {
+				DEW_SPECIALISED(DEW_OP_LESS, DEW_TYPE_INTEGER, dew_value_boolean, a.asInteger < b.asInteger);
+				break;
+			}
+			case DEW_OP_LESS_NUM_NUM: {
+				DEW_SPECIALISED(DEW_OP_LESS, DEW_TYPE_NUMBER, dew_value_boolean, a.asNumber < b.asNumber);
+				break;
+			}
+			case DEW_OP_GREATER_INT_INT: {
+				DEW_SPECIALISED(DEW_OP_GREATER, DEW_TYPE_INTEGER, dew_value_boolean, a.asInteger > b.asInteger);
+				break;
+			}
+			case DEW_OP_GREATER_NUM_NUM: {
+				DEW_SPECIALISED(DEW_OP_GREATER, DEW_TYPE_NUMBER, dew_value_boolean, a.asNumber > b.asNumber);
+				break;
+			}
+			default: {
+				DEW_FAIL("unknown opcode");
+			}
+		}
+		
+		// A deoptimised instruction leaves ip where it was to run again
+		if (step && ip != at) {
+			vm->top = top;
+			*pc = ip - code;
+			return DEW_STATUS_OKAY;
+		}
+	}
+
+#undef DEW_FAIL
+#undef DEW_CHECK
+#undef DEW_NEED
+#undef DEW_ROOM
+#undef DEW_OPERANDS
+#undef DEW_READ_SHORT
+#undef DEW_GLOBAL_OPERANDS
+#undef DEW_CACHED_SLOT
+#undef DEW_QUICKEN
+#undef DEW_ARITH
+#undef DEW_COMPARE
+#undef DEW_SPECIALISED
+}
+
+static dew_Status dew_vm_run_checked(dew_VM *vm, dew_Chunk *chunk, dew_Value *result) {
+	size_t pc = 0;
+	
+	return dew_vm_loop(vm, chunk, result, true, false, false, &pc, vm->top);
+}
+
+static dew_Status dew_vm_run_unchecked(dew_VM *vm, dew_Chunk *chunk, dew_Value *result) {
+	size_t pc = 0;
+	
+	return dew_vm_loop(vm, chunk, result, false, false, false, &pc, vm->top);
+}
+
+static dew_Status dew_vm_run_profiled(dew_VM *vm, dew_Chunk *chunk, dew_Value *result, bool checked) {
+	/**
+	 * Run a chunk on the profiling loop. Checks are decided at run time here
+	 * rather than having a profiled copy of both loops.
+	 */
+	
+	size_t pc = 0;
+	
+	if (!chunk->hits) {
+		chunk->hits = dew_memory(NULL, sizeof *chunk->hits * chunk->count);
+		memset(chunk->hits, 0, sizeof *chunk->hits * chunk->count);
+		
+		if (chunk->profile == DEW_PROFILE_CYCLES) {
+			chunk->cycles = dew_memory(NULL, sizeof *chunk->cycles * chunk->count);
+			memset(chunk->cycles, 0, sizeof *chunk->cycles * chunk->count);
+		}
+	}
+	
+	return dew_vm_loop(vm, chunk, result, checked, false, true, &pc, vm->top);
+}
+
+static dew_Status dew_vm_step(dew_VM *vm, dew_Chunk *chunk, size_t *pc, dew_Value *base) {
+	/**
+	 * Run the one instruction of a verified chunk at *pc, moving *pc on to
+	 * the next instruction to run.
+	 */
+	
+	return dew_vm_loop(vm, chunk, NULL, false, true, false, pc, base);
+}
+
+/**
+ * Tracing
+ */
+
+#define DEW_TRACE_HOT 1000       // Loop iterations before a loop is recorded
+#define DEW_TRACE_MAX 1000       // Longest trace to record, in instructions
+#define DEW_TRACE_ATTEMPTS 4     // Aborted recordings before a loop is left alone
+#define DEW_TRACE_FAILURES 64    // Early exits before a trace can be thrown away
+
+// An unboxed value, booleans are stored as 0 or 1 in i
+typedef union {
+	dew_Integer i;
+	dew_Number n;
+} dew_Raw;
+
+typedef enum {
+	DEW_TRACE_CONST,         // dst = constant
+	DEW_TRACE_MOVE,          // dst = a
+	DEW_TRACE_ADD_INT,       // dst = a op b, where b can be the constant
+	DEW_TRACE_SUB_INT,
+	DEW_TRACE_MUL_INT,
+	DEW_TRACE_ADD_NUM,
+	DEW_TRACE_SUB_NUM,
+	DEW_TRACE_MUL_NUM,
+	DEW_TRACE_DIV_NUM,
+	DEW_TRACE_EQUAL_INT,
+	DEW_TRACE_EQUAL_NUM,
+	DEW_TRACE_LESS_INT,
+	DEW_TRACE_LESS_NUM,
+	DEW_TRACE_GREATER_INT,
+	DEW_TRACE_GREATER_NUM,
+	DEW_TRACE_NEGATE_INT,    // dst = -a
+	DEW_TRACE_NEGATE_NUM,
+	DEW_TRACE_NOT,           // dst = !a
+	DEW_TRACE_GUARD_TRUE,    // take exit unless a is true
+	DEW_TRACE_GUARD_FALSE,   // take exit unless a is false
+	DEW_TRACE_LOOP,          // back to the start of the trace
+} dew_TraceOp;
+
+static const char *dew_trace_op_names[] = {
+	"const", "move",
+	"add_int", "sub_int", "mul_int", "add_num", "sub_num", "mul_num", "div_num",
+	"equal_int", "equal_num", "less_int", "less_num", "greater_int", "greater_num",
+	"negate_int", "negate_num", "not",
+	"guard_true", "guard_false", "loop",
+};
+
+typedef struct {
+	uint8_t op;
+	uint8_t dst;
+	uint8_t a;
+	uint8_t b;
+	bool immediate;     // b is constant rather than a slot
+	dew_Type type;      // Type of the result
+	uint32_t exit;      // Exit taken when a guard fails
+	dew_Raw constant;
+} dew_TraceInstr;
+
+typedef enum {
+	DEW_SNAP_KEEP,      // Slot hasn't changed since the trace was entered
+	DEW_SNAP_REG,       // Slot is in register reg
+	DEW_SNAP_CONST,     // Slot is a known constant
+} dew_SnapKind;
+
+typedef struct {
+	uint8_t kind;
+	uint8_t reg;
+	dew_Type type;
+	dew_Raw constant;
+} dew_SnapSlot;
+
+typedef struct {
+	size_t offset;      // Where the interpreter picks up
+	size_t depth;       // Stack depth there
+	dew_SnapSlot *slots;
+	uint64_t taken;
+} dew_TraceExit;
+
+typedef struct {
+	// Guards checked once on entry, so the loop itself doesn't have to
+	size_t depth;
+	dew_Type *entry;
+	bool *guarded;
+	
+	dew_TraceInstr *code;
+	size_t count;
+	
+	dew_TraceExit *exits;
+	size_t exit_count;
+	
+	// Instructions as recorded, before optimisation
+	size_t recorded;
+	uint64_t entered;
+	
+	// Times a side exit was taken before the trace went once round the loop
+	uint64_t failures;
+} dew_Trace;
+
+struct dew_Loop {
+	uint16_t hotness;
+	uint8_t aborts;
+	dew_Trace *trace;
+};
+
+static void dew_trace_free(dew_Trace *trace) {
+	/**
+	 * Free a trace.
+	 */
+	
+	for (size_t i = 0; i < trace->exit_count; i++) {
+		dew_memory(trace->exits[i].slots, 0);
+	}
+	
+	dew_memory(trace->exits, 0);
+	dew_memory(trace->code, 0);
+	dew_memory(trace->entry, 0);
+	dew_memory(trace->guarded, 0);
+	dew_memory(trace, 0);
+}
+
+static void dew_trace_release(dew_Chunk *chunk) {
+	/**
+	 * Free the loop table and all traces of a chunk.
+	 */
+	
+	if (!chunk->loops) {
+		return;
+	}
+	
+	for (size_t i = 0; i < chunk->count; i++) {
+		if (chunk->loops[i].trace) {
+			dew_trace_free(chunk->loops[i].trace);
+		}
+	}
+	
+	chunk->loops = dew_memory(chunk->loops, 0);
+}
+
+static void dew_trace_emit(dew_Trace *trace, dew_TraceInstr instr) {
+	trace->code = dew_memory(trace->code, sizeof *trace->code * (trace->count + 1));
+	trace->code[trace->count++] = instr;
+}
+
+static uint32_t dew_trace_add_exit(dew_Trace *trace, size_t offset, size_t depth) {
+	trace->exits = dew_memory(trace->exits, sizeof *trace->exits * (trace->exit_count + 1));
+	trace->exits[trace->exit_count] = (dew_TraceExit) {offset, depth, NULL, 0};
+	
+	return trace->exit_count++;
+}
+
+static bool dew_trace_unboxed(dew_Type type) {
+	return type == DEW_TYPE_INTEGER || type == DEW_TYPE_NUMBER || type == DEW_TYPE_BOOLEAN;
+}
+
+static dew_Raw dew_trace_unbox(dew_Value value) {
+	dew_Raw raw;
+	
+	if (value.type == DEW_TYPE_NUMBER) {
+		raw.n = value.asNumber;
+	}
+	else if (value.type == DEW_TYPE_BOOLEAN) {
+		raw.i = value.asBoolean;
+	}
+	else {
+		raw.i = value.asInteger;
+	}
+	
+	return raw;
+}
+
+static dew_Value dew_trace_box(dew_Type type, dew_Raw raw) {
+	switch (type) {
+		case DEW_TYPE_NUMBER: return dew_value_number(raw.n);
+		case DEW_TYPE_BOOLEAN: return dew_value_boolean(raw.i != 0);
+		default: return dew_value_integer(raw.i);
+	}
+}
+
+static uint8_t dew_opcode_generic(uint8_t opcode) {
+	/**
+	 * The generic form of a quickened opcode.
+	 */
+	
+	switch (opcode) {
+		case DEW_OP_ADD_INT_INT:
+		case DEW_OP_ADD_NUM_NUM: return DEW_OP_ADD;
+		case DEW_OP_SUB_INT_INT:
+		case DEW_OP_SUB_NUM_NUM: return DEW_OP_SUB;
+		case DEW_OP_MUL_INT_INT:
+		case DEW_OP_MUL_NUM_NUM: return DEW_OP_MUL;
+		case DEW_OP_DIV_NUM_NUM: return DEW_OP_DIV;
+		case DEW_OP_LESS_INT_INT:
+		case DEW_OP_LESS_NUM_NUM: return DEW_OP_LESS;
+		case DEW_OP_GREATER_INT_INT:
+		case DEW_OP_GREATER_NUM_NUM: return DEW_OP_GREATER;
+		default: return opcode;
+	}
+}
+
+static int dew_trace_binary(uint8_t opcode, dew_Type a, dew_Type b, dew_Type *result) {
+	/**
+	 * Pick the trace instruction for a binary bytecode instruction given the
+	 * types of its operands, or return -1 if there isn't one.
+	 */
+	
+	if (a != b || (a != DEW_TYPE_INTEGER && a != DEW_TYPE_NUMBER)) {
+		return -1;
+	}
+	
+	bool integer = (a == DEW_TYPE_INTEGER);
+	
+	*result = a;
+	
+	switch (opcode) {
+		case DEW_OP_ADD: return integer ? DEW_TRACE_ADD_INT : DEW_TRACE_ADD_NUM;
+		case DEW_OP_SUB: return integer ? DEW_TRACE_SUB_INT : DEW_TRACE_SUB_NUM;
+		case DEW_OP_MUL: return integer ? DEW_TRACE_MUL_INT : DEW_TRACE_MUL_NUM;
+		case DEW_OP_DIV: return integer ? -1 : DEW_TRACE_DIV_NUM;
+		default: break;
+	}
+	
+	*result = DEW_TYPE_BOOLEAN;
+	
+	switch (opcode) {
+		case DEW_OP_EQUAL: return integer ? DEW_TRACE_EQUAL_INT : DEW_TRACE_EQUAL_NUM;
+		case DEW_OP_LESS: return integer ? DEW_TRACE_LESS_INT : DEW_TRACE_LESS_NUM;
+		case DEW_OP_GREATER: return integer ? DEW_TRACE_GREATER_INT : DEW_TRACE_GREATER_NUM;
+		default: return -1;
+	}
+}
+
+static bool dew_trace_reads_b(const dew_TraceInstr *instr) {
+	return instr->op >= DEW_TRACE_ADD_INT && instr->op <= DEW_TRACE_GREATER_NUM && !instr->immediate;
+}
+
+static bool dew_trace_reads_a(const dew_TraceInstr *instr) {
+	return instr->op != DEW_TRACE_CONST && instr->op != DEW_TRACE_LOOP;
+}
+
+static bool dew_trace_writes(const dew_TraceInstr *instr) {
+	return instr->op < DEW_TRACE_GUARD_TRUE;
+}
+
+static bool dew_trace_on_numbers(uint8_t op) {
+	switch (op) {
+		case DEW_TRACE_ADD_NUM:
+		case DEW_TRACE_SUB_NUM:
+		case DEW_TRACE_MUL_NUM:
+		case DEW_TRACE_DIV_NUM:
+		case DEW_TRACE_EQUAL_NUM:
+		case DEW_TRACE_LESS_NUM:
+		case DEW_TRACE_GREATER_NUM:
+		case DEW_TRACE_NEGATE_NUM:
+			return true;
+		default:
+			return false;
+	}
+}
+
+static dew_Raw dew_trace_fold(const dew_TraceInstr *instr, dew_Raw a, dew_Raw b) {
+	/**
+	 * Work out an instruction whose operands are all known.
+	 */
+	
+	dew_Raw r;
+	
+	switch (instr->op) {
+		case DEW_TRACE_MOVE: r = a; break;
+		case DEW_TRACE_ADD_INT: r.i = DEW_INTEGER_ADD(a.i, b.i); break;
+		case DEW_TRACE_SUB_INT: r.i = DEW_INTEGER_SUB(a.i, b.i); break;
+		case DEW_TRACE_MUL_INT: r.i = DEW_INTEGER_MUL(a.i, b.i); break;
+		case DEW_TRACE_ADD_NUM: r.n = a.n + b.n; break;
+		case DEW_TRACE_SUB_NUM: r.n = a.n - b.n; break;
+		case DEW_TRACE_MUL_NUM: r.n = a.n * b.n; break;
+		case DEW_TRACE_DIV_NUM: r.n = a.n / b.n; break;
+		case DEW_TRACE_EQUAL_INT: r.i = a.i == b.i; break;
+		case DEW_TRACE_EQUAL_NUM: r.i = a.n == b.n; break;
+		case DEW_TRACE_LESS_INT: r.i = a.i < b.i; break;
+		case DEW_TRACE_LESS_NUM: r.i = a.n < b.n; break;
+		case DEW_TRACE_GREATER_INT: r.i = a.i > b.i; break;
+		case DEW_TRACE_GREATER_NUM: r.i = a.n > b.n; break;
+		case DEW_TRACE_NEGATE_INT: r.i = DEW_INTEGER_NEGATE(a.i); break;
+		case DEW_TRACE_NEGATE_NUM: r.n = -a.n; break;
+		case DEW_TRACE_NOT: r.i = !a.i; break;
+		default: r = instr->constant; break;
+	}
+	
+	return r;
+}
+
+static void dew_trace_optimise(dew_Trace *trace, const bool *written) {
+	/**
+	 * Optimise a recorded trace in two passes.
+	 * 
+	 * Going forwards, keep track of which slots hold known constants and
+	 * which are copies of another slot. Reads of copies are forwarded to the
+	 * original, instructions on constants are folded, constant right hand
+	 * operands become immediates, and guards on known conditions are dropped
+	 * since they can't fail. Each exit gets a snapshot of where the value of
+	 * every slot is at that point, which can be a constant or a register that
+	 * isn't the slot's own.
+	 * 
+	 * Going backwards, drop instructions whose results are never read by a
+	 * later instruction, an exit, or the next time round the loop, and have
+	 * instructions write straight to the slot their result is moved into
+	 * when the temporary they wrote isn't needed after the move.
+	 */
+	
+	dew_SnapSlot known[DEW_STACK_MAX];
+	
+	for (size_t s = 0; s < DEW_STACK_MAX; s++) {
+		bool changes = s >= trace->depth || written[s];
+		
+		known[s] = (dew_SnapSlot) {changes ? DEW_SNAP_REG : DEW_SNAP_KEEP, s, (s < trace->depth) ? trace->entry[s] : DEW_TYPE_NULL, {0}};
+	}
+	
+	size_t count = 0;
+	
+	for (size_t i = 0; i < trace->count; i++) {
+		dew_TraceInstr instr = trace->code[i];
+		
+		if (instr.op == DEW_TRACE_LOOP) {
+			trace->code[count++] = instr;
+			continue;
+		}
+		
+		// Forward the operands
+		bool const_a = dew_trace_reads_a(&instr) && known[instr.a].kind == DEW_SNAP_CONST;
+		bool const_b = dew_trace_reads_b(&instr) && known[instr.b].kind == DEW_SNAP_CONST;
+		dew_Raw value_a = const_a ? known[instr.a].constant : (dew_Raw) {0};
+		dew_Raw value_b = const_b ? known[instr.b].constant : instr.constant;
+		
+		if (dew_trace_reads_a(&instr) && !const_a) {
+			instr.a = known[instr.a].reg;
+		}
+		
+		if (dew_trace_reads_b(&instr) && !const_b) {
+			instr.b = known[instr.b].reg;
+		}
+		
+		// Moving a slot's value into itself does nothing
+		if (instr.op == DEW_TRACE_MOVE && !const_a && instr.a == instr.dst) {
+			continue;
+		}
+		
+		if (instr.op == DEW_TRACE_GUARD_TRUE || instr.op == DEW_TRACE_GUARD_FALSE) {
+			// The recorded run went this way, so a known condition always will
+			if (const_a) {
+				continue;
+			}
+			
+			dew_TraceExit *exit = &trace->exits[instr.exit];
+			
+			exit->slots = dew_memory(NULL, sizeof *exit->slots * (exit->depth ? exit->depth : 1));
+			
+			memcpy(exit->slots, known, sizeof *exit->slots * exit->depth);
+			
+			trace->code[count++] = instr;
+			continue;
+		}
+		
+		// Everything else writes dst. Slots that were copies of it have their
+		// own value from here on, which their move already put in place.
+		for (size_t s = 0; s < DEW_STACK_MAX; s++) {
+			if (s != instr.dst && known[s].kind == DEW_SNAP_REG && known[s].reg == instr.dst) {
+				known[s].reg = s;
+			}
+		}
+		
+		bool unary = !dew_trace_reads_b(&instr) && !instr.immediate;
+		
+		if (instr.op == DEW_TRACE_CONST || (const_a && (unary || const_b || instr.immediate))) {
+			dew_Raw value = dew_trace_fold(&instr, value_a, value_b);
+			
+			instr = (dew_TraceInstr) {DEW_TRACE_CONST, instr.dst, 0, 0, false, instr.type, 0, value};
+			known[instr.dst] = (dew_SnapSlot) {DEW_SNAP_CONST, instr.dst, instr.type, value};
+		}
+		else if (instr.op == DEW_TRACE_MOVE) {
+			known[instr.dst] = (dew_SnapSlot) {DEW_SNAP_REG, instr.a, instr.type, {0}};
+		}
+		else {
+			if (const_b) {
+				instr.immediate = true;
+				instr.constant = value_b;
+			}
+			
+			known[instr.dst] = (dew_SnapSlot) {DEW_SNAP_REG, instr.dst, instr.type, {0}};
+		}
+		
+		trace->code[count++] = instr;
+	}
+	
+	trace->count = count;
+	
+	// Dead code: slots written by the loop are needed the next time round
+	bool live[DEW_STACK_MAX] = {false};
+	bool *dead = dew_memory(NULL, sizeof *dead * (trace->count + 1));
+	
+	for (size_t s = 0; s < trace->depth; s++) {
+		live[s] = written[s];
+	}
+	
+	for (size_t i = trace->count; i-- > 0;) {
+		dew_TraceInstr *instr = &trace->code[i];
+		
+		dead[i] = false;
+		
+		if (dew_trace_writes(instr)) {
+			if (!live[instr->dst]) {
+				dead[i] = true;
+				continue;
+			}
+			
+			dew_TraceInstr *prev = (i > 0) ? &trace->code[i - 1] : NULL;
+			
+			if (instr->op == DEW_TRACE_MOVE && instr->a >= trace->depth && !live[instr->a] && prev && dew_trace_writes(prev) && prev->dst == instr->a) {
+				prev->dst = instr->dst;
+				dead[i] = true;
+				continue;
+			}
+			
+			live[instr->dst] = false;
+		}
+		else if (instr->op != DEW_TRACE_LOOP) {
+			dew_TraceExit *exit = &trace->exits[instr->exit];
+			
+			for (size_t s = 0; s < exit->depth; s++) {
+				if (exit->slots[s].kind == DEW_SNAP_REG) {
+					live[exit->slots[s].reg] = true;
+				}
+			}
+		}
+		
+		if (dew_trace_reads_a(instr)) {
+			live[instr->a] = true;
+		}
+		
+		if (dew_trace_reads_b(instr)) {
+			live[instr->b] = true;
+		}
+	}
+	
+	count = 0;
+	
+	for (size_t i = 0; i < trace->count; i++) {
+		if (!dead[i]) {
+			trace->code[count++] = trace->code[i];
+		}
+	}
+	
+	trace->count = count;
+	
+	dew_memory(dead, 0);
+}
+
+static dew_Status dew_trace_record(dew_VM *vm, dew_Chunk *chunk, dew_Loop *loop, size_t *pc, dew_Value *base) {
+	/**
+	 * Record a trace of the loop starting at *pc by running one iteration of
+	 * it on the interpreter one instruction at a time, and noting down what
+	 * each instruction did with the types it was given. Recording is given up
+	 * on anything the trace interpreter can't do, like calls and globals.
+	 * Either way, *pc and vm->top are left wherever the interpreter got to.
+	 */
+	
+	size_t header = *pc;
+	size_t depth = vm->top - base;
+	
+	dew_Trace *trace = dew_memory(NULL, sizeof *trace);
+	*trace = (dew_Trace) {.depth = depth};
+	
+	// Static type of every slot as the recording goes, and which of the
+	// slots that were there at the loop header the trace uses or changes
+	dew_Type type[DEW_STACK_MAX];
+	bool touched[DEW_STACK_MAX] = {false};
+	bool written[DEW_STACK_MAX] = {false};
+	
+	trace->entry = dew_memory(NULL, sizeof *trace->entry * (depth + 1));
+	trace->guarded = dew_memory(NULL, sizeof *trace->guarded * (depth + 1));
+	
+	for (size_t s = 0; s < DEW_STACK_MAX; s++) {
+		type[s] = (s < depth) ? base[s].type : DEW_TYPE_NULL;
+	}
+	
+	for (size_t s = 0; s < depth; s++) {
+		trace->entry[s] = type[s];
+		trace->guarded[s] = false;
+	}
+	
+	dew_Status status = DEW_STATUS_OKAY;
+	bool closed = false;
+	bool left = false;
+	
+	for (size_t n = 0; n < DEW_TRACE_MAX && !closed; n++) {
+		const uint8_t *instr = chunk->data + *pc;
+		uint8_t opcode = dew_opcode_generic(instr[0]);
+		size_t d = vm->top - base;
+		size_t at = *pc;
+		dew_TraceInstr record = {DEW_TRACE_MOVE, 0, 0, 0, false, DEW_TYPE_NULL, 0, {0}};
+		bool emit = true;
+		int op;
+		
+		switch (opcode) {
+			case DEW_OP_CONST: {
+				dew_Value value = chunk->soup.data[instr[1]];
+				
+				if (!dew_trace_unboxed(value.type)) {
+					goto abort;
+				}
+				
+				record = (dew_TraceInstr) {DEW_TRACE_CONST, d, 0, 0, false, value.type, 0, dew_trace_unbox(value)};
+				break;
+			}
+			case DEW_OP_POP:
+			case DEW_OP_JUMP:
+			case DEW_OP_NOP: {
+				emit = false;
+				break;
+			}
+			case DEW_OP_GET_LOCAL: {
+				record = (dew_TraceInstr) {DEW_TRACE_MOVE, d, instr[1], 0, false, type[instr[1]], 0, {0}};
+				break;
+			}
+			case DEW_OP_SET_LOCAL: {
+				record = (dew_TraceInstr) {DEW_TRACE_MOVE, instr[1], d - 1, 0, false, type[d - 1], 0, {0}};
+				break;
+			}
+			case DEW_OP_ADD:
+			case DEW_OP_SUB:
+			case DEW_OP_MUL:
+			case DEW_OP_DIV:
+			case DEW_OP_EQUAL:
+			case DEW_OP_LESS:
+			case DEW_OP_GREATER: {
+				dew_Type result;
+				
+				if ((op = dew_trace_binary(opcode, type[d - 2], type[d - 1], &result)) < 0) {
+					goto abort;
+				}
+				
+				record = (dew_TraceInstr) {op, d - 2, d - 2, d - 1, false, result, 0, {0}};
+				break;
+			}
+			case DEW_OP_NEGATE: {
+				if (type[d - 1] != DEW_TYPE_INTEGER && type[d - 1] != DEW_TYPE_NUMBER) {
+					goto abort;
+				}
+				
+				op = (type[d - 1] == DEW_TYPE_INTEGER) ? DEW_TRACE_NEGATE_INT : DEW_TRACE_NEGATE_NUM;
+				record = (dew_TraceInstr) {op, d - 1, d - 1, 0, false, type[d - 1], 0, {0}};
+				break;
+			}
+			case DEW_OP_NOT:
+			case DEW_OP_JUMP_IF_FALSE: {
+				// Only conditions that are already booleans
+				if (type[d - 1] != DEW_TYPE_BOOLEAN) {
+					goto abort;
+				}
+				
+				record = (dew_TraceInstr) {DEW_TRACE_NOT, d - 1, d - 1, 0, false, DEW_TYPE_BOOLEAN, 0, {0}};
+				break;
+			}
+			case DEW_OP_LOOP: {
+				// Inner loops get traces of their own, and going back to
+				// an outer loop means this one finished while recording
+				if (dew_jump_target(chunk, at) != header) {
+					left = dew_jump_target(chunk, at) < header;
+					goto abort;
+				}
+				
+				record = (dew_TraceInstr) {DEW_TRACE_LOOP, 0, 0, 0, false, DEW_TYPE_NULL, 0, {0}};
+				closed = true;
+				break;
+			}
+			default: {
+				goto abort;
+			}
+		}
+		
+		if ((status = dew_vm_step(vm, chunk, pc, base))) {
+			goto abort;
+		}
+		
+		// The condition becomes a guard that the branch goes the same way,
+		// exiting to the way it didn't go
+		if (opcode == DEW_OP_JUMP_IF_FALSE) {
+			bool jumped = (*pc != at + 3);
+			size_t other = jumped ? at + 3 : dew_jump_target(chunk, at);
+			
+			record.op = jumped ? DEW_TRACE_GUARD_FALSE : DEW_TRACE_GUARD_TRUE;
+			record.exit = dew_trace_add_exit(trace, other, d - 1);
+		}
+		
+		if (!emit) {
+			continue;
+		}
+		
+		if (dew_trace_reads_a(&record) && record.a < depth) {
+			touched[record.a] = true;
+		}
+		
+		if (dew_trace_reads_b(&record) && record.b < depth) {
+			touched[record.b] = true;
+		}
+		
+		if (dew_trace_writes(&record)) {
+			type[record.dst] = record.type;
+			
+			if (record.dst < depth) {
+				touched[record.dst] = written[record.dst] = true;
+			}
+		}
+		
+		dew_trace_emit(trace, record);
+	}
+	
+	if (!closed) {
+		goto abort;
+	}
+	
+	// Slots the trace uses are guarded on entry, which only works if each
+	// one can be unboxed and has the same type every time round the loop
+	for (size_t s = 0; s < depth; s++) {
+		if (!touched[s]) {
+			continue;
+		}
+		
+		if (!dew_trace_unboxed(trace->entry[s]) || (written[s] && type[s] != trace->entry[s])) {
+			goto abort;
+		}
+		
+		trace->guarded[s] = true;
+	}
+	
+	trace->recorded = trace->count;
+	
+	dew_trace_optimise(trace, written);
+	
+	loop->trace = trace;
+	chunk->traces_recorded++;
+	
+	return DEW_STATUS_OKAY;
+
+abort:
+	dew_trace_free(trace);
+	
+	// A loop that only ran out of iterations is tried again the next time
+	// it is entered rather than counted against it
+	if (left) {
+		loop->hotness = DEW_TRACE_HOT - 1;
+	}
+	else {
+		loop->hotness = 0;
+		loop->aborts++;
+	}
+	
+	chunk->traces_aborted++;
+	
+	return status;
+}
+
+static bool dew_trace_run(dew_Chunk *chunk, dew_Trace *trace, size_t *pc, dew_Value *base, dew_Value **top) {
+	/**
+	 * Run a trace until one of its guards fails, then write the slots that
+	 * changed back to the stack and point *pc at where the interpreter
+	 * should carry on. Returns false without doing anything if the entry
+	 * guards don't hold.
+	 */
+	
+	if ((size_t) (*top - base) != trace->depth) {
+		return false;
+	}
+	
+	dew_Raw reg[DEW_STACK_MAX];
+	
+	for (size_t s = 0; s < trace->depth; s++) {
+		if (trace->guarded[s]) {
+			if (base[s].type != trace->entry[s]) {
+				return false;
+			}
+			
+			reg[s] = dew_trace_unbox(base[s]);
+		}
+	}
+	
+	trace->entered++;
+	
+	const dew_TraceInstr *code = trace->code;
+	const dew_TraceInstr *in = code;
+	dew_TraceExit *exit = NULL;
+	bool looped = false;
+
+#define DEW_B (in->immediate ? in->constant : reg[in->b])
+
+	while (!exit) {
+		switch (in->op) {
+			case DEW_TRACE_CONST: reg[in->dst] = in->constant; break;
+			case DEW_TRACE_MOVE: reg[in->dst] = reg[in->a]; break;
+			case DEW_TRACE_ADD_INT: reg[in->dst].i = DEW_INTEGER_ADD(reg[in->a].i, DEW_B.i); break;
+			case DEW_TRACE_SUB_INT: reg[in->dst].i = DEW_INTEGER_SUB(reg[in->a].i, DEW_B.i); break;
+			case DEW_TRACE_MUL_INT: reg[in->dst].i = DEW_INTEGER_MUL(reg[in->a].i, DEW_B.i); break;
+			case DEW_TRACE_ADD_NUM: reg[in->dst].n = reg[in->a].n + DEW_B.n; break;
+			case DEW_TRACE_SUB_NUM: reg[in->dst].n = reg[in->a].n - DEW_B.n; break;
+			case DEW_TRACE_MUL_NUM: reg[in->dst].n = reg[in->a].n * DEW_B.n; break;
+			case DEW_TRACE_DIV_NUM: reg[in->dst].n = reg[in->a].n / DEW_B.n; break;
+			case DEW_TRACE_EQUAL_INT: reg[in->dst].i = reg[in->a].i == DEW_B.i; break;
+			case DEW_TRACE_EQUAL_NUM: reg[in->dst].i = reg[in->a].n == DEW_B.n; break;
+			case DEW_TRACE_LESS_INT: reg[in->dst].i = reg[in->a].i < DEW_B.i; break;
+			case DEW_TRACE_LESS_NUM: reg[in->dst].i = reg[in->a].n < DEW_B.n; break;
+			case DEW_TRACE_GREATER_INT: reg[in->dst].i = reg[in->a].i > DEW_B.i; break;
+			case DEW_TRACE_GREATER_NUM: reg[in->dst].i = reg[in->a].n > DEW_B.n; break;
+			case DEW_TRACE_NEGATE_INT: reg[in->dst].i = DEW_INTEGER_NEGATE(reg[in->a].i); break;
+			case DEW_TRACE_NEGATE_NUM: reg[in->dst].n = -reg[in->a].n; break;
+			case DEW_TRACE_NOT: reg[in->dst].i = !reg[in->a].i; break;
+			case DEW_TRACE_GUARD_TRUE: {
+				if (!reg[in->a].i) {
+					exit = &trace->exits[in->exit];
+				}
+				
+				break;
+			}
+			case DEW_TRACE_GUARD_FALSE: {
+				if (reg[in->a].i) {
+					exit = &trace->exits[in->exit];
+				}
+				
+				break;
+			}
+			case DEW_TRACE_LOOP: {
+				in = code;
+				looped = true;
+				continue;
+			}
+		}
+		
+		in++;
+	}
+
+#undef DEW_B
+
+	for (size_t s = 0; s < exit->depth; s++) {
+		dew_SnapSlot *slot = &exit->slots[s];
+		
+		if (slot->kind == DEW_SNAP_REG) {
+			base[s] = dew_trace_box(slot->type, reg[slot->reg]);
+		}
+		else if (slot->kind == DEW_SNAP_CONST) {
+			base[s] = dew_trace_box(slot->type, slot->constant);
+		}
+	}
+	
+	*top = base + exit->depth;
+	*pc = exit->offset;
+	
+	exit->taken++;
+	chunk->trace_exits++;
+	
+	if (!looped) {
+		trace->failures++;
+	}
+	
+	return true;
+}
+
+static dew_Status dew_trace_loop(dew_VM *vm, dew_Chunk *chunk, size_t *pc, dew_Value *base) {
+	/**
+	 * Called by the interpreter each time a loop goes back to its header at
+	 * *pc. Runs the loop's trace if it has one, or counts towards recording
+	 * one if it doesn't.
+	 */
+	
+	if (!chunk->loops) {
+		chunk->loops = dew_memory(NULL, sizeof *chunk->loops * chunk->count);
+		memset(chunk->loops, 0, sizeof *chunk->loops * chunk->count);
+	}
+	
+	dew_Loop *loop = &chunk->loops[*pc];
+	
+	if (!loop->trace) {
+		if (loop->aborts >= DEW_TRACE_ATTEMPTS || ++loop->hotness < DEW_TRACE_HOT) {
+			return DEW_STATUS_OKAY;
+		}
+		
+		dew_Status status = dew_trace_record(vm, chunk, loop, pc, base);
+		
+		// Recording stops back at the header if it worked
+		if (status || !loop->trace) {
+			return status;
+		}
+	}
+	
+	dew_Trace *trace = loop->trace;
+	
+	dew_trace_run(chunk, trace, pc, base, &vm->top);
+	
+	// A trace that mostly leaves by a side exit before getting round the loop
+	// is slower than not having one, since the interpreter runs the rest of
+	// the iteration and then enters it again. Throw it away for good.
+	if (trace->failures >= DEW_TRACE_FAILURES && trace->failures * 2 > trace->entered) {
+		dew_trace_free(trace);
+		loop->trace = NULL;
+		loop->aborts = DEW_TRACE_ATTEMPTS;
+		chunk->traces_blacklisted++;
+	}
+	
+	return DEW_STATUS_OKAY;
+}
+
+void dew_chunk_dissassemble_traces(dew_Chunk *chunk) {
+	/**
+	 * Print the traces recorded for a chunk, with how often each was entered
+	 * and left by each of its exits.
+	 */
+	
+	printf("## traces: %" PRIu64 " recorded, %" PRIu64 " aborted, %" PRIu64 " blacklisted, %" PRIu64 " exits taken ##\n", chunk->traces_recorded, chunk->traces_aborted, chunk->traces_blacklisted, chunk->trace_exits);
+	
+	for (size_t i = 0; chunk->loops && i < chunk->count; i++) {
+		dew_Trace *trace = chunk->loops[i].trace;
+		
+		if (!trace) {
+			continue;
+		}
+		
+		printf("trace at %.4zX: %zu instructions recorded, %zu after optimisation, entered %" PRIu64 " times\n", i, trace->recorded, trace->count, trace->entered);
+		
+		for (size_t s = 0; s < trace->depth; s++) {
+			if (trace->guarded[s]) {
+				printf("  guard  s%zu is %s\n", s, trace->entry[s] == DEW_TYPE_INTEGER ? "integer" : trace->entry[s] == DEW_TYPE_NUMBER ? "number" : "boolean");
+			}
+		}
+		
+		for (size_t j = 0; j < trace->count; j++) {
+			dew_TraceInstr *instr = &trace->code[j];
+			
+			printf("  %.4zX  %-12s", j, dew_trace_op_names[instr->op]);
+			
+			if (dew_trace_writes(instr)) {
+				printf(" s%u", instr->dst);
+			}
+			
+			if (dew_trace_reads_a(instr)) {
+				printf(" s%u", instr->a);
+			}
+			
+			if (dew_trace_reads_b(instr)) {
+				printf(" s%u", instr->b);
+			}
+			
+			if (instr->op == DEW_TRACE_CONST || instr->immediate) {
+				bool number = (instr->op == DEW_TRACE_CONST) ? instr->type == DEW_TYPE_NUMBER : dew_trace_on_numbers(instr->op);
+				
+				if (number) {
+					printf(" %g", instr->constant.n);
+				}
+				else {
+					printf(" %" PRId64, instr->constant.i);
+				}
+			}
+			
+			if (instr->op == DEW_TRACE_GUARD_TRUE || instr->op == DEW_TRACE_GUARD_FALSE) {
+				dew_TraceExit *exit = &trace->exits[instr->exit];
+				
+				printf(" -> %.4zX (taken %" PRIu64 ")", exit->offset, exit->taken);
+			}
+			
+			printf("\n");
+		}
+	}
+}
+
+/**
+ * JIT
+ */
+
+#ifdef DEW_VMX_JIT
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+typedef enum {
+	DEW_HOLE_CONTINUE,  // Next instruction
+	DEW_HOLE_TARGET,    // Jump target
+	DEW_HOLE_SLOW,      // Out of line copy of the step stencil for this instruction
+	DEW_HOLE_OPERAND,
+	DEW_HOLE_OPERAND2,
+	DEW_HOLE_CHUNK,
+	DEW_HOLE_OFFSET,    // Offset of the instruction in the chunk
+	DEW_HOLE_STEP,      // dew_jit_step
+	DEW_HOLE_CACHE,     // Inline cache of a global instruction
+} dew_HoleKind;
+
+typedef struct {
+	uint32_t offset;
+	dew_HoleKind kind;
+	int64_t addend;
+} dew_Hole;
+
+typedef struct {
+	const uint8_t *code;
+	size_t size;
+	const dew_Hole *holes;
+	size_t hole_count;
+} dew_Stencil;
+
+typedef dew_Status (*dew_JitEntry)(dew_VM *vm, dew_Value *base, dew_Value *top);
+
+#include "dew_stencils.h"
+
+static dew_Value *dew_jit_step(dew_VM *vm, dew_Chunk *chunk, size_t offset, dew_Value *base, dew_Value *top) {
+	/**
+	 * Called from compiled code to run one instruction on the interpreter.
+	 * Returns the new stack top, or NULL if the instruction failed.
+	 */
+	
+	vm->top = top;
+	
+	if (dew_vm_step(vm, chunk, &offset, base)) {
+		return NULL;
+	}
+	
+	return vm->top;
+}
+
+static const dew_Stencil *dew_jit_stencil(uint8_t opcode) {
+	/**
+	 * Pick the stencil for an opcode. The quickened forms share the stencil
+	 * of their generic form, which checks for both common cases anyway.
+	 */
+	
+	switch (opcode) {
+		case DEW_OP_NOP: return NULL;
+		case DEW_OP_RET: return &dew_stencil_RET;
+		case DEW_OP_CONST: return &dew_stencil_CONST;
+		case DEW_OP_POP: return &dew_stencil_POP;
+		case DEW_OP_GET_LOCAL: return &dew_stencil_GET_LOCAL;
+		case DEW_OP_SET_LOCAL: return &dew_stencil_SET_LOCAL;
+		case DEW_OP_GET_GLOBAL: return &dew_stencil_GET_GLOBAL;
+		case DEW_OP_SET_GLOBAL: return &dew_stencil_SET_GLOBAL;
+		case DEW_OP_ADD:
+		case DEW_OP_ADD_INT_INT:
+		case DEW_OP_ADD_NUM_NUM: return &dew_stencil_ADD;
+		case DEW_OP_SUB:
+		case DEW_OP_SUB_INT_INT:
+		case DEW_OP_SUB_NUM_NUM: return &dew_stencil_SUB;
+		case DEW_OP_MUL:
+		case DEW_OP_MUL_INT_INT:
+		case DEW_OP_MUL_NUM_NUM: return &dew_stencil_MUL;
+		case DEW_OP_LESS:
+		case DEW_OP_LESS_INT_INT:
+		case DEW_OP_LESS_NUM_NUM: return &dew_stencil_LESS;
+		case DEW_OP_GREATER:
+		case DEW_OP_GREATER_INT_INT:
+		case DEW_OP_GREATER_NUM_NUM: return &dew_stencil_GREATER;
+		case DEW_OP_NOT: return &dew_stencil_NOT;
+		case DEW_OP_JUMP:
+		case DEW_OP_LOOP: return &dew_stencil_JUMP;
+		case DEW_OP_JUMP_IF_FALSE: return &dew_stencil_JUMP_IF_FALSE;
+		default: return &dew_stencil_STEP;
+	}
+}
+
+static size_t dew_jit_slow_size(const dew_Stencil *stencil) {
+	/**
+	 * Size of the out of line step stencil an instruction needs, if any.
+	 */
+	
+	for (size_t i = 0; stencil && i < stencil->hole_count; i++) {
+		if (stencil->holes[i].kind == DEW_HOLE_SLOW) {
+			return dew_stencil_STEP.size;
+		}
+	}
+	
+	return 0;
+}
+
+static void dew_jit_emit(uint8_t *code, size_t at, const dew_Stencil *stencil, dew_Chunk *chunk, size_t offset, const size_t *position, size_t next, size_t slow) {
+	/**
+	 * Copy a stencil for the instruction at offset into the code at at and
+	 * fill in its holes. position maps chunk offsets to offsets in the code,
+	 * next is where control goes after this instruction and slow is where
+	 * its out of line step stencil is.
+	 */
+	
+	const uint8_t *instr = chunk->data + offset;
+	
+	memcpy(code + at, stencil->code, stencil->size);
+	
+	for (size_t i = 0; i < stencil->hole_count; i++) {
+		const dew_Hole *hole = &stencil->holes[i];
+		uint64_t value = 0;
+		
+		switch (hole->kind) {
+			case DEW_HOLE_CONTINUE: value = (uintptr_t) (code + next); break;
+			case DEW_HOLE_TARGET: value = (uintptr_t) (code + position[dew_jump_target(chunk, offset)]); break;
+			case DEW_HOLE_SLOW: value = (uintptr_t) (code + slow); break;
+			case DEW_HOLE_CHUNK: value = (uintptr_t) chunk; break;
+			case DEW_HOLE_OFFSET: value = offset; break;
+			case DEW_HOLE_STEP: value = (uintptr_t) dew_jit_step; break;
+			case DEW_HOLE_CACHE: value = (uintptr_t) &chunk->caches[instr[2]]; break;
+			case DEW_HOLE_OPERAND: {
+				if (instr[0] == DEW_OP_CONST) {
+					value = chunk->soup.data[instr[1]].type;
+				}
+				else {
+					value = instr[1];
+				}
+				
+				break;
+			}
+			case DEW_HOLE_OPERAND2: {
+				// The raw bits of the constant, whatever its type
+				memcpy(&value, &chunk->soup.data[instr[1]].asInteger, sizeof value);
+				break;
+			}
+		}
+		
+		value += hole->addend;
+		memcpy(code + at + hole->offset, &value, sizeof value);
+	}
+}
+
+dew_Status dew_jit_compile(dew_Chunk *chunk) {
+	/**
+	 * Compile a verified chunk to machine code. The code is written while the
+	 * memory is writable and then made executable, and is never both.
+	 * 
+	 * Chunks where most instructions have no stencil of their own are turned
+	 * down, since calling out to the interpreter for each of those is slower
+	 * than staying on it.
+	 */
+	
+	if (!chunk->verified) {
+		return DEW_STATUS_VERIFY;
+	}
+	
+	dew_jit_release(chunk);
+	
+	size_t instructions = 0;
+	size_t steps = 0;
+	
+	for (size_t i = 0; i < chunk->count; i += dew_opcode_length(chunk->data[i])) {
+		const dew_Stencil *stencil = dew_jit_stencil(chunk->data[i]);
+		
+		instructions += (stencil != NULL);
+		steps += (stencil == &dew_stencil_STEP);
+	}
+	
+	if (steps * 2 > instructions) {
+		chunk->jit_declined = true;
+		return DEW_STATUS_UNSUPPORTED;
+	}
+	
+	// Where each instruction's code starts. The out of line step stencils
+	// go after all of them, and the verifier makes sure control never runs
+	// off the end, so nothing ever falls through into those.
+	size_t *position = dew_memory(NULL, sizeof *position * (chunk->count + 1));
+	size_t size = 0;
+	size_t slow_size = 0;
+	
+	for (size_t i = 0; i < chunk->count; i += dew_opcode_length(chunk->data[i])) {
+		const dew_Stencil *stencil = dew_jit_stencil(chunk->data[i]);
+		
+		position[i] = size;
+		size += stencil ? stencil->size : 0;
+		slow_size += dew_jit_slow_size(stencil);
+	}
+	
+	position[chunk->count] = size;
+	
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t mapped = (size + slow_size + page - 1) / page * page;
+	uint8_t *code = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	
+	if (code == MAP_FAILED) {
+		dew_memory(position, 0);
+		return DEW_STATUS_UNSUPPORTED;
+	}
+	
+	size_t slow = size;
+	
+	for (size_t i = 0; i < chunk->count;) {
+		const dew_Stencil *stencil = dew_jit_stencil(chunk->data[i]);
+		size_t next = i + dew_opcode_length(chunk->data[i]);
+		
+		if (stencil) {
+			dew_jit_emit(code, position[i], stencil, chunk, i, position, position[next], slow);
+		}
+		
+		if (dew_jit_slow_size(stencil)) {
+			dew_jit_emit(code, slow, &dew_stencil_STEP, chunk, i, position, position[next], 0);
+			slow += dew_stencil_STEP.size;
+		}
+		
+		i = next;
+	}
+	
+	dew_memory(position, 0);
+	
+	if (mprotect(code, mapped, PROT_READ | PROT_EXEC)) {
+		munmap(code, mapped);
+		return DEW_STATUS_UNSUPPORTED;
+	}
+	
+	chunk->jit_code = code;
+	chunk->jit_size = mapped;
+	
+	return DEW_STATUS_OKAY;
+}
+
+void dew_jit_release(dew_Chunk *chunk) {
+	/**
+	 * Free a chunk's machine code, if it has any.
+	 */
+	
+	if (chunk->jit_code) {
+		munmap(chunk->jit_code, chunk->jit_size);
+	}
+	
+	chunk->jit_code = NULL;
+	chunk->jit_size = 0;
+}
+
+static dew_Status dew_vm_run_jit(dew_VM *vm, dew_Chunk *chunk, dew_Value *result) {
+	/**
+	 * Run a chunk's machine code. Errors from instructions run on the
+	 * interpreter have already set vm->error and reset the stack.
+	 */
+	
+	dew_Value *base = vm->top;
+	dew_Status status = ((dew_JitEntry) (uintptr_t) chunk->jit_code)(vm, base, base);
+	
+	if (status) {
+		return status;
+	}
+	
+	if (result) {
+		*result = (vm->top > base) ? vm->top[-1] : dew_value_null();
+	}
+	
+	vm->top = base;
+	
+	return DEW_STATUS_OKAY;
+}
+
+#else
+
+dew_Status dew_jit_compile(dew_Chunk *chunk) {
+	/**
+	 * There is no JIT for this platform.
+	 */
+	
+	(void) chunk;
+	
+	return DEW_STATUS_UNSUPPORTED;
+}
+
+void dew_jit_release(dew_Chunk *chunk) {
+	chunk->jit_code = NULL;
+	chunk->jit_size = 0;
+}
+
+static dew_Status dew_vm_run_jit(dew_VM *vm, dew_Chunk *chunk, dew_Value *result) {
+	return dew_vm_run_unchecked(vm, chunk, result);
+}
+
+#endif
+
+dew_Status dew_vm_run(dew_VM *vm, dew_Chunk *chunk, dew_Value *result) {
+	/**
+	 * Run a chunk to completion. Verified chunks run as machine code if the
+	 * JIT is on, otherwise on the unchecked loop, as long as there is room
+	 * for their whole stack. Everything else runs on the checked loop, and
+	 * chunks being profiled always run on the profiling loop.
+	 */
+	
+	vm->error = (dew_Error) {0, NULL};
+	
+	bool unchecked = chunk->verified && (size_t) (vm->stack + DEW_STACK_MAX - vm->top) >= chunk->max_stack;
+	
+	if (chunk->profile) {
+		return dew_vm_run_profiled(vm, chunk, result, !unchecked);
+	}
+	
+	if (unchecked) {
+		if (vm->jit && !chunk->jit_code && !chunk->jit_declined) {
+			dew_jit_compile(chunk);
+		}
+		
+		if (chunk->jit_code) {
+			return dew_vm_run_jit(vm, chunk, result);
+		}
+		
+		return dew_vm_run_unchecked(vm, chunk, result);
+	}
+	
+	return dew_vm_run_checked(vm, chunk, result);
 }
 
 #endif
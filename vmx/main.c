@@ -3,19 +3,590 @@
  */
 
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 
 #define DEW_VMX_IMPLEMENTATION
 #include "dew.h"
 
+static void write_count_loop(dew_Chunk *chunk, dew_Integer limit) {
+	/**
+	 * Assemble a loop that sums the integers below limit:
+	 * 
+	 *   i = 0; sum = 0;
+	 *   while (i < limit) { sum = sum + i; i = i + 1; }
+	 *   return sum;
+	 */
+	
+	uint8_t zero = dew_chunk_add_constant(chunk, dew_value_integer(0));
+	uint8_t one = dew_chunk_add_constant(chunk, dew_value_integer(1));
+	uint8_t max = dew_chunk_add_constant(chunk, dew_value_integer(limit));
+	
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, zero);  // i
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, zero);  // sum
+	
+	size_t start = chunk->count;
+	
+	dew_chunk_write(chunk, DEW_OP_GET_LOCAL); dew_chunk_write(chunk, 0);
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, max);
+	dew_chunk_write(chunk, DEW_OP_LESS);
+	
+	size_t exit = dew_chunk_write_jump(chunk, DEW_OP_JUMP_IF_FALSE);
+	
+	dew_chunk_write(chunk, DEW_OP_GET_LOCAL); dew_chunk_write(chunk, 1);
+	dew_chunk_write(chunk, DEW_OP_GET_LOCAL); dew_chunk_write(chunk, 0);
+	dew_chunk_write(chunk, DEW_OP_ADD);
+	dew_chunk_write(chunk, DEW_OP_SET_LOCAL); dew_chunk_write(chunk, 1);
+	dew_chunk_write(chunk, DEW_OP_POP);
+	
+	dew_chunk_write(chunk, DEW_OP_GET_LOCAL); dew_chunk_write(chunk, 0);
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, one);
+	dew_chunk_write(chunk, DEW_OP_ADD);
+	dew_chunk_write(chunk, DEW_OP_SET_LOCAL); dew_chunk_write(chunk, 0);
+	dew_chunk_write(chunk, DEW_OP_POP);
+	
+	dew_chunk_write_loop(chunk, start);
+	dew_chunk_patch_jump(chunk, exit);
+	
+	dew_chunk_write(chunk, DEW_OP_GET_LOCAL); dew_chunk_write(chunk, 1);
+	dew_chunk_write(chunk, DEW_OP_RET);
+}
+
+static void write_global_loop(dew_Chunk *chunk, dew_Integer limit) {
+	/**
+	 * The same loop as write_count_loop, but everything is a global, and the
+	 * result is printed:
+	 * 
+	 *   i = 0; sum = 0; limit = ...;
+	 *   while (i < limit) { sum = sum + i; i = i + 1; }
+	 *   print("sum: ", sum, "\n");
+	 */
+	
+	uint8_t zero = dew_chunk_add_constant(chunk, dew_value_integer(0));
+	uint8_t one = dew_chunk_add_constant(chunk, dew_value_integer(1));
+	uint8_t max = dew_chunk_add_constant(chunk, dew_value_integer(limit));
+	uint8_t label = dew_chunk_add_constant(chunk, dew_value_string("sum: "));
+	uint8_t newline = dew_chunk_add_constant(chunk, dew_value_string("\n"));
+	
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, zero);
+	dew_chunk_write_global(chunk, DEW_OP_DEFINE_GLOBAL, "i");
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, zero);
+	dew_chunk_write_global(chunk, DEW_OP_DEFINE_GLOBAL, "sum");
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, max);
+	dew_chunk_write_global(chunk, DEW_OP_DEFINE_GLOBAL, "limit");
+	
+	size_t start = chunk->count;
+	
+	dew_chunk_write_global(chunk, DEW_OP_GET_GLOBAL, "i");
+	dew_chunk_write_global(chunk, DEW_OP_GET_GLOBAL, "limit");
+	dew_chunk_write(chunk, DEW_OP_LESS);
+	
+	size_t exit = dew_chunk_write_jump(chunk, DEW_OP_JUMP_IF_FALSE);
+	
+	dew_chunk_write_global(chunk, DEW_OP_GET_GLOBAL, "sum");
+	dew_chunk_write_global(chunk, DEW_OP_GET_GLOBAL, "i");
+	dew_chunk_write(chunk, DEW_OP_ADD);
+	dew_chunk_write_global(chunk, DEW_OP_SET_GLOBAL, "sum");
+	dew_chunk_write(chunk, DEW_OP_POP);
+	
+	dew_chunk_write_global(chunk, DEW_OP_GET_GLOBAL, "i");
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, one);
+	dew_chunk_write(chunk, DEW_OP_ADD);
+	dew_chunk_write_global(chunk, DEW_OP_SET_GLOBAL, "i");
+	dew_chunk_write(chunk, DEW_OP_POP);
+	
+	dew_chunk_write_loop(chunk, start);
+	dew_chunk_patch_jump(chunk, exit);
+	
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, label);
+	dew_chunk_write_global(chunk, DEW_OP_GET_GLOBAL, "sum");
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, newline);
+	dew_chunk_write_global(chunk, DEW_OP_CALL_GLOBAL, "print");
+	dew_chunk_write(chunk, 3);
+	dew_chunk_write(chunk, DEW_OP_RET);
+}
+
+static void write_set_local(dew_Chunk *chunk, uint8_t slot, uint8_t constant) {
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, constant);
+	dew_chunk_write(chunk, DEW_OP_SET_LOCAL); dew_chunk_write(chunk, slot);
+	dew_chunk_write(chunk, DEW_OP_POP);
+}
+
+static void write_binary_to_local(dew_Chunk *chunk, uint8_t dest, uint8_t a, uint8_t op, uint8_t b) {
+	dew_chunk_write(chunk, DEW_OP_GET_LOCAL); dew_chunk_write(chunk, a);
+	dew_chunk_write(chunk, DEW_OP_GET_LOCAL); dew_chunk_write(chunk, b);
+	dew_chunk_write(chunk, op);
+	dew_chunk_write(chunk, DEW_OP_SET_LOCAL); dew_chunk_write(chunk, dest);
+	dew_chunk_write(chunk, DEW_OP_POP);
+}
+
+static void write_fib_loop(dew_Chunk *chunk, dew_Integer rounds, dew_Integer n) {
+	/**
+	 * The fib loop from the README, run rounds times over:
+	 * 
+	 *   for (r = 0; r < rounds; r++) {
+	 *     i = 0; j = 1;
+	 *     for (k = 0; k < n; k++) { j = i + j; i = i + j; }
+	 *   }
+	 *   return i;
+	 */
+	
+	uint8_t zero = dew_chunk_add_constant(chunk, dew_value_integer(0));
+	uint8_t one = dew_chunk_add_constant(chunk, dew_value_integer(1));
+	uint8_t max_r = dew_chunk_add_constant(chunk, dew_value_integer(rounds));
+	uint8_t max_k = dew_chunk_add_constant(chunk, dew_value_integer(n));
+	
+	// Slots: r, i, j, k, and the constant 1
+	for (int i = 0; i < 4; i++) {
+		dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, zero);
+	}
+	
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, one);
+	
+	size_t outer = chunk->count;
+	
+	dew_chunk_write(chunk, DEW_OP_GET_LOCAL); dew_chunk_write(chunk, 0);
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, max_r);
+	dew_chunk_write(chunk, DEW_OP_LESS);
+	
+	size_t exit = dew_chunk_write_jump(chunk, DEW_OP_JUMP_IF_FALSE);
+	
+	write_set_local(chunk, 1, zero);
+	write_set_local(chunk, 2, one);
+	write_set_local(chunk, 3, zero);
+	
+	size_t inner = chunk->count;
+	
+	dew_chunk_write(chunk, DEW_OP_GET_LOCAL); dew_chunk_write(chunk, 3);
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, max_k);
+	dew_chunk_write(chunk, DEW_OP_LESS);
+	
+	size_t done = dew_chunk_write_jump(chunk, DEW_OP_JUMP_IF_FALSE);
+	
+	write_binary_to_local(chunk, 2, 1, DEW_OP_ADD, 2);
+	write_binary_to_local(chunk, 1, 1, DEW_OP_ADD, 2);
+	write_binary_to_local(chunk, 3, 3, DEW_OP_ADD, 4);
+	
+	dew_chunk_write_loop(chunk, inner);
+	dew_chunk_patch_jump(chunk, done);
+	
+	write_binary_to_local(chunk, 0, 0, DEW_OP_ADD, 4);
+	
+	dew_chunk_write_loop(chunk, outer);
+	dew_chunk_patch_jump(chunk, exit);
+	
+	dew_chunk_write(chunk, DEW_OP_GET_LOCAL); dew_chunk_write(chunk, 1);
+	dew_chunk_write(chunk, DEW_OP_RET);
+}
+
+static void write_poly_loop(dew_Chunk *chunk, dew_Integer n) {
+	/**
+	 * Arithmetic on numbers in a loop, which settles on 2.5:
+	 * 
+	 *   x = 0.0;
+	 *   for (k = 0; k < n; k++) { x = (x * 0.9 + 1.5) * 0.5 + x * 0.25; }
+	 *   return x;
+	 */
+	
+	uint8_t zero = dew_chunk_add_constant(chunk, dew_value_integer(0));
+	uint8_t one = dew_chunk_add_constant(chunk, dew_value_integer(1));
+	uint8_t max_k = dew_chunk_add_constant(chunk, dew_value_integer(n));
+	uint8_t start_x = dew_chunk_add_constant(chunk, dew_value_number(0.0));
+	uint8_t a = dew_chunk_add_constant(chunk, dew_value_number(0.9));
+	uint8_t b = dew_chunk_add_constant(chunk, dew_value_number(1.5));
+	uint8_t c = dew_chunk_add_constant(chunk, dew_value_number(0.5));
+	uint8_t d = dew_chunk_add_constant(chunk, dew_value_number(0.25));
+	
+	// Slots: k, x
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, zero);
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, start_x);
+	
+	size_t loop = chunk->count;
+	
+	dew_chunk_write(chunk, DEW_OP_GET_LOCAL); dew_chunk_write(chunk, 0);
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, max_k);
+	dew_chunk_write(chunk, DEW_OP_LESS);
+	
+	size_t exit = dew_chunk_write_jump(chunk, DEW_OP_JUMP_IF_FALSE);
+	
+	dew_chunk_write(chunk, DEW_OP_GET_LOCAL); dew_chunk_write(chunk, 1);
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, a);
+	dew_chunk_write(chunk, DEW_OP_MUL);
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, b);
+	dew_chunk_write(chunk, DEW_OP_ADD);
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, c);
+	dew_chunk_write(chunk, DEW_OP_MUL);
+	dew_chunk_write(chunk, DEW_OP_GET_LOCAL); dew_chunk_write(chunk, 1);
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, d);
+	dew_chunk_write(chunk, DEW_OP_MUL);
+	dew_chunk_write(chunk, DEW_OP_ADD);
+	dew_chunk_write(chunk, DEW_OP_SET_LOCAL); dew_chunk_write(chunk, 1);
+	dew_chunk_write(chunk, DEW_OP_POP);
+	
+	dew_chunk_write(chunk, DEW_OP_GET_LOCAL); dew_chunk_write(chunk, 0);
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, one);
+	dew_chunk_write(chunk, DEW_OP_ADD);
+	dew_chunk_write(chunk, DEW_OP_SET_LOCAL); dew_chunk_write(chunk, 0);
+	dew_chunk_write(chunk, DEW_OP_POP);
+	
+	dew_chunk_write_loop(chunk, loop);
+	dew_chunk_patch_jump(chunk, exit);
+	
+	dew_chunk_write(chunk, DEW_OP_GET_LOCAL); dew_chunk_write(chunk, 1);
+	dew_chunk_write(chunk, DEW_OP_RET);
+}
+
+static void write_branch_loop(dew_Chunk *chunk, dew_Integer n) {
+	/**
+	 * A loop that takes one side of a branch until just after it gets hot,
+	 * and then only the other, so its trace fails on every iteration:
+	 * 
+	 *   a = 0; b = 0;
+	 *   for (k = 0; k < n; k++) { if (k <= HOT) a = a + 1; else b = b + 1; }
+	 *   return b;
+	 */
+	
+	uint8_t zero = dew_chunk_add_constant(chunk, dew_value_integer(0));
+	uint8_t one = dew_chunk_add_constant(chunk, dew_value_integer(1));
+	uint8_t max_k = dew_chunk_add_constant(chunk, dew_value_integer(n));
+	uint8_t switch_k = dew_chunk_add_constant(chunk, dew_value_integer(DEW_TRACE_HOT + 1));
+	
+	// Slots: k, a, b, and the constant 1
+	for (int i = 0; i < 3; i++) {
+		dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, zero);
+	}
+	
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, one);
+	
+	size_t loop = chunk->count;
+	
+	dew_chunk_write(chunk, DEW_OP_GET_LOCAL); dew_chunk_write(chunk, 0);
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, max_k);
+	dew_chunk_write(chunk, DEW_OP_LESS);
+	
+	size_t exit = dew_chunk_write_jump(chunk, DEW_OP_JUMP_IF_FALSE);
+	
+	dew_chunk_write(chunk, DEW_OP_GET_LOCAL); dew_chunk_write(chunk, 0);
+	dew_chunk_write(chunk, DEW_OP_CONST); dew_chunk_write(chunk, switch_k);
+	dew_chunk_write(chunk, DEW_OP_LESS);
+	
+	size_t other = dew_chunk_write_jump(chunk, DEW_OP_JUMP_IF_FALSE);
+	
+	write_binary_to_local(chunk, 1, 1, DEW_OP_ADD, 3);
+	
+	size_t join = dew_chunk_write_jump(chunk, DEW_OP_JUMP);
+	
+	dew_chunk_patch_jump(chunk, other);
+	write_binary_to_local(chunk, 2, 2, DEW_OP_ADD, 3);
+	dew_chunk_patch_jump(chunk, join);
+	
+	write_binary_to_local(chunk, 0, 0, DEW_OP_ADD, 3);
+	
+	dew_chunk_write_loop(chunk, loop);
+	dew_chunk_patch_jump(chunk, exit);
+	
+	dew_chunk_write(chunk, DEW_OP_GET_LOCAL); dew_chunk_write(chunk, 2);
+	dew_chunk_write(chunk, DEW_OP_RET);
+}
+
+static bool run_chunk(dew_VM *vm, dew_Chunk *chunk, const char * const title, bool listing) {
+	/**
+	 * Verify and run a chunk, printing the outcome. The listing is printed
+	 * after running so it shows quickened instructions and cache counters.
+	 */
+	
+	dew_Error error;
+	dew_Value result;
+	
+	if (dew_chunk_verify(chunk, &error)) {
+		printf("%s: verify: %.4zX: %s\n", title, error.offset, error.message);
+	}
+	else if (listing) {
+		printf("%s: verify: okay, max stack %zu\n", title, chunk->max_stack);
+	}
+	
+	if (dew_vm_run(vm, chunk, &result)) {
+		printf("%s: error: %.4zX: %s\n", title, vm->error.offset, vm->error.message);
+		return false;
+	}
+	
+	if (listing) {
+		dew_chunk_dissassemble(chunk, title);
+		printf("%s: %" PRIu64 " quickened, %" PRIu64 " deoptimised\n", title, chunk->quickened, chunk->deoptimised);
+		
+		if (chunk->jit_code) {
+			printf("%s: compiled to machine code\n", title);
+		}
+		
+		printf("%s: result: ", title);
+		dew_value_print(result);
+		printf("\n");
+	}
+	
+	return true;
+}
+
+static double seconds_since(clock_t start) {
+	return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void bench_globals(void) {
+	/**
+	 * Time a loop doing everything in globals against the same loop doing
+	 * everything in locals, and show how the inline caches did.
+	 */
+	
+	const dew_Integer iterations = 10000000;
+	
+	dew_VM vm;
+	dew_Chunk chunk;
+	uint64_t hits, misses;
+	
+	dew_vm_init(&vm);
+	
+	dew_chunk_init(&chunk);
+	write_count_loop(&chunk, iterations);
+	
+	clock_t start = clock();
+	run_chunk(&vm, &chunk, "locals", false);
+	printf("locals loop:  %.3fs\n", seconds_since(start));
+	
+	dew_chunk_free(&chunk);
+	
+	dew_chunk_init(&chunk);
+	write_global_loop(&chunk, iterations);
+	
+	start = clock();
+	run_chunk(&vm, &chunk, "globals", false);
+	printf("globals loop: %.3fs\n", seconds_since(start));
+	
+	dew_chunk_cache_stats(&chunk, &hits, &misses);
+	printf("inline caches: %" PRIu64 " hits, %" PRIu64 " misses (%.4f%% hit rate)\n", hits, misses, 100.0 * hits / (hits + misses));
+	
+	dew_chunk_free(&chunk);
+	
+	// The slow path every lookup would take without a cache, with a few more
+	// globals defined so the table is not trivially small
+	static const char * const names[] = {"a", "b", "c", "d", "e", "f", "g", "h", "j", "k", "l", "m"};
+	
+	for (size_t i = 0; i < sizeof names / sizeof *names; i++) {
+		dew_vm_define(&vm, names[i], dew_value_integer(i));
+	}
+	
+	volatile dew_Integer sink = 0;
+	dew_Value value = dew_value_integer(0);
+	
+	start = clock();
+	
+	for (dew_Integer i = 0; i < iterations * 5; i++) {
+		dew_vm_get(&vm, (i & 1) ? "sum" : "limit", &value);
+		sink += value.asInteger;
+	}
+	
+	printf("by-name lookups (x%" PRId64 "): %.3fs\n", iterations * 5, seconds_since(start));
+	
+	dew_vm_free(&vm);
+}
+
+static void bench_quicken(void) {
+	/**
+	 * Time the README fib loop with and without quickening.
+	 */
+	
+	dew_VM vm;
+	dew_Chunk chunk;
+	
+	dew_vm_init(&vm);
+	
+	for (int quicken = 0; quicken < 2; quicken++) {
+		vm.quicken = quicken;
+		
+		dew_chunk_init(&chunk);
+		write_fib_loop(&chunk, 500000, 40);
+		
+		clock_t start = clock();
+		run_chunk(&vm, &chunk, "fib", false);
+		printf("fib loop, %s: %.3fs (%" PRIu64 " quickened)\n", quicken ? "quickened" : "generic  ", seconds_since(start), chunk.quickened);
+		
+		dew_chunk_free(&chunk);
+	}
+	
+	dew_vm_free(&vm);
+}
+
+static void bench_jit(void) {
+	/**
+	 * Time loops that are mostly arithmetic on the interpreter against the
+	 * same loops compiled by the JIT. Globals are read and written through
+	 * their inline caches in the compiled code too.
+	 */
+	
+	static const char * const names[] = {"fib", "poly", "globals"};
+	
+	dew_VM vm;
+	dew_Chunk chunk;
+	dew_Value result;
+	
+	dew_vm_init(&vm);
+	
+	for (size_t test = 0; test < sizeof names / sizeof *names; test++) {
+		for (int jit = 0; jit < 2; jit++) {
+			vm.jit = jit;
+			
+			dew_chunk_init(&chunk);
+			
+			switch (test) {
+				case 0: write_fib_loop(&chunk, 500000, 40); break;
+				case 1: write_poly_loop(&chunk, 20000000); break;
+				case 2: write_global_loop(&chunk, 10000000); break;
+			}
+			
+			dew_Error error;
+			
+			if (dew_chunk_verify(&chunk, &error)) {
+				printf("%s: verify: %.4zX: %s\n", names[test], error.offset, error.message);
+			}
+			
+			clock_t start = clock();
+			
+			if (dew_vm_run(&vm, &chunk, &result)) {
+				printf("%s: error: %.4zX: %s\n", names[test], vm.error.offset, vm.error.message);
+			}
+			
+			double seconds = seconds_since(start);
+			
+			printf("%s loop, %s: %.3fs, result ", names[test], jit ? (chunk.jit_code ? "jit        " : "jit (n/a)  ") : "interpreter", seconds);
+			dew_value_print(result);
+			printf("\n");
+			
+			dew_chunk_free(&chunk);
+		}
+	}
+	
+	dew_vm_free(&vm);
+}
+
+static void bench_trace(void) {
+	/**
+	 * Time the same loops as bench_jit on the interpreter with and without
+	 * tracing. The fib loop's outer loop contains the inner one, so only the
+	 * inner loop gets a trace. The branch loop's trace fails every time after
+	 * it gets hot, so it should be thrown away.
+	 */
+	
+	static const char * const names[] = {"fib", "poly", "branch"};
+	
+	dew_VM vm;
+	dew_Chunk chunk;
+	dew_Value result;
+	dew_Error error;
+	
+	dew_vm_init(&vm);
+	
+	for (size_t test = 0; test < sizeof names / sizeof *names; test++) {
+		for (int trace = 0; trace < 2; trace++) {
+			vm.trace = trace;
+			
+			dew_chunk_init(&chunk);
+			
+			if (test == 0) {
+				write_fib_loop(&chunk, 500000, 40);
+			}
+			else if (test == 1) {
+				write_poly_loop(&chunk, 20000000);
+			}
+			else {
+				write_branch_loop(&chunk, 20000000);
+			}
+			
+			dew_chunk_verify(&chunk, &error);
+			
+			clock_t start = clock();
+			
+			if (dew_vm_run(&vm, &chunk, &result)) {
+				printf("%s: error: %.4zX: %s\n", names[test], vm.error.offset, vm.error.message);
+			}
+			
+			double seconds = seconds_since(start);
+			
+			printf("%s loop, %s: %.3fs, result ", names[test], trace ? "traced     " : "interpreter", seconds);
+			dew_value_print(result);
+			printf("\n");
+			
+			if (trace) {
+				printf("  %" PRIu64 " traces recorded, %" PRIu64 " aborted, %" PRIu64 " blacklisted, %" PRIu64 " exits taken\n", chunk.traces_recorded, chunk.traces_aborted, chunk.traces_blacklisted, chunk.trace_exits);
+			}
+			
+			dew_chunk_free(&chunk);
+		}
+	}
+	
+	dew_vm_free(&vm);
+}
+
 int main(int argc, char *argv[]) {
+	if (argc > 1 && !strcmp(argv[1], "bench")) {
+		bench_globals();
+		bench_quicken();
+		bench_jit();
+		bench_trace();
+		return 0;
+	}
+	
 	dew_Chunk chunk;
+	dew_VM vm;
+	
+	dew_vm_init(&vm);
 	
 	dew_chunk_init(&chunk);
-	dew_chunk_write(&chunk, DEW_OP_CONST);
-	dew_chunk_write(&chunk, dew_chunk_add_constant(&chunk, (dew_Value) {.asNumber = 5.2}));
-	dew_chunk_write(&chunk, DEW_OP_RET);
-	dew_chunk_dissassemble(&chunk, "main");
+	write_count_loop(&chunk, 1000);
+	run_chunk(&vm, &chunk, "main", true);
+	
+	// Run again with the limit as a number, so the quickened less_int_int
+	// has to fall back to the generic form
+	chunk.soup.data[2] = dew_value_number(1000.0);
+	dew_chunk_invalidate(&chunk);
+	run_chunk(&vm, &chunk, "main (number limit)", true);
 	dew_chunk_free(&chunk);
 	
+	dew_chunk_init(&chunk);
+	write_global_loop(&chunk, 1000);
+	run_chunk(&vm, &chunk, "globals", true);
+	dew_chunk_free(&chunk);
+	
+	// The same two loops compiled to machine code
+	vm.jit = true;
+	
+	dew_chunk_init(&chunk);
+	write_count_loop(&chunk, 1000);
+	run_chunk(&vm, &chunk, "main (jit)", true);
+	dew_chunk_free(&chunk);
+	
+	dew_chunk_init(&chunk);
+	write_global_loop(&chunk, 1000);
+	run_chunk(&vm, &chunk, "globals (jit)", true);
+	dew_chunk_free(&chunk);
+	
+	// And traced, with a loop long enough to get hot
+	vm.jit = false;
+	vm.trace = true;
+	
+	dew_chunk_init(&chunk);
+	write_fib_loop(&chunk, 100, 5000);
+	run_chunk(&vm, &chunk, "fib (traced)", false);
+	dew_chunk_dissassemble_traces(&chunk);
+	dew_chunk_free(&chunk);
+	
+	// And profiled, to show where the time goes
+	vm.trace = false;
+	
+	dew_chunk_init(&chunk);
+	write_fib_loop(&chunk, 1000, 40);
+	dew_chunk_profile(&chunk, DEW_PROFILE_CYCLES);
+	run_chunk(&vm, &chunk, "fib (profiled)", true);
+	dew_chunk_free(&chunk);
+	
+	dew_vm_free(&vm);
+	
 	return 0;
 }
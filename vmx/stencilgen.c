@@ -0,0 +1,250 @@
+/**
+ * Dew VM - Stencil Generator
+ * ==========================
+ * 
+ * Build tool for the copy-and-patch JIT. Reads the ELF object that stencils.c
+ * was compiled to and writes a header with the machine code of every
+ * dew_stencil_* function and a list of the holes in it, which are the places
+ * where the JIT has to write an address or operand.
+ * 
+ * Usage: stencilgen <stencils.o> <dew_stencils.h>
+ */
+
+#include <elf.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define STENCIL_PREFIX ".text.dew_stencil_"
+#define HOLE_PREFIX "DEW_HOLE_"
+
+typedef struct {
+	uint64_t offset;
+	const char *kind;
+	int64_t addend;
+} Hole;
+
+static uint8_t *read_file(const char *path, size_t *size) {
+	/**
+	 * Read a whole file into memory.
+	 */
+	
+	FILE *file = fopen(path, "rb");
+	
+	if (!file) {
+		return NULL;
+	}
+	
+	fseek(file, 0, SEEK_END);
+	*size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	
+	uint8_t *data = malloc(*size);
+	
+	if (!data || fread(data, 1, *size, file) != *size) {
+		free(data);
+		data = NULL;
+	}
+	
+	fclose(file);
+	
+	return data;
+}
+
+static bool branches_to(const uint8_t *code, size_t size, size_t target) {
+	/**
+	 * Conservatively find if anything in the code might be a relative jump to
+	 * target. This doesn't decode instructions, so it can find jumps that
+	 * aren't there, but it won't miss one that is.
+	 */
+	
+	for (size_t i = 0; i < size; i++) {
+		// jmp rel8 and jcc rel8
+		if ((code[i] == 0xeb || (code[i] >= 0x70 && code[i] <= 0x7f)) && i + 2 <= size) {
+			if ((int64_t) i + 2 + (int8_t) code[i + 1] == (int64_t) target) {
+				return true;
+			}
+		}
+		
+		// jmp rel32
+		if (code[i] == 0xe9 && i + 5 <= size) {
+			int32_t rel;
+			memcpy(&rel, code + i + 1, 4);
+			
+			if ((int64_t) i + 5 + rel == (int64_t) target) {
+				return true;
+			}
+		}
+		
+		// jcc rel32
+		if (code[i] == 0x0f && i + 6 <= size && code[i + 1] >= 0x80 && code[i + 1] <= 0x8f) {
+			int32_t rel;
+			memcpy(&rel, code + i + 2, 4);
+			
+			if ((int64_t) i + 6 + rel == (int64_t) target) {
+				return true;
+			}
+		}
+	}
+	
+	return false;
+}
+
+static size_t strip_continue(const uint8_t *code, size_t size, Hole *holes, size_t *hole_count) {
+	/**
+	 * If the stencil ends by tail calling the next one with
+	 * 
+	 *   movabs $DEW_HOLE_CONTINUE, %rax
+	 *   jmp *%rax
+	 * 
+	 * and nothing else jumps to the jmp on its own, cut those two instructions
+	 * off so that control falls through into the next stencil. Branches to
+	 * the movabs still work, since the next stencil starts right there.
+	 * Returns the new size of the code.
+	 */
+	
+	if (size < 12) {
+		return size;
+	}
+	
+	size_t movabs = size - 12;
+	
+	if (code[movabs] != 0x48 || code[movabs + 1] != 0xb8 || code[size - 2] != 0xff || code[size - 1] != 0xe0) {
+		return size;
+	}
+	
+	for (size_t i = 0; i < *hole_count; i++) {
+		if (holes[i].offset == movabs + 2 && !strcmp(holes[i].kind, "CONTINUE") && holes[i].addend == 0) {
+			if (branches_to(code, movabs, size - 2)) {
+				return size;
+			}
+			
+			holes[i] = holes[*hole_count - 1];
+			(*hole_count)--;
+			
+			return movabs;
+		}
+	}
+	
+	return size;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s <stencils.o> <dew_stencils.h>\n", argv[0]);
+		return 1;
+	}
+	
+	size_t size;
+	uint8_t *data = read_file(argv[1], &size);
+	
+	if (!data) {
+		fprintf(stderr, "stencilgen: could not read %s\n", argv[1]);
+		return 1;
+	}
+	
+	Elf64_Ehdr *header = (Elf64_Ehdr *) data;
+	
+	if (size < sizeof *header || memcmp(header->e_ident, ELFMAG, SELFMAG) || header->e_ident[EI_CLASS] != ELFCLASS64 || header->e_machine != EM_X86_64 || header->e_type != ET_REL) {
+		fprintf(stderr, "stencilgen: %s is not an x86-64 ELF object\n", argv[1]);
+		return 1;
+	}
+	
+	Elf64_Shdr *sections = (Elf64_Shdr *) (data + header->e_shoff);
+	const char *section_names = (const char *) (data + sections[header->e_shstrndx].sh_offset);
+	
+	// There is only one symbol table in a relocatable object
+	Elf64_Sym *symbols = NULL;
+	const char *symbol_names = NULL;
+	
+	for (size_t i = 0; i < header->e_shnum; i++) {
+		if (sections[i].sh_type == SHT_SYMTAB) {
+			symbols = (Elf64_Sym *) (data + sections[i].sh_offset);
+			symbol_names = (const char *) (data + sections[sections[i].sh_link].sh_offset);
+		}
+	}
+	
+	if (!symbols) {
+		fprintf(stderr, "stencilgen: %s has no symbol table\n", argv[1]);
+		return 1;
+	}
+	
+	FILE *out = fopen(argv[2], "w");
+	
+	if (!out) {
+		fprintf(stderr, "stencilgen: could not write %s\n", argv[2]);
+		return 1;
+	}
+	
+	fprintf(out, "/**\n * Generated by stencilgen from stencils.c, do not edit.\n */\n");
+	
+	for (size_t i = 0; i < header->e_shnum; i++) {
+		const char *section = section_names + sections[i].sh_name;
+		
+		if (sections[i].sh_type != SHT_PROGBITS || strncmp(section, STENCIL_PREFIX, strlen(STENCIL_PREFIX))) {
+			continue;
+		}
+		
+		const char *name = section + strlen(STENCIL_PREFIX);
+		const uint8_t *code = data + sections[i].sh_offset;
+		size_t code_size = sections[i].sh_size;
+		
+		Hole *holes = NULL;
+		size_t hole_count = 0;
+		
+		for (size_t j = 0; j < header->e_shnum; j++) {
+			if (sections[j].sh_type != SHT_RELA || sections[j].sh_info != i) {
+				continue;
+			}
+			
+			Elf64_Rela *relocs = (Elf64_Rela *) (data + sections[j].sh_offset);
+			size_t count = sections[j].sh_size / sizeof *relocs;
+			
+			holes = realloc(holes, sizeof *holes * (hole_count + count));
+			
+			for (size_t k = 0; k < count; k++) {
+				const char *symbol = symbol_names + symbols[ELF64_R_SYM(relocs[k].r_info)].st_name;
+				
+				if (ELF64_R_TYPE(relocs[k].r_info) != R_X86_64_64 || strncmp(symbol, HOLE_PREFIX, strlen(HOLE_PREFIX))) {
+					fprintf(stderr, "stencilgen: stencil %s refers to '%s' in a way that can't be patched (relocation type %u)\n", name, symbol, (unsigned) ELF64_R_TYPE(relocs[k].r_info));
+					return 1;
+				}
+				
+				holes[hole_count++] = (Hole) {relocs[k].r_offset, symbol + strlen(HOLE_PREFIX), relocs[k].r_addend};
+			}
+		}
+		
+		code_size = strip_continue(code, code_size, holes, &hole_count);
+		
+		fprintf(out, "\nstatic const uint8_t dew_stencil_code_%s[] = {", name);
+		
+		for (size_t j = 0; j < code_size; j++) {
+			fprintf(out, "%s0x%02x,", (j % 12) ? " " : "\n\t", code[j]);
+		}
+		
+		fprintf(out, "\n};\n");
+		
+		if (hole_count) {
+			fprintf(out, "\nstatic const dew_Hole dew_stencil_holes_%s[] = {\n", name);
+			
+			for (size_t j = 0; j < hole_count; j++) {
+				fprintf(out, "\t{%" PRIu64 ", DEW_HOLE_%s, %" PRId64 "},\n", holes[j].offset, holes[j].kind, holes[j].addend);
+			}
+			
+			fprintf(out, "};\n");
+			fprintf(out, "\nstatic const dew_Stencil dew_stencil_%s = {dew_stencil_code_%s, %zu, dew_stencil_holes_%s, %zu};\n", name, name, code_size, name, hole_count);
+		}
+		else {
+			fprintf(out, "\nstatic const dew_Stencil dew_stencil_%s = {dew_stencil_code_%s, %zu, NULL, 0};\n", name, name, code_size);
+		}
+		
+		free(holes);
+	}
+	
+	fclose(out);
+	free(data);
+	
+	return 0;
+}
@@ -0,0 +1,209 @@
+/**
+ * Dew VM - JIT Stencils
+ * =====================
+ * 
+ * Each dew_stencil_* function below is the machine code for one instruction
+ * of the copy-and-patch JIT. This file is never linked into the VM: it is
+ * compiled on its own with -mcmodel=large, so that every reference to one of
+ * the DEW_HOLE_* symbols becomes an absolute 64-bit relocation, and then
+ * stencilgen turns the object file into dew_stencils.h. The JIT copies the
+ * stencils for a chunk one after another and writes the real values into the
+ * holes.
+ * 
+ * Every stencil takes the VM, the frame base and the stack top, and passes
+ * them on by tail calling the next stencil (DEW_HOLE_CONTINUE) or a jump
+ * target (DEW_HOLE_TARGET). The tail call to the next stencil is almost
+ * always the last thing in the function, and stencilgen cuts it off so that
+ * control falls through instead.
+ * 
+ * Stencils must not use anything the patcher doesn't know how to fill in:
+ * no calls to functions by name, no string or floating point literals that
+ * end up in .rodata and no switch statements that become jump tables.
+ * stencilgen refuses to build the header if one does. They also bake in the
+ * layout of dew_VM, so this has to be built with the same DEW_STACK_MAX as
+ * the VM.
+ * 
+ * The chunk has been verified before it is compiled, so none of the checks
+ * the checked dispatch loop makes are needed here. Instructions without a
+ * stencil of their own get the STEP stencil, which calls DEW_HOLE_STEP to run
+ * that one instruction on the interpreter. Stencils that only handle the
+ * common case tail call DEW_HOLE_SLOW for everything else, which the JIT
+ * points at a copy of the STEP stencil placed after the rest of the code, so
+ * the fast path never has to set up a stack frame for the call.
+ */
+
+#include "dew.h"
+
+typedef dew_Status dew_StencilFn(dew_VM *vm, dew_Value *base, dew_Value *top);
+
+extern dew_StencilFn DEW_HOLE_CONTINUE;
+extern dew_StencilFn DEW_HOLE_TARGET;
+extern dew_StencilFn DEW_HOLE_SLOW;
+extern char DEW_HOLE_OPERAND[];
+extern char DEW_HOLE_OPERAND2[];
+extern char DEW_HOLE_CHUNK[];
+extern char DEW_HOLE_OFFSET[];
+extern char DEW_HOLE_CACHE[];
+extern dew_Value *DEW_HOLE_STEP(dew_VM *vm, dew_Chunk *chunk, size_t offset, dew_Value *base, dew_Value *top);
+
+#define DEW_STENCIL(NAME) dew_Status dew_stencil_##NAME(dew_VM *vm, dew_Value *base, dew_Value *top)
+#define DEW_NEXT() return DEW_HOLE_CONTINUE(vm, base, top)
+#define DEW_SLOW() return DEW_HOLE_SLOW(vm, base, top)
+#define DEW_ARITH(NAME, OP, INTEGER) \
+	DEW_STENCIL(NAME) { \
+		if (top[-2].type == DEW_TYPE_INTEGER && top[-1].type == DEW_TYPE_INTEGER) { \
+			top[-2].asInteger = INTEGER(top[-2].asInteger, top[-1].asInteger); \
+			top--; \
+			DEW_NEXT(); \
+		} \
+		if (top[-2].type == DEW_TYPE_NUMBER && top[-1].type == DEW_TYPE_NUMBER) { \
+			top[-2].asNumber = top[-2].asNumber OP top[-1].asNumber; \
+			top--; \
+			DEW_NEXT(); \
+		} \
+		DEW_SLOW(); \
+	}
+#define DEW_COMPARE(NAME, OP) \
+	DEW_STENCIL(NAME) { \
+		if (top[-2].type == DEW_TYPE_INTEGER && top[-1].type == DEW_TYPE_INTEGER) { \
+			bool value = top[-2].asInteger OP top[-1].asInteger; \
+			top[-2].type = DEW_TYPE_BOOLEAN; \
+			top[-2].asInteger = 0; \
+			top[-2].asBoolean = value; \
+			top--; \
+			DEW_NEXT(); \
+		} \
+		if (top[-2].type == DEW_TYPE_NUMBER && top[-1].type == DEW_TYPE_NUMBER) { \
+			bool value = top[-2].asNumber OP top[-1].asNumber; \
+			top[-2].type = DEW_TYPE_BOOLEAN; \
+			top[-2].asInteger = 0; \
+			top[-2].asBoolean = value; \
+			top--; \
+			DEW_NEXT(); \
+		} \
+		DEW_SLOW(); \
+	}
+
+static inline __attribute__((always_inline)) bool dew_stencil_truthy(dew_Value value) {
+	/**
+	 * Same as dew_value_truthy, which can't be called from here.
+	 */
+	
+	if (value.type == DEW_TYPE_BOOLEAN) {
+		return value.asBoolean;
+	}
+	
+	if (value.type == DEW_TYPE_INTEGER) {
+		return value.asInteger != 0;
+	}
+	
+	if (value.type == DEW_TYPE_NUMBER) {
+		return value.asNumber != 0.0;
+	}
+	
+	if (value.type == DEW_TYPE_STRING) {
+		return value.asString[0] != '\0';
+	}
+	
+	return value.type != DEW_TYPE_NULL;
+}
+
+DEW_STENCIL(STEP) {
+	top = DEW_HOLE_STEP(vm, (dew_Chunk *) DEW_HOLE_CHUNK, (size_t) DEW_HOLE_OFFSET, base, top);
+	
+	if (!top) {
+		return DEW_STATUS_RUNTIME;
+	}
+	
+	DEW_NEXT();
+}
+
+DEW_STENCIL(RET) {
+	// dew_jit_run picks the result up from here
+	vm->top = top;
+	
+	return DEW_STATUS_OKAY;
+}
+
+DEW_STENCIL(CONST) {
+	// Operand is the type and operand2 the raw bits of the constant
+	top->type = (dew_Type) (uintptr_t) DEW_HOLE_OPERAND;
+	top->asInteger = (dew_Integer) (uintptr_t) DEW_HOLE_OPERAND2;
+	top++;
+	
+	DEW_NEXT();
+}
+
+DEW_STENCIL(POP) {
+	top--;
+	
+	DEW_NEXT();
+}
+
+DEW_STENCIL(GET_LOCAL) {
+	*top = base[(uintptr_t) DEW_HOLE_OPERAND];
+	top++;
+	
+	DEW_NEXT();
+}
+
+DEW_STENCIL(SET_LOCAL) {
+	base[(uintptr_t) DEW_HOLE_OPERAND] = top[-1];
+	
+	DEW_NEXT();
+}
+
+DEW_STENCIL(GET_GLOBAL) {
+	// Operand2 is the name, the same pointer the cache was filled with
+	dew_Cache *cache = (dew_Cache *) DEW_HOLE_CACHE;
+	
+	if (cache->version == vm->globals.version && cache->name == (dew_String) (uintptr_t) DEW_HOLE_OPERAND2) {
+		cache->hits++;
+		*top++ = *cache->slot;
+		DEW_NEXT();
+	}
+	
+	DEW_SLOW();
+}
+
+DEW_STENCIL(SET_GLOBAL) {
+	dew_Cache *cache = (dew_Cache *) DEW_HOLE_CACHE;
+	
+	if (cache->version == vm->globals.version && cache->name == (dew_String) (uintptr_t) DEW_HOLE_OPERAND2) {
+		cache->hits++;
+		*cache->slot = top[-1];
+		DEW_NEXT();
+	}
+	
+	DEW_SLOW();
+}
+
+DEW_ARITH(ADD, +, DEW_INTEGER_ADD)
+DEW_ARITH(SUB, -, DEW_INTEGER_SUB)
+DEW_ARITH(MUL, *, DEW_INTEGER_MUL)
+DEW_COMPARE(LESS, <)
+DEW_COMPARE(GREATER, >)
+
+DEW_STENCIL(NOT) {
+	bool value = !dew_stencil_truthy(top[-1]);
+	
+	top[-1].type = DEW_TYPE_BOOLEAN;
+	top[-1].asInteger = 0;
+	top[-1].asBoolean = value;
+	
+	DEW_NEXT();
+}
+
+DEW_STENCIL(JUMP) {
+	return DEW_HOLE_TARGET(vm, base, top);
+}
+
+DEW_STENCIL(JUMP_IF_FALSE) {
+	top--;
+	
+	if (!dew_stencil_truthy(*top)) {
+		return DEW_HOLE_TARGET(vm, base, top);
+	}
+	
+	DEW_NEXT();
+}